@@ -22,6 +22,8 @@
 #include "vtkSlicerSequencesLogic.h"
 
 // MRMLSequence includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLSequenceImageBufferPool.h"
 #include "vtkMRMLSequenceNode.h"
 #include "vtkMRMLSequenceBrowserNode.h"
 
@@ -35,22 +37,50 @@
 #include "vtkMRMLStorageNode.h"
 
 // VTK includes
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
 #include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationObjectBaseKey.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
 #include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
 
 #ifdef ENABLE_PERFORMANCE_PROFILING
 #include "vtkTimerLog.h"
 #endif
 
+// Memory mapping
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // STD includes
+#include <cmath>
+#include <iomanip>
+#include <set>
 #include <sstream>
 #include <algorithm>
 
 static const char IMAGE_NODE_BASE_NAME[]="Image";
 static const char NODE_BASE_NAME_SEPARATOR[]="-";
+// Node attribute that stores the frame field name (e.g., ProbeToTrackerTransform) that the transform sequence was read from
+static const char FRAME_FIELD_NAME_ATTRIBUTE_NAME[]="MetafileImporter.FrameFieldName";
+// Maximum difference between numeric index values of a master frame and a transform that are written in the same frame.
+// Half of the resolution of imported timestamps (they are rounded to 3 decimal digits).
+static const double TRANSFORM_INDEX_VALUE_TOLERANCE=0.0005;
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerMetafileImporterLogic);
@@ -60,6 +90,8 @@ vtkSlicerMetafileImporterLogic
 ::vtkSlicerMetafileImporterLogic() 
 {
   this->SequencesLogic = NULL;
+  this->LocalPixelDataOffset = 0;
+  this->MemoryMapRawData = false;
 }
 
 //----------------------------------------------------------------------------
@@ -150,38 +182,85 @@ void StringToInt(const char* strPtr, T &result)
 }
 
 
-void UpdateTransformNodeFromString(vtkMRMLLinearTransformNode* transformNode, const std::string& str )
+//----------------------------------------------------------------------------
+/*! Read the 16 elements of a 4x4 matrix (row-major order) from a string */
+void ReadMatrixElementsFromString(double elements[16], const std::string& str )
 {
   std::stringstream ss( str );
-  
-  double e00; ss >> e00; double e01; ss >> e01; double e02; ss >> e02; double e03; ss >> e03;
-  double e10; ss >> e10; double e11; ss >> e11; double e12; ss >> e12; double e13; ss >> e13;
-  double e20; ss >> e20; double e21; ss >> e21; double e22; ss >> e22; double e23; ss >> e23;
-  double e30; ss >> e30; double e31; ss >> e31; double e32; ss >> e32; double e33; ss >> e33;
-
-  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
-
-  matrix->SetElement( 0, 0, e00 );
-  matrix->SetElement( 0, 1, e01 );
-  matrix->SetElement( 0, 2, e02 );
-  matrix->SetElement( 0, 3, e03 );
+  for (int i=0; i<16; i++)
+  {
+    ss >> elements[i];
+  }
+}
 
-  matrix->SetElement( 1, 0, e10 );
-  matrix->SetElement( 1, 1, e11 );
-  matrix->SetElement( 1, 2, e12 );
-  matrix->SetElement( 1, 3, e13 );
+/*! Transform read from the file, before it is added to a sequence */
+struct ImportedTransformType
+{
+  int FrameNumber;
+  double MatrixElements[16];
+  bool Valid;
+};
 
-  matrix->SetElement( 2, 0, e20 );
-  matrix->SetElement( 2, 1, e21 );
-  matrix->SetElement( 2, 2, e22 );
-  matrix->SetElement( 2, 3, e23 );
+//----------------------------------------------------------------------------
+bool ImportedTransformFrameNumberLess(const ImportedTransformType& a, const ImportedTransformType& b)
+{
+  return a.FrameNumber < b.FrameNumber;
+}
 
-  matrix->SetElement( 3, 0, e30 );
-  matrix->SetElement( 3, 1, e31 );
-  matrix->SetElement( 3, 2, e32 );
-  matrix->SetElement( 3, 3, e33 );
+/*! Transforms of a single tool and the sequence node that they have to be added to.
+  The threads only fill Matrices, IndexValues and ItemValid, the sequence node is set on the main thread. */
+struct ImportedToolStreamType
+{
+  std::vector<ImportedTransformType>* Transforms;
+  vtkMRMLLinearTransformSequenceNode* SequenceNode;
+  vtkDoubleArray* Matrices;
+  std::vector< std::string > IndexValues;
+  std::vector< bool > ItemValid;
+};
+
+/*! Input of the threads that fill the transform sequence nodes */
+struct ImportTransformsThreadDataType
+{
+  std::vector<ImportedToolStreamType> ToolStreams;
+  const std::map< int, std::string >* FrameNumberToIndexValueMap;
+};
 
-  transformNode->SetAndObserveMatrixTransformToParent( matrix );
+//----------------------------------------------------------------------------
+/*! Collect the matrices, index values and validity of the tool streams that are assigned to this thread.
+  Each tool stream is processed by exactly one thread and only its own arrays are written,
+  so no synchronization is needed. MRML nodes are not accessed from the threads. */
+VTK_THREAD_RETURN_TYPE ImportTransformsThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ImportTransformsThreadDataType* threadData = static_cast<ImportTransformsThreadDataType*>(threadInfo->UserData);
+  int numberOfToolStreams = threadData->ToolStreams.size();
+  for (int toolStreamIndex = threadInfo->ThreadID; toolStreamIndex < numberOfToolStreams; toolStreamIndex += threadInfo->NumberOfThreads)
+  {
+    ImportedToolStreamType& toolStream = threadData->ToolStreams[toolStreamIndex];
+    // Items are added in the order of frame numbers
+    std::stable_sort(toolStream.Transforms->begin(), toolStream.Transforms->end(), ImportedTransformFrameNumberLess);
+    toolStream.Matrices->SetNumberOfComponents(16);
+    toolStream.Matrices->Allocate(16*toolStream.Transforms->size());
+    // A transform that has the same index value as a previous one replaces it (same as SetMatrixElementsAtValue)
+    std::map< std::string, int > indexValueToItemNumber;
+    for (std::vector<ImportedTransformType>::iterator transformIt=toolStream.Transforms->begin(); transformIt!=toolStream.Transforms->end(); ++transformIt)
+    {
+      std::map< int, std::string >::const_iterator indexValueIt = threadData->FrameNumberToIndexValueMap->find(transformIt->FrameNumber);
+      std::string indexValue = (indexValueIt != threadData->FrameNumberToIndexValueMap->end()) ? indexValueIt->second : std::string();
+      std::map< std::string, int >::iterator itemNumberIt = indexValueToItemNumber.find(indexValue);
+      if (itemNumberIt != indexValueToItemNumber.end())
+      {
+        toolStream.Matrices->SetTuple(itemNumberIt->second, transformIt->MatrixElements);
+        toolStream.ItemValid[itemNumberIt->second] = transformIt->Valid;
+        continue;
+      }
+      indexValueToItemNumber[indexValue] = toolStream.IndexValues.size();
+      toolStream.Matrices->InsertNextTuple(transformIt->MatrixElements);
+      toolStream.IndexValues.push_back(indexValue);
+      toolStream.ItemValid.push_back(transformIt->Valid);
+    }
+  }
+  return VTK_THREAD_RETURN_VALUE;
 }
 
 
@@ -190,6 +269,8 @@ static const int MAX_LINE_LENGTH = 1000;
 
 static std::string SEQMETA_FIELD_FRAME_FIELD_PREFIX = "Seq_Frame";
 static std::string SEQMETA_FIELD_IMG_STATUS = "ImageStatus";
+static std::string SEQMETA_FIELD_STATUS_POSTFIX = "Status";
+static std::string SEQMETA_FIELD_STATUS_OK = "OK";
 
 //----------------------------------------------------------------------------
 void vtkSlicerMetafileImporterLogic::ReadTransforms( const std::string& fileName, std::deque< vtkMRMLNode* > &createdNodes )
@@ -201,14 +282,16 @@ void vtkSlicerMetafileImporterLogic::ReadTransforms( const std::string& fileName
   char line[ MAX_LINE_LENGTH + 1 ] = { 0 };
 
   this->FrameNumberToIndexValueMap.clear();
+  this->InvalidImageFrameNumbers.clear();
+  this->HeaderFields.clear();
+  this->LocalPixelDataOffset = 0;
 
-  // This structure contains all the transform nodes that are read from the file.
-  // The nodes are not added immediately to the scene to allow them properly named, using the timestamp index value.
-  // Maps the frame number to a vector of transform nodes that belong to that frame.
-  std::map<int,std::vector<vtkMRMLLinearTransformNode*> > importedTransformNodes;
-
-  // It contains the largest frame number. It will be used to iterate through all the frame numbers from 0 to lastFrameNumber
-  int lastFrameNumber=-1;
+  // This structure contains all the transforms that are read from the file.
+  // The transforms are not added immediately to the sequences, because the timestamp of the frame may be defined after the transform.
+  // Maps the transform name to a vector of transforms (one for each frame) of that tool.
+  std::map< std::string, std::vector<ImportedTransformType> > importedTransforms;
+  // Frame numbers where the transform status is not OK, for each transform name
+  std::map< std::string, std::set<int> > invalidTransformFrameNumbers;
 
   while ( fgets( line, MAX_LINE_LENGTH, stream ) )
   {
@@ -231,7 +314,9 @@ void vtkSlicerMetafileImporterLogic::ReadTransforms( const std::string& fileName
 
     if ( name.compare("ElementDataFile")==NULL )
     {
-      // this is the last field of the header
+      // this is the last field of the header, pixel data starts right after this line if the data file is LOCAL
+      this->HeaderFields[name] = value;
+      this->LocalPixelDataOffset = ftell( stream );
       break;
     }
     
@@ -239,7 +324,8 @@ void vtkSlicerMetafileImporterLogic::ReadTransforms( const std::string& fileName
     // Only consider the Seq_Frame
     if ( name.compare( 0, SEQMETA_FIELD_FRAME_FIELD_PREFIX.size(), SEQMETA_FIELD_FRAME_FIELD_PREFIX ) != 0 )
     {
-      // not a frame field, ignore it
+      // not a frame field, store it for reading the images
+      this->HeaderFields[name] = value;
       continue;
     }
 
@@ -261,19 +347,34 @@ void vtkSlicerMetafileImporterLogic::ReadTransforms( const std::string& fileName
 
     int frameNumber = 0;
     StringToInt( frameNumberStr.c_str(), frameNumber ); // TODO: Removed warning
-    if (frameNumber>lastFrameNumber)
-    {
-      lastFrameNumber=frameNumber;
-    }
-      
+
     // Convert the string to transform and add transform to hierarchy
     if ( frameFieldName.find( "Transform" ) != std::string::npos && frameFieldName.find( "Status" ) == std::string::npos )
     {
-      vtkMRMLLinearTransformNode* currentTransform = vtkMRMLLinearTransformNode::New(); // will be deleted when added to the scene
-      UpdateTransformNodeFromString(currentTransform, value);  
-      // Generating a unique name is important because that will be used to generate the filename by default
-      currentTransform->SetName( frameFieldName.c_str() );
-      importedTransformNodes[frameNumber].push_back(currentTransform);
+      ImportedTransformType currentTransform;
+      currentTransform.FrameNumber = frameNumber;
+      ReadMatrixElementsFromString(currentTransform.MatrixElements, value);
+      currentTransform.Valid = true; // updated from the status field after all fields are read
+      importedTransforms[frameFieldName].push_back(currentTransform);
+    }
+
+    // Transform status (e.g., Seq_Frame0000_CustomTransformStatus = INVALID), anything else than OK means the transform is invalid
+    if ( frameFieldName.find( "Transform" ) != std::string::npos && frameFieldName.size() > SEQMETA_FIELD_STATUS_POSTFIX.size()
+      && frameFieldName.compare( frameFieldName.size() - SEQMETA_FIELD_STATUS_POSTFIX.size(), SEQMETA_FIELD_STATUS_POSTFIX.size(), SEQMETA_FIELD_STATUS_POSTFIX ) == 0 )
+    {
+      if ( value.compare( SEQMETA_FIELD_STATUS_OK ) != 0 )
+      {
+        std::string transformName = frameFieldName.substr( 0, frameFieldName.size() - SEQMETA_FIELD_STATUS_POSTFIX.size() );
+        invalidTransformFrameNumbers[transformName].insert(frameNumber);
+      }
+    }
+
+    if ( frameFieldName.compare( SEQMETA_FIELD_IMG_STATUS ) == 0 )
+    {
+      if ( value.compare( SEQMETA_FIELD_STATUS_OK ) != 0 )
+      {
+        this->InvalidImageFrameNumbers.insert(frameNumber);
+      }
     }
 
     if ( frameFieldName.compare( "Timestamp" ) == 0 )
@@ -299,105 +400,437 @@ void vtkSlicerMetafileImporterLogic::ReadTransforms( const std::string& fileName
   }
   fclose( stream );
 
-  // Now add all the nodes to the scene
-
-  std::map< std::string, vtkMRMLSequenceNode* > transformRootNodes;
-
-  for (int currentFrameNumber=0; currentFrameNumber<=lastFrameNumber; currentFrameNumber++)
+  // Apply the transform status fields
+  for (std::map< std::string, std::set<int> >::iterator invalidToolIt=invalidTransformFrameNumbers.begin(); invalidToolIt!=invalidTransformFrameNumbers.end(); ++invalidToolIt)
   {
-    std::map<int,std::vector<vtkMRMLLinearTransformNode*> >::iterator transformsForCurrentFrame=importedTransformNodes.find(currentFrameNumber);
-    if ( transformsForCurrentFrame == importedTransformNodes.end() )
+    std::map< std::string, std::vector<ImportedTransformType> >::iterator toolIt=importedTransforms.find(invalidToolIt->first);
+    if (toolIt==importedTransforms.end())
     {
-      // no transforms for this frame
       continue;
     }
-    std::string paramValueString=this->FrameNumberToIndexValueMap[currentFrameNumber];
-    for (std::vector<vtkMRMLLinearTransformNode*>::iterator transformIt=transformsForCurrentFrame->second.begin(); transformIt!=transformsForCurrentFrame->second.end(); ++transformIt)
+    for (std::vector<ImportedTransformType>::iterator transformIt=toolIt->second.begin(); transformIt!=toolIt->second.end(); ++transformIt)
     {
-      vtkMRMLLinearTransformNode* transform=(*transformIt);
-      vtkMRMLSequenceNode* transformsRootNode = NULL;
-      if (transformRootNodes.find(transform->GetName())==transformRootNodes.end())
+      if (invalidToolIt->second.find(transformIt->FrameNumber)!=invalidToolIt->second.end())
       {
-        // Setup hierarchy structure
-        vtkSmartPointer<vtkMRMLSequenceNode> newTransformsRootNode = vtkSmartPointer<vtkMRMLSequenceNode>::New();
-        transformsRootNode=newTransformsRootNode;
-        this->GetMRMLScene()->AddNode(transformsRootNode);
-        transformsRootNode->SetIndexName("time");
-        transformsRootNode->SetIndexUnit("s");
-        std::string transformsRootName=this->BaseNodeName+NODE_BASE_NAME_SEPARATOR+transform->GetName();        
-        transformsRootNode->SetName( transformsRootName.c_str() );
-
-        // Create storage node
-        vtkMRMLStorageNode *storageNode = transformsRootNode->CreateDefaultStorageNode();    
-        if (storageNode)
-        {
-          this->GetMRMLScene()->AddNode(storageNode);
-          storageNode->Delete(); // now the scene owns the storage node
-          transformsRootNode->SetAndObserveStorageNodeID(storageNode->GetID());
-          transformsRootNode->StorableModified(); // marks as modified, so the volume will be written to file on save
-        }
-        else
-        {
-          vtkErrorMacro("Failed to create storage node for the imported image sequence");
-        }
-
-        transformsRootNode->StartModify();
-        transformRootNodes[transform->GetName()]=transformsRootNode;
+        transformIt->Valid = false;
       }
-      else
+    }
+  }
+  invalidTransformFrameNumbers.clear();
+
+  // All the transforms of a tool are stored in a single linear transform sequence node
+  // (instead of creating a separate transform node for each frame).
+  // Tool streams are independent, so their matrices are collected in parallel, then set in the sequence nodes on this thread.
+  std::vector< vtkSmartPointer<vtkMRMLLinearTransformSequenceNode> > transformRootNodes;
+  std::vector< vtkSmartPointer<vtkDoubleArray> > transformMatrices;
+  ImportTransformsThreadDataType threadData;
+  threadData.FrameNumberToIndexValueMap = &(this->FrameNumberToIndexValueMap);
+  for (std::map< std::string, std::vector<ImportedTransformType> >::iterator toolIt=importedTransforms.begin(); toolIt!=importedTransforms.end(); ++toolIt)
+  {
+    vtkSmartPointer<vtkMRMLLinearTransformSequenceNode> transformsRootNode = vtkSmartPointer<vtkMRMLLinearTransformSequenceNode>::New();
+    transformsRootNode->SetIndexName("time");
+    transformsRootNode->SetIndexUnit("s");
+    std::string transformsRootName=this->BaseNodeName+NODE_BASE_NAME_SEPARATOR+toolIt->first;
+    transformsRootNode->SetName( transformsRootName.c_str() );
+    // The field name cannot be reliably extracted from the node name, as both the base name and the field name may contain the separator
+    transformsRootNode->SetAttribute( FRAME_FIELD_NAME_ATTRIBUTE_NAME, toolIt->first.c_str() );
+    transformRootNodes.push_back(transformsRootNode);
+    vtkSmartPointer<vtkDoubleArray> matrices = vtkSmartPointer<vtkDoubleArray>::New();
+    transformMatrices.push_back(matrices);
+
+    ImportedToolStreamType toolStream;
+    toolStream.Transforms = &(toolIt->second);
+    toolStream.SequenceNode = transformsRootNode;
+    toolStream.Matrices = matrices;
+    threadData.ToolStreams.push_back(toolStream);
+  }
+
+  if (!threadData.ToolStreams.empty())
+  {
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    int numberOfThreads = std::min<int>(threader->GetNumberOfThreads(), threadData.ToolStreams.size());
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(ImportTransformsThreadFunction, &threadData);
+    threader->SingleMethodExecute();
+  }
+  importedTransforms.clear();
+
+  for (std::vector<ImportedToolStreamType>::iterator toolStreamIt=threadData.ToolStreams.begin(); toolStreamIt!=threadData.ToolStreams.end(); ++toolStreamIt)
+  {
+    int wasModified = toolStreamIt->SequenceNode->StartModify();
+    toolStreamIt->SequenceNode->SetMatricesAndIndexValues(toolStreamIt->Matrices, toolStreamIt->IndexValues);
+    for (int itemNumber=0; itemNumber<static_cast<int>(toolStreamIt->ItemValid.size()); itemNumber++)
+    {
+      if (!toolStreamIt->ItemValid[itemNumber])
       {
-        transformsRootNode = transformRootNodes[transform->GetName()];
+        toolStreamIt->SequenceNode->SetNthItemValid(itemNumber, false);
       }
-      transform->SetHideFromEditors(false);
-      // Generating a unique name is important because that will be used to generate the filename by default
-      std::ostringstream nameStr;
-      nameStr << transform->GetName() << std::setw(4) << std::setfill('0') << currentFrameNumber << std::ends; 
-      transform->SetName( nameStr.str().c_str() );
-      transformsRootNode->SetDataNodeAtValue(transform, paramValueString.c_str() );
-      transform->Delete(); // ownership transferred to the root node
     }
+    toolStreamIt->SequenceNode->EndModify(wasModified);
   }
+  threadData.ToolStreams.clear();
+  transformMatrices.clear();
 
-  for (std::map< std::string, vtkMRMLSequenceNode* > :: iterator it=transformRootNodes.begin(); it!=transformRootNodes.end(); ++it)
+  // Now add all the nodes to the scene
+  for (std::vector< vtkSmartPointer<vtkMRMLLinearTransformSequenceNode> >::iterator it=transformRootNodes.begin(); it!=transformRootNodes.end(); ++it)
   {
-    if (this->GetMRMLScene()->GetFirstNodeByName(it->second->GetName())!=it->second)
+    if (this->GetMRMLScene()->GetFirstNodeByName((*it)->GetName())!=NULL)
     {
       // node name is not unique, generate a unique name now
-      it->second->SetName(this->GetMRMLScene()->GenerateUniqueName(it->second->GetName()).c_str());
+      (*it)->SetName(this->GetMRMLScene()->GenerateUniqueName((*it)->GetName()).c_str());
+    }
+    this->GetMRMLScene()->AddNode(*it);
+
+    // Create storage node, the matrices are written into a metafile when the scene is saved
+    vtkMRMLStorageNode *storageNode = (*it)->CreateDefaultStorageNode();
+    if (storageNode)
+    {
+      this->GetMRMLScene()->AddNode(storageNode);
+      storageNode->Delete(); // now the scene owns the storage node
+      (*it)->SetAndObserveStorageNodeID(storageNode->GetID());
+      (*it)->StorableModified(); // marks as modified, so the matrices will be written to file on save
+    }
+    else
+    {
+      vtkErrorMacro("Failed to create storage node for the imported transform sequence "<<(*it)->GetName());
     }
-    it->second->EndModify(false);
-    // Loading is completed indicate to modules that the hierarchy is changed
-    it->second->Modified();
-    createdNodes.push_back(it->second);
+
+    createdNodes.push_back(*it);
   }
   transformRootNodes.clear();
   
 }
 
+//----------------------------------------------------------------------------
+/*! Memory mapping of a file. Copy-on-write: pages that are modified in memory are not written back to the file.
+  Image arrays that are views into the mapping keep a reference to this object (see RAW_DATA_MAPPING),
+  so the file remains mapped until the last frame image that uses it is deleted. */
+class vtkMetafileRawDataMapping : public vtkObject
+{
+public:
+  static vtkMetafileRawDataMapping *New();
+  vtkTypeMacro(vtkMetafileRawDataMapping, vtkObject);
+
+  /*! Map the whole file into memory. Returns false on failure. */
+  bool Open(const std::string& fileName);
+
+  unsigned char* GetData() { return this->Data; }
+  size_t GetSize() { return this->Size; }
+
+protected:
+  vtkMetafileRawDataMapping();
+  ~vtkMetafileRawDataMapping();
+
+  void Close();
+
+  unsigned char* Data;
+  size_t Size;
+#ifdef _WIN32
+  HANDLE FileHandle;
+  HANDLE MappingHandle;
+#endif
+
+private:
+  vtkMetafileRawDataMapping(const vtkMetafileRawDataMapping&); // Not implemented
+  void operator=(const vtkMetafileRawDataMapping&);           // Not implemented
+};
+
+vtkStandardNewMacro(vtkMetafileRawDataMapping);
+
+//----------------------------------------------------------------------------
+vtkMetafileRawDataMapping::vtkMetafileRawDataMapping()
+: Data(NULL)
+, Size(0)
+{
+#ifdef _WIN32
+  this->FileHandle = NULL;
+  this->MappingHandle = NULL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+vtkMetafileRawDataMapping::~vtkMetafileRawDataMapping()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMetafileRawDataMapping::Open(const std::string& fileName)
+{
+  this->Close();
+#ifdef _WIN32
+  this->FileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (this->FileHandle == INVALID_HANDLE_VALUE)
+  {
+    this->FileHandle = NULL;
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(this->FileHandle, &fileSize) || fileSize.QuadPart <= 0
+    || static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<unsigned long long>(static_cast<size_t>(-1)))
+  {
+    this->Close();
+    return false;
+  }
+  this->MappingHandle = CreateFileMappingA(this->FileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if (this->MappingHandle == NULL)
+  {
+    this->Close();
+    return false;
+  }
+  void* data = MapViewOfFile(this->MappingHandle, FILE_MAP_COPY, 0, 0, 0);
+  if (data == NULL)
+  {
+    this->Close();
+    return false;
+  }
+  this->Data = static_cast<unsigned char*>(data);
+  this->Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  if (fileDescriptor < 0)
+  {
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size <= 0
+    || static_cast<unsigned long long>(fileStat.st_size) > static_cast<unsigned long long>(static_cast<size_t>(-1)))
+  {
+    close(fileDescriptor);
+    return false;
+  }
+  void* data = mmap(NULL, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+  // the mapping remains valid after the file is closed
+  close(fileDescriptor);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+  this->Data = static_cast<unsigned char*>(data);
+  this->Size = static_cast<size_t>(fileStat.st_size);
+#endif
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkMetafileRawDataMapping::Close()
+{
+#ifdef _WIN32
+  if (this->Data != NULL)
+  {
+    UnmapViewOfFile(this->Data);
+  }
+  if (this->MappingHandle != NULL)
+  {
+    CloseHandle(this->MappingHandle);
+    this->MappingHandle = NULL;
+  }
+  if (this->FileHandle != NULL)
+  {
+    CloseHandle(this->FileHandle);
+    this->FileHandle = NULL;
+  }
+#else
+  if (this->Data != NULL)
+  {
+    munmap(this->Data, this->Size);
+  }
+#endif
+  this->Data = NULL;
+  this->Size = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkInformationKeyMacro(vtkSlicerMetafileImporterLogic, RAW_DATA_MAPPING, ObjectBase);
+
+/*! Geometry and pixel data of the frames that are stored in a metaimage */
+struct FrameImagesType
+{
+  int Dimensions[3];
+  double Spacing[3];
+  int ScalarType;
+  int NumberOfScalarComponents;
+  unsigned char* PixelData;
+};
+
+//----------------------------------------------------------------------------
+/*! Get the VTK scalar type corresponding to a metafile element type. Returns -1 if the type is not supported. */
+int GetScalarTypeFromMetaElementType(const std::string& elementType)
+{
+  if (elementType == "MET_CHAR") { return VTK_CHAR; }
+  if (elementType == "MET_UCHAR") { return VTK_UNSIGNED_CHAR; }
+  if (elementType == "MET_SHORT") { return VTK_SHORT; }
+  if (elementType == "MET_USHORT") { return VTK_UNSIGNED_SHORT; }
+  if (elementType == "MET_INT") { return VTK_INT; }
+  if (elementType == "MET_UINT") { return VTK_UNSIGNED_INT; }
+  if (elementType == "MET_FLOAT") { return VTK_FLOAT; }
+  if (elementType == "MET_DOUBLE") { return VTK_DOUBLE; }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+std::string GetHeaderField(const std::map< std::string, std::string >& headerFields, const std::string& name, const std::string& defaultValue = "")
+{
+  std::map< std::string, std::string >::const_iterator fieldIt = headerFields.find(name);
+  return (fieldIt != headerFields.end()) ? fieldIt->second : defaultValue;
+}
+
+//----------------------------------------------------------------------------
+/*! Memory-map the uncompressed pixel data of a metaimage. Returns NULL if the pixel data cannot be mapped
+  (compressed data, byte swapping needed, multiple data files, ...), then the image has to be read with vtkMetaImageReader. */
+vtkSmartPointer<vtkMetafileRawDataMapping> MapPixelData(const std::string& fileName, const std::map< std::string, std::string >& headerFields,
+  long localPixelDataOffset, FrameImagesType& frameImages)
+{
+  if (GetHeaderField(headerFields, "CompressedData", "False") == "True"
+    || GetHeaderField(headerFields, "NDims") != "3")
+  {
+    return NULL;
+  }
+
+  std::stringstream dimSizeStr(GetHeaderField(headerFields, "DimSize"));
+  for (int i=0; i<3; i++)
+  {
+    frameImages.Dimensions[i] = 0;
+    dimSizeStr >> frameImages.Dimensions[i];
+  }
+  if (frameImages.Dimensions[0]<=0 || frameImages.Dimensions[1]<=0 || frameImages.Dimensions[2]<=0)
+  {
+    return NULL;
+  }
+  std::stringstream spacingStr(GetHeaderField(headerFields, "ElementSpacing", "1 1 1"));
+  for (int i=0; i<3; i++)
+  {
+    frameImages.Spacing[i] = 1.0;
+    spacingStr >> frameImages.Spacing[i];
+  }
+  frameImages.ScalarType = GetScalarTypeFromMetaElementType(GetHeaderField(headerFields, "ElementType"));
+  if (frameImages.ScalarType<0)
+  {
+    return NULL;
+  }
+  frameImages.NumberOfScalarComponents = atoi(GetHeaderField(headerFields, "ElementNumberOfChannels", "1").c_str());
+  if (frameImages.NumberOfScalarComponents<1)
+  {
+    return NULL;
+  }
+  size_t elementSize = vtkDataArray::GetDataTypeSize(frameImages.ScalarType);
+
+  std::string byteOrderMSB = GetHeaderField(headerFields, "BinaryDataByteOrderMSB", GetHeaderField(headerFields, "ElementByteOrderMSB", "False"));
+#ifdef VTK_WORDS_BIGENDIAN
+  bool byteSwapNeeded = (byteOrderMSB != "True");
+#else
+  bool byteSwapNeeded = (byteOrderMSB == "True");
+#endif
+  if (byteSwapNeeded && elementSize>1)
+  {
+    return NULL;
+  }
+
+  std::string elementDataFile = GetHeaderField(headerFields, "ElementDataFile");
+  std::string dataFileName;
+  long long dataOffset = 0;
+  if (elementDataFile == "LOCAL")
+  {
+    dataFileName = fileName;
+    dataOffset = localPixelDataOffset;
+  }
+  else if (elementDataFile.empty() || elementDataFile.find("LIST") == 0 || elementDataFile.find('%') != std::string::npos)
+  {
+    // pixel data is split into multiple files
+    return NULL;
+  }
+  else
+  {
+    dataFileName = vtksys::SystemTools::CollapseFullPath(elementDataFile.c_str(), vtksys::SystemTools::GetFilenamePath(fileName).c_str());
+    dataOffset = atol(GetHeaderField(headerFields, "HeaderSize", "0").c_str());
+  }
+
+  vtkSmartPointer<vtkMetafileRawDataMapping> mapping = vtkSmartPointer<vtkMetafileRawDataMapping>::New();
+  if (!mapping->Open(dataFileName))
+  {
+    vtkGenericWarningMacro("Failed to memory-map "<<dataFileName<<", pixel data will be read into memory");
+    return NULL;
+  }
+  unsigned long long pixelDataSize = static_cast<unsigned long long>(frameImages.Dimensions[0]) * frameImages.Dimensions[1] * frameImages.Dimensions[2]
+    * frameImages.NumberOfScalarComponents * elementSize;
+  if (dataOffset<0)
+  {
+    // HeaderSize = -1 means that the pixel data is at the end of the file
+    dataOffset = static_cast<long long>(mapping->GetSize()) - static_cast<long long>(pixelDataSize);
+  }
+  if (dataOffset<0 || static_cast<unsigned long long>(dataOffset) + pixelDataSize > mapping->GetSize())
+  {
+    vtkGenericWarningMacro("Pixel data in "<<dataFileName<<" is shorter than specified in the header, pixel data will be read into memory");
+    return NULL;
+  }
+  if (dataOffset % elementSize != 0)
+  {
+    // unaligned pixel data cannot be accessed directly
+    return NULL;
+  }
+  frameImages.PixelData = mapping->GetData() + dataOffset;
+  return mapping;
+}
+
+//----------------------------------------------------------------------------
+/*! Returns false if the metaimage header specifies zero size along any axis (the file contains no pixel data) */
+bool HasPixelData(const std::map< std::string, std::string >& headerFields)
+{
+  std::stringstream dimSizeStr(GetHeaderField(headerFields, "DimSize"));
+  int dimSize = 0;
+  while (dimSizeStr >> dimSize)
+  {
+    if (dimSize<=0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 // Read the spacing and dimentions of the image.
 vtkMRMLNode* vtkSlicerMetafileImporterLogic::ReadImages( const std::string& fileName )
 {
-  #ifdef ENABLE_PERFORMANCE_PROFILING
-  vtkSmartPointer<vtkTimerLog> timer=vtkSmartPointer<vtkTimerLog>::New();      
-  timer->StartTimer();  
+  FrameImagesType frameImages;
+  vtkSmartPointer<vtkMetafileRawDataMapping> rawDataMapping;
+  if (this->MemoryMapRawData)
+  {
+    rawDataMapping = MapPixelData(fileName, this->HeaderFields, this->LocalPixelDataOffset, frameImages);
+  }
+
+  vtkSmartPointer< vtkMetaImageReader > imageReader;
+  if (rawDataMapping==NULL)
+  {
+#ifdef ENABLE_PERFORMANCE_PROFILING
+    vtkSmartPointer<vtkTimerLog> timer=vtkSmartPointer<vtkTimerLog>::New();      
+    timer->StartTimer();  
 #endif
-  vtkSmartPointer< vtkMetaImageReader > imageReader = vtkSmartPointer< vtkMetaImageReader >::New();
-  imageReader->SetFileName( fileName.c_str() );
-  imageReader->Update();
+    imageReader = vtkSmartPointer< vtkMetaImageReader >::New();
+    imageReader->SetFileName( fileName.c_str() );
+    imageReader->Update();
 #ifdef ENABLE_PERFORMANCE_PROFILING
-  timer->StopTimer();
-  vtkWarningMacro("Image reading: " << timer->GetElapsedTime() << "sec\n");
+    timer->StopTimer();
+    vtkWarningMacro("Image reading: " << timer->GetElapsedTime() << "sec\n");
 #endif  
 
-  // check for loading error
-  // if there is a loading error then all the extents are set to 0
-  // (although it corresponds to an 1x1x1 image size)
-  if (imageReader->GetDataExtent()[0]==0 && imageReader->GetDataExtent()[1]==0
-    && imageReader->GetDataExtent()[2]==0 && imageReader->GetDataExtent()[3]==0
-    && imageReader->GetDataExtent()[4]==0 && imageReader->GetDataExtent()[5]==0)
-  {       
-    return NULL;
+    // check for loading error
+    // if there is a loading error then all the extents are set to 0
+    // (although it corresponds to an 1x1x1 image size)
+    if (imageReader->GetDataExtent()[0]==0 && imageReader->GetDataExtent()[1]==0
+      && imageReader->GetDataExtent()[2]==0 && imageReader->GetDataExtent()[3]==0
+      && imageReader->GetDataExtent()[4]==0 && imageReader->GetDataExtent()[5]==0)
+    {       
+      return NULL;
+    }
+
+    // Grab the image data from the mha file  
+    vtkImageData* imageData = imageReader->GetOutput();
+    imageData->GetDimensions(frameImages.Dimensions);
+    imageData->GetSpacing(frameImages.Spacing);
+    frameImages.ScalarType = imageData->GetScalarType();
+    frameImages.NumberOfScalarComponents = imageData->GetNumberOfScalarComponents();
+    frameImages.PixelData = static_cast<unsigned char*>(imageData->GetScalarPointer());
   }
 
   // Create sequence node
@@ -424,22 +857,14 @@ vtkMRMLNode* vtkSlicerMetafileImporterLogic::ReadImages( const std::string& file
 
   int imagesRootNodeDisableModify = imagesRootNode->StartModify();
 
-  // Grab the image data from the mha file  
-  vtkImageData* imageData = imageReader->GetOutput();
-  vtkSmartPointer<vtkImageData> emptySliceImageData=vtkSmartPointer<vtkImageData>::New();
-  int* dimensions = imageData->GetDimensions();
-  emptySliceImageData->SetDimensions(dimensions[0],dimensions[1],1);
-  double* spacing = imageData->GetSpacing();
-  emptySliceImageData->SetSpacing(spacing[0],spacing[1],1);
-  emptySliceImageData->SetOrigin(0,0,0);  
-  
-  int sliceSize=imageData->GetIncrements()[2];
-  for ( int frameNumber = 0; frameNumber < dimensions[2]; frameNumber++ )
+  vtkIdType numberOfSliceValues = static_cast<vtkIdType>(frameImages.Dimensions[0]) * frameImages.Dimensions[1] * frameImages.NumberOfScalarComponents;
+  size_t sliceSize = numberOfSliceValues * vtkDataArray::GetDataTypeSize(frameImages.ScalarType);
+  for ( int frameNumber = 0; frameNumber < frameImages.Dimensions[2]; frameNumber++ )
   {     
     // Add the image slice to scene as a volume    
 
     vtkSmartPointer< vtkMRMLScalarVolumeNode > slice;
-    if (imageData->GetNumberOfScalarComponents() > 1)
+    if (frameImages.NumberOfScalarComponents > 1)
     {
       slice = vtkSmartPointer< vtkMRMLVectorVolumeNode >::New();
     }
@@ -448,29 +873,65 @@ vtkMRMLNode* vtkSlicerMetafileImporterLogic::ReadImages( const std::string& file
       slice = vtkSmartPointer< vtkMRMLScalarVolumeNode >::New();
     }
     
-    vtkSmartPointer<vtkImageData> sliceImageData=vtkSmartPointer<vtkImageData>::New();
-    sliceImageData->DeepCopy(emptySliceImageData);
-
+    vtkSmartPointer<vtkImageData> sliceImageData;
+    unsigned char* startPtr=frameImages.PixelData+frameNumber*sliceSize;
+    if (rawDataMapping!=NULL)
+    {
+      sliceImageData=vtkSmartPointer<vtkImageData>::New();
+      sliceImageData->SetDimensions(frameImages.Dimensions[0],frameImages.Dimensions[1],1);
+      // The frame image is a view into the mapped file, pixel data is only read from disk when it is accessed
+      vtkDataArray* sliceScalars = vtkDataArray::CreateDataArray(frameImages.ScalarType);
+      sliceScalars->SetNumberOfComponents(frameImages.NumberOfScalarComponents);
+      sliceScalars->SetVoidArray(startPtr, numberOfSliceValues, 1);
+      // Keep the file mapped while the array is in use
+      sliceScalars->GetInformation()->Set(vtkSlicerMetafileImporterLogic::RAW_DATA_MAPPING(), rawDataMapping);
+      sliceImageData->GetPointData()->SetScalars(sliceScalars);
+      sliceScalars->Delete(); // now the image owns the array
 #if (VTK_MAJOR_VERSION <= 5)
-    sliceImageData->SetScalarType(imageData->GetScalarType());
-    sliceImageData->SetNumberOfScalarComponents(imageData->GetNumberOfScalarComponents());
-    sliceImageData->AllocateScalars();
-#else
-    sliceImageData->AllocateScalars(imageData->GetScalarType(), imageData->GetNumberOfScalarComponents());
+      sliceImageData->SetScalarType(frameImages.ScalarType);
+      sliceImageData->SetNumberOfScalarComponents(frameImages.NumberOfScalarComponents);
 #endif
-
-    unsigned char* startPtr=(unsigned char*)imageData->GetScalarPointer(0, 0, frameNumber);
-    memcpy(sliceImageData->GetScalarPointer(), startPtr, sliceSize);
+    }
+    else
+    {
+      // Reuse the pixel buffer of a previously removed sequence item, if available
+      int sliceDimensions[3] = { frameImages.Dimensions[0], frameImages.Dimensions[1], 1 };
+      sliceImageData=vtkSmartPointer<vtkImageData>::Take(vtkMRMLSequenceImageBufferPool::GetInstance()->NewImage(
+        sliceDimensions, frameImages.ScalarType, frameImages.NumberOfScalarComponents));
+      memcpy(sliceImageData->GetScalarPointer(), startPtr, sliceSize);
+    }
+    sliceImageData->SetSpacing(frameImages.Spacing[0],frameImages.Spacing[1],1);
+    sliceImageData->SetOrigin(0,0,0);
 
     // Generating a unique name is important because that will be used to generate the filename by default
     std::ostringstream nameStr;
     nameStr << IMAGE_NODE_BASE_NAME << std::setw(4) << std::setfill('0') << frameNumber << std::ends;
     slice->SetName(nameStr.str().c_str());
-    slice->SetAndObserveImageData(sliceImageData);
 
     std::string paramValueString=this->FrameNumberToIndexValueMap[frameNumber];
     slice->SetHideFromEditors(false);
+    // The image data is set after the node is copied into the sequence, so that the pixel data is not copied again
+    int numberOfItems = imagesRootNode->GetNumberOfDataNodes();
     imagesRootNode->SetDataNodeAtValue(slice, paramValueString.c_str() );
+    // New items are appended, items with the same index value are overwritten
+    bool newItem = (imagesRootNode->GetNumberOfDataNodes() > numberOfItems);
+    vtkMRMLScalarVolumeNode* sequenceSlice = vtkMRMLScalarVolumeNode::SafeDownCast(newItem
+      ? imagesRootNode->GetNthDataNode(numberOfItems) : imagesRootNode->GetDataNodeAtValue(paramValueString.c_str()));
+    if (sequenceSlice)
+    {
+      sequenceSlice->SetAndObserveImageData(sliceImageData);
+    }
+    if (this->InvalidImageFrameNumbers.find(frameNumber)!=this->InvalidImageFrameNumbers.end())
+    {
+      if (newItem)
+      {
+        imagesRootNode->SetNthItemValid(numberOfItems, false);
+      }
+      else
+      {
+        imagesRootNode->SetItemValidAtValue(paramValueString.c_str(), false);
+      }
+    }
   }
 
   imagesRootNode->EndModify(imagesRootNodeDisableModify);
@@ -482,7 +943,8 @@ vtkMRMLNode* vtkSlicerMetafileImporterLogic::ReadImages( const std::string& file
 void vtkSlicerMetafileImporterLogic
 ::Read( std::string fileName )
 {
-  //  this->GetMRMLScene()->StartState(vtkMRMLScene::BatchProcessState);
+  // All the created nodes are added to the scene in one batch
+  this->GetMRMLScene()->StartState(vtkMRMLScene::BatchProcessState);
 
   int dotFound = fileName.find_last_of( "." );
   int slashFound = fileName.find_last_of( "/" );
@@ -499,7 +961,12 @@ void vtkSlicerMetafileImporterLogic
   vtkWarningMacro("ReadTransforms time: " << timer->GetElapsedTime() << "sec\n");
   timer->StartTimer();
 #endif
-  vtkMRMLNode* createdImageNode=this->ReadImages( fileName ); // TODO: Removed error macro
+  // Files that contain only tracking data have no pixel data (DimSize = 0 0 N)
+  vtkMRMLNode* createdImageNode=NULL;
+  if (HasPixelData(this->HeaderFields))
+  {
+    createdImageNode=this->ReadImages( fileName ); // TODO: Removed error macro
+  }
 #ifdef ENABLE_PERFORMANCE_PROFILING
   timer->StopTimer();
   vtkWarningMacro("ReadImages time: " << timer->GetElapsedTime() << "sec\n");
@@ -508,6 +975,7 @@ void vtkSlicerMetafileImporterLogic
   // For the user's convenience, create a browser node that contains the image as master node
   // (the first transform node, if no image in the file) and the transforms as synchronized nodes
   vtkMRMLNode* masterNode=createdImageNode;
+  vtkMRMLNode* masterOutputNode=NULL;
   if (masterNode==NULL)
   {
     if (!createdTransformNodes.empty())
@@ -527,28 +995,371 @@ void vtkSlicerMetafileImporterLogic
     {
       sequenceBrowserNode->AddSynchronizedRootNode((*synchronizedNodesIt)->GetID());
     }
+    masterOutputNode=sequenceBrowserNode->GetVirtualOutputDataNode(vtkMRMLSequenceNode::SafeDownCast(masterNode));
+  }
+
+  this->GetMRMLScene()->EndState(vtkMRMLScene::BatchProcessState);
+
+  // Show output volume in the slice viewer (after the batch processing is completed, so that the views are updated)
+  if (masterOutputNode!=NULL && masterOutputNode->IsA("vtkMRMLVolumeNode"))
+  {
+    vtkSlicerApplicationLogic* appLogic = this->GetApplicationLogic();
+    vtkMRMLSelectionNode* selectionNode = appLogic ? appLogic->GetSelectionNode() : 0;
+    if (selectionNode)
+    {
+      selectionNode->SetReferenceActiveVolumeID(masterOutputNode->GetID());
+      if (appLogic)
+      {
+        appLogic->PropagateVolumeSelection();
+        appLogic->FitSliceToAll();
+      }
+    } 
+  }
+
+  this->FrameNumberToIndexValueMap.clear();
+  this->InvalidImageFrameNumbers.clear();
+  this->HeaderFields.clear();
+  this->BaseNodeName.clear();
+}
+
+//----------------------------------------------------------------------------
+/*! Get the metafile element type corresponding to a VTK scalar type. Returns empty string if the type is not supported. */
+std::string GetMetaElementTypeFromScalarType(int scalarType)
+{
+  switch (scalarType)
+  {
+  case VTK_CHAR:
+  case VTK_SIGNED_CHAR: return "MET_CHAR";
+  case VTK_UNSIGNED_CHAR: return "MET_UCHAR";
+  case VTK_SHORT: return "MET_SHORT";
+  case VTK_UNSIGNED_SHORT: return "MET_USHORT";
+  case VTK_INT: return "MET_INT";
+  case VTK_UNSIGNED_INT: return "MET_UINT";
+  case VTK_FLOAT: return "MET_FLOAT";
+  case VTK_DOUBLE: return "MET_DOUBLE";
+  default: return "";
+  }
+}
+
+//----------------------------------------------------------------------------
+/*! Get the numeric index values of a sequence with the corresponding item numbers, sorted by index value */
+void GetSortedNumericIndexValues(vtkMRMLSequenceNode* sequenceNode, std::vector< std::pair<double, int> >& sortedIndexValues)
+{
+  sortedIndexValues.clear();
+  int numberOfItems = sequenceNode->GetNumberOfDataNodes();
+  sortedIndexValues.reserve(numberOfItems);
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    sortedIndexValues.push_back(std::make_pair(atof(sequenceNode->GetNthIndexValue(itemNumber).c_str()), itemNumber));
+  }
+  std::sort(sortedIndexValues.begin(), sortedIndexValues.end());
+}
+
+//----------------------------------------------------------------------------
+/*! Get the item number that has the index value nearest to indexValue, if the difference is not larger than the tolerance.
+  Returns -1 if there is no such item. */
+int GetNearestItemNumber(const std::vector< std::pair<double, int> >& sortedIndexValues, double indexValue, double tolerance)
+{
+  std::vector< std::pair<double, int> >::const_iterator upperIt = std::lower_bound(sortedIndexValues.begin(), sortedIndexValues.end(),
+    std::make_pair(indexValue, -1));
+  std::vector< std::pair<double, int> >::const_iterator nearestIt = upperIt;
+  if (upperIt==sortedIndexValues.end() || (upperIt!=sortedIndexValues.begin() && indexValue-(upperIt-1)->first < upperIt->first-indexValue))
+  {
+    if (upperIt==sortedIndexValues.begin())
+    {
+      // empty sequence
+      return -1;
+    }
+    nearestIt = upperIt-1;
+  }
+  if (fabs(nearestIt->first-indexValue) > tolerance)
+  {
+    return -1;
+  }
+  return nearestIt->second;
+}
+
+//----------------------------------------------------------------------------
+/*! Get the frame field name of a transform sequence. Sequences that were imported from a metafile are written
+  with their original field name. Other sequences are named after the node, with a number appended if the name
+  is already used by another sequence (listed in usedFieldNames). */
+std::string GetTransformFrameFieldName(vtkMRMLSequenceNode* sequenceNode, const std::set<std::string>& usedFieldNames)
+{
+  const char* importedFieldName = sequenceNode->GetAttribute( FRAME_FIELD_NAME_ATTRIBUTE_NAME );
+  std::string sequenceName;
+  if ( importedFieldName != NULL )
+  {
+    sequenceName = importedFieldName;
+  }
+  else if ( sequenceNode->GetName() != NULL )
+  {
+    sequenceName = sequenceNode->GetName();
+  }
+  // Whitespace is not allowed in field names
+  std::string baseFieldName;
+  for (std::string::iterator charIt=sequenceName.begin(); charIt!=sequenceName.end(); ++charIt)
+  {
+    if (*charIt!=' ' && *charIt!='\t')
+    {
+      baseFieldName.push_back(*charIt);
+    }
+  }
+  if ( importedFieldName != NULL && usedFieldNames.find(baseFieldName) == usedFieldNames.end() )
+  {
+    return baseFieldName;
+  }
+  // The importer recognizes transforms by the Transform postfix (and ignores fields that contain Status)
+  std::string fieldNamePostfix = "Transform";
+  if ( baseFieldName.size() >= fieldNamePostfix.size()
+    && baseFieldName.compare( baseFieldName.size() - fieldNamePostfix.size(), fieldNamePostfix.size(), fieldNamePostfix ) == 0 )
+  {
+    baseFieldName.erase( baseFieldName.size() - fieldNamePostfix.size() );
+  }
+  std::string fieldName = baseFieldName + fieldNamePostfix;
+  for (int suffix=2; usedFieldNames.find(fieldName)!=usedFieldNames.end(); suffix++)
+  {
+    std::ostringstream fieldNameStr;
+    fieldNameStr << baseFieldName << suffix << fieldNamePostfix;
+    fieldName = fieldNameStr.str();
+  }
+  return fieldName;
+}
 
-    // Show output volume in the slice viewer
-    vtkMRMLNode* masterOutputNode=sequenceBrowserNode->GetVirtualOutputDataNode(vtkMRMLSequenceNode::SafeDownCast(masterNode));
-    if (masterOutputNode->IsA("vtkMRMLVolumeNode"))
+//----------------------------------------------------------------------------
+bool vtkSlicerMetafileImporterLogic::Write( vtkMRMLSequenceBrowserNode* browserNode, const std::string& fileName )
+{
+  if (browserNode==NULL)
+  {
+    vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: invalid browser node");
+    return false;
+  }
+  vtkMRMLSequenceNode* masterNode = browserNode->GetRootNode();
+  if (masterNode==NULL)
+  {
+    vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: browser node has no master sequence");
+    return false;
+  }
+  int numberOfFrames = masterNode->GetNumberOfDataNodes();
+
+  // Images are written if the master sequence contains volumes.
+  // All frames must have the same 2D geometry and pixel type, check it before anything is written to the file.
+  bool writeImages = (masterNode->GetDataNodeClassName().find("VolumeNode") != std::string::npos);
+  int dimensions[3] = { 0, 0, 1 };
+  int scalarType = VTK_VOID;
+  int numberOfScalarComponents = 1;
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  double directions[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+  std::string elementType;
+  if (writeImages)
+  {
+    for (int frameNumber=0; frameNumber<numberOfFrames; frameNumber++)
     {
-      vtkSlicerApplicationLogic* appLogic = this->GetApplicationLogic();
-      vtkMRMLSelectionNode* selectionNode = appLogic ? appLogic->GetSelectionNode() : 0;
-      if (selectionNode)
+      vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(masterNode->GetNthDataNode(frameNumber));
+      vtkImageData* imageData = volumeNode ? volumeNode->GetImageData() : NULL;
+      if (imageData==NULL)
+      {
+        vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: no image data in frame "<<frameNumber);
+        return false;
+      }
+      int* frameDimensions = imageData->GetDimensions();
+      if (frameNumber==0)
       {
-        selectionNode->SetReferenceActiveVolumeID(masterOutputNode->GetID());
-        if (appLogic)
+        dimensions[0] = frameDimensions[0];
+        dimensions[1] = frameDimensions[1];
+        dimensions[2] = frameDimensions[2];
+        scalarType = imageData->GetScalarType();
+        numberOfScalarComponents = imageData->GetNumberOfScalarComponents();
+        volumeNode->GetSpacing(spacing);
+        volumeNode->GetOrigin(origin);
+        volumeNode->GetIToRASDirection(directions[0]);
+        volumeNode->GetJToRASDirection(directions[1]);
+        volumeNode->GetKToRASDirection(directions[2]);
+        elementType = GetMetaElementTypeFromScalarType(scalarType);
+        if (elementType.empty())
         {
-          appLogic->PropagateVolumeSelection();
-          appLogic->FitSliceToAll();
+          vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: unsupported scalar type "<<imageData->GetScalarTypeAsString());
+          return false;
         }
-      } 
+        if (dimensions[2]!=1)
+        {
+          vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: only 2D frames are supported (frame 0 has "<<dimensions[2]<<" slices)");
+          return false;
+        }
+      }
+      else if (frameDimensions[0]!=dimensions[0] || frameDimensions[1]!=dimensions[1] || frameDimensions[2]!=dimensions[2]
+        || imageData->GetScalarType()!=scalarType || imageData->GetNumberOfScalarComponents()!=numberOfScalarComponents)
+      {
+        vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: frame "<<frameNumber<<" size or pixel type is different from the first frame");
+        return false;
+      }
     }
+  }
 
+  // Transforms: the master sequence (if it is a transform sequence) and all synchronized linear transform sequences
+  std::vector< vtkMRMLSequenceNode* > sequenceNodes;
+  browserNode->GetSynchronizedRootNodes(sequenceNodes, true);
+  std::vector< vtkMRMLSequenceNode* > transformSequenceNodes;
+  std::vector< std::string > transformFieldNames;
+  // Numeric index values are matched to the nearest transform, as the same value may be written differently
+  // in different sequences (e.g., 1.5 and 1.500). Other index values must match exactly.
+  bool numericIndex = (masterNode->GetIndexType()==vtkMRMLSequenceNode::NumericIndex);
+  std::vector< std::vector< std::pair<double, int> > > transformSortedIndexValues;
+  std::set< std::string > usedTransformFieldNames;
+  for (std::vector< vtkMRMLSequenceNode* >::iterator sequenceNodeIt=sequenceNodes.begin(); sequenceNodeIt!=sequenceNodes.end(); ++sequenceNodeIt)
+  {
+    std::string dataNodeClassName = (*sequenceNodeIt)->GetDataNodeClassName();
+    if (dataNodeClassName!="vtkMRMLLinearTransformNode" && dataNodeClassName!="vtkMRMLTransformNode")
+    {
+      continue;
+    }
+    transformSequenceNodes.push_back(*sequenceNodeIt);
+    transformSortedIndexValues.push_back(std::vector< std::pair<double, int> >());
+    if (numericIndex && (*sequenceNodeIt)->GetIndexType()==vtkMRMLSequenceNode::NumericIndex)
+    {
+      GetSortedNumericIndexValues(*sequenceNodeIt, transformSortedIndexValues.back());
+    }
+    std::string transformFieldName = GetTransformFrameFieldName(*sequenceNodeIt, usedTransformFieldNames);
+    transformFieldNames.push_back(transformFieldName);
+    usedTransformFieldNames.insert(transformFieldName);
   }
 
-//  this->GetMRMLScene()->EndState(vtkMRMLScene::BatchProcessState);
+  FILE* stream = fopen( fileName.c_str(), "wb" );
+  if (stream==NULL)
+  {
+    vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: cannot open file "<<fileName.c_str()<<" for writing");
+    return false;
+  }
 
-  this->FrameNumberToIndexValueMap.clear();
-  this->BaseNodeName.clear();
+  // Write header
+  std::ostringstream header;
+  header << "ObjectType = Image\n";
+  header << "NDims = 3\n";
+  header << "AnatomicalOrientation = RAI\n";
+  header << "BinaryData = True\n";
+#ifdef VTK_WORDS_BIGENDIAN
+  header << "BinaryDataByteOrderMSB = True\n";
+#else
+  header << "BinaryDataByteOrderMSB = False\n";
+#endif
+  header << "CompressedData = False\n";
+  if (writeImages)
+  {
+    header << "DimSize = " << dimensions[0] << " " << dimensions[1] << " " << numberOfFrames << "\n";
+    if (numberOfScalarComponents>1)
+    {
+      header << "ElementNumberOfChannels = " << numberOfScalarComponents << "\n";
+    }
+    // Geometry of the first frame. Metafile coordinates are LPS, while MRML coordinates are RAS.
+    header << std::setprecision(17);
+    header << "ElementSpacing = " << spacing[0] << " " << spacing[1] << " " << spacing[2] << "\n";
+    header << "Offset = " << -origin[0] << " " << -origin[1] << " " << origin[2] << "\n";
+    // Each row is the direction of an image axis
+    header << "TransformMatrix =";
+    for (int axis=0; axis<3; axis++)
+    {
+      header << " " << -directions[axis][0] << " " << -directions[axis][1] << " " << directions[axis][2];
+    }
+    header << "\n";
+    header << "ElementType = " << elementType << "\n";
+  }
+  else
+  {
+    // Tracking data only. There is no pixel data, so image geometry is not written. The element type is required
+    // by the file format, MET_UCHAR is used the same way as in tracking-only sequence metafiles of other applications.
+    header << "DimSize = 0 0 " << numberOfFrames << "\n";
+    header << "ElementType = MET_UCHAR\n";
+  }
+  fputs(header.str().c_str(), stream);
+
+  // Frame fields are written one frame at a time, to avoid building the whole header in memory
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int frameNumber=0; frameNumber<numberOfFrames; frameNumber++)
+  {
+    std::string indexValue = masterNode->GetNthIndexValue(frameNumber);
+    std::ostringstream frameFieldPrefixStr;
+    frameFieldPrefixStr << SEQMETA_FIELD_FRAME_FIELD_PREFIX << std::setw(4) << std::setfill('0') << frameNumber << "_";
+    std::string frameFieldPrefix = frameFieldPrefixStr.str();
+
+    std::ostringstream frameFields;
+    frameFields << std::setprecision(17);
+    for (unsigned int transformIndex=0; transformIndex<transformSequenceNodes.size(); transformIndex++)
+    {
+      vtkMRMLSequenceNode* transformSequenceNode = transformSequenceNodes[transformIndex];
+      vtkMRMLTransformNode* transformNode = NULL;
+      bool transformValid = false;
+      if (transformSequenceNode==masterNode)
+      {
+        transformNode = vtkMRMLTransformNode::SafeDownCast(masterNode->GetNthDataNode(frameNumber));
+        transformValid = masterNode->GetNthItemValid(frameNumber);
+      }
+      else if (numericIndex && transformSequenceNode->GetIndexType()==vtkMRMLSequenceNode::NumericIndex)
+      {
+        int transformItemNumber = GetNearestItemNumber(transformSortedIndexValues[transformIndex], atof(indexValue.c_str()), TRANSFORM_INDEX_VALUE_TOLERANCE);
+        if (transformItemNumber>=0)
+        {
+          transformNode = vtkMRMLTransformNode::SafeDownCast(transformSequenceNode->GetNthDataNode(transformItemNumber));
+          transformValid = transformSequenceNode->GetNthItemValid(transformItemNumber);
+        }
+      }
+      else
+      {
+        transformNode = vtkMRMLTransformNode::SafeDownCast(transformSequenceNode->GetDataNodeAtValue(indexValue.c_str()));
+        transformValid = transformSequenceNode->GetItemValidAtValue(indexValue.c_str());
+      }
+      transformValid = transformValid && transformNode!=NULL && transformNode->IsLinear();
+      if (transformValid)
+      {
+        transformNode->GetMatrixTransformToParent(matrix);
+      }
+      else
+      {
+        matrix->Identity();
+      }
+      frameFields << frameFieldPrefix << transformFieldNames[transformIndex] << " =";
+      for (int row=0; row<4; row++)
+      {
+        for (int column=0; column<4; column++)
+        {
+          frameFields << " " << matrix->GetElement(row, column);
+        }
+      }
+      frameFields << "\n";
+      frameFields << frameFieldPrefix << transformFieldNames[transformIndex] << "Status = " << (transformValid ? "OK" : "INVALID") << "\n";
+    }
+    frameFields << frameFieldPrefix << "Timestamp = " << indexValue << "\n";
+    if (writeImages)
+    {
+      frameFields << frameFieldPrefix << SEQMETA_FIELD_IMG_STATUS << " = " << (masterNode->GetNthItemValid(frameNumber) ? "OK" : "INVALID") << "\n";
+    }
+    fputs(frameFields.str().c_str(), stream);
+  }
+  fputs("ElementDataFile = LOCAL\n", stream);
+
+  // Write pixel data directly from the frame images
+  bool success = true;
+  if (writeImages)
+  {
+    size_t frameSizeBytes = static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2];
+    for (int frameNumber=0; frameNumber<numberOfFrames; frameNumber++)
+    {
+      vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(masterNode->GetNthDataNode(frameNumber));
+      vtkImageData* imageData = volumeNode->GetImageData();
+      size_t bytesToWrite = frameSizeBytes * imageData->GetNumberOfScalarComponents() * imageData->GetScalarSize();
+      if (fwrite(imageData->GetScalarPointer(), 1, bytesToWrite, stream) != bytesToWrite)
+      {
+        vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: error writing pixel data of frame "<<frameNumber<<" to "<<fileName.c_str());
+        success = false;
+        break;
+      }
+    }
+  }
+
+  if ( ferror( stream ) )
+  {
+    vtkErrorMacro("vtkSlicerMetafileImporterLogic::Write failed: error writing the file "<<fileName.c_str());
+    success = false;
+  }
+  fclose( stream );
+  return success;
 }
@@ -27,6 +27,8 @@
 // STD includes
 #include <cstdlib>
 #include <deque>
+#include <map>
+#include <set>
 
 // VTK includes
 #include "vtkMatrix4x4.h"
@@ -41,6 +43,8 @@
 #include "vtkSlicerMetafileImporterModuleLogicExport.h"
 #include "vtkSlicerSequencesLogic.h"
 
+class vtkInformationObjectBaseKey;
+class vtkMRMLSequenceBrowserNode;
 class vtkMRMLSequenceNode;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
@@ -74,6 +78,22 @@ public:
   /*! Read file contents into the object */
   void Read( std::string fileName );
 
+  /*! If enabled, uncompressed pixel data (in the metafile or in a separate .raw file) is memory-mapped instead of read into memory.
+    Each frame image is then a view into the mapped file: opening is fast and only the frames that are accessed are paged in.
+    The mapping is copy-on-write, modifying the images does not change the file. Disabled by default. */
+  vtkSetMacro(MemoryMapRawData, bool);
+  vtkGetMacro(MemoryMapRawData, bool);
+  vtkBooleanMacro(MemoryMapRawData, bool);
+
+  /*! Information key of memory-mapped image arrays that keeps the mapped file alive while the array exists */
+  static vtkInformationObjectBaseKey* RAW_DATA_MAPPING();
+
+  /*! Write the master sequence of the browser node and all synchronized linear transform sequences to a sequence metafile.
+    Pixel data of the image frames is written directly from the frame images, one frame at a time, so no 3D volume is allocated.
+    Image geometry (spacing, origin, axis directions) is taken from the first frame. Transform sequences that were imported
+    from a metafile are written with their original frame field names. Returns true on success. */
+  bool Write( vtkMRMLSequenceBrowserNode* browserNode, const std::string& fileName );
+
 protected:
 
   /*! Read all the fields in the metaimage file header */
@@ -91,6 +111,17 @@ protected:
   /*! Map the frame numbers to timestamps */
   std::map< int, std::string > FrameNumberToIndexValueMap;
 
+  /*! Frame numbers where the image status is not OK */
+  std::set< int > InvalidImageFrameNumbers;
+
+  /*! Fields of the metaimage header that are not frame fields (DimSize, ElementType, ElementDataFile, ...) */
+  std::map< std::string, std::string > HeaderFields;
+
+  /*! Position of the pixel data in the file if ElementDataFile is LOCAL */
+  long LocalPixelDataOffset;
+
+  bool MemoryMapRawData;
+
   std::string BaseNodeName;
 
 };
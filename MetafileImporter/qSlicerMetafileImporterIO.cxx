@@ -94,6 +94,9 @@ bool qSlicerMetafileImporterIO::load(const IOProperties& properties)
   }
   QString fileName = properties["fileName"].toString();
   
+  // The logic is shared by all loads, so the flag is set each time (files are not mapped unless requested)
+  d->MetafileImporterLogic->SetMemoryMapRawData(properties.value("memoryMapRawData", false).toBool());
+
   d->MetafileImporterLogic->Read( fileName.toStdString() );
 
   return true; // TODO: Check to see read was successful first
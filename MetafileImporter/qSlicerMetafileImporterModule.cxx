@@ -26,9 +26,9 @@
 #include "qSlicerMetafileImporterModule.h"
 #include "qSlicerMetafileImporterModuleWidget.h"
 #include "qSlicerMetafileImporterIO.h"
+#include "qSlicerMetafileImporterWriter.h"
 
 // Slicer includes
-#include "qSlicerNodeWriter.h"
 #include "qSlicerCoreIOManager.h"
 
 //-----------------------------------------------------------------------------
@@ -122,7 +122,7 @@ void qSlicerMetafileImporterModule::setup()
 
   // Register the IO
   app->coreIOManager()->registerIO( new qSlicerMetafileImporterIO( metafileImporterLogic, this ) );
-  app->coreIOManager()->registerIO( new qSlicerNodeWriter( "MetafileImporter", QString( "SequenceMetafile" ), QStringList(), this ) ); 
+  app->coreIOManager()->registerIO( new qSlicerMetafileImporterWriter( metafileImporterLogic, this ) );
 
 }
 
@@ -0,0 +1,115 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Qt includes
+#include <QDebug>
+
+// SlicerQt includes
+#include "qSlicerMetafileImporterWriter.h"
+
+// Logic includes
+#include "vtkSlicerMetafileImporterLogic.h"
+
+// MRML includes
+#include "vtkMRMLScene.h"
+#include "vtkMRMLSequenceBrowserNode.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+//-----------------------------------------------------------------------------
+class qSlicerMetafileImporterWriterPrivate
+{
+public:
+  vtkSmartPointer<vtkSlicerMetafileImporterLogic> MetafileImporterLogic;
+};
+
+//-----------------------------------------------------------------------------
+qSlicerMetafileImporterWriter::qSlicerMetafileImporterWriter( vtkSlicerMetafileImporterLogic* newMetafileImporterLogic, QObject* _parent)
+  : Superclass(_parent)
+  , d_ptr(new qSlicerMetafileImporterWriterPrivate)
+{
+  this->setMetafileImporterLogic( newMetafileImporterLogic );
+}
+
+//-----------------------------------------------------------------------------
+qSlicerMetafileImporterWriter::~qSlicerMetafileImporterWriter()
+{
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerMetafileImporterWriter::setMetafileImporterLogic(vtkSlicerMetafileImporterLogic* newMetafileImporterLogic)
+{
+  Q_D(qSlicerMetafileImporterWriter);
+  d->MetafileImporterLogic = newMetafileImporterLogic;
+}
+
+//-----------------------------------------------------------------------------
+vtkSlicerMetafileImporterLogic* qSlicerMetafileImporterWriter::MetafileImporterLogic() const
+{
+  Q_D(const qSlicerMetafileImporterWriter);
+  return d->MetafileImporterLogic;
+}
+
+//-----------------------------------------------------------------------------
+QString qSlicerMetafileImporterWriter::description() const
+{
+  return "Sequence Metafile";
+}
+
+//-----------------------------------------------------------------------------
+qSlicerIO::IOFileType qSlicerMetafileImporterWriter::fileType() const
+{
+  return QString("Sequence Metafile");
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerMetafileImporterWriter::canWriteObject(vtkObject* object) const
+{
+  return vtkMRMLSequenceBrowserNode::SafeDownCast(object) != NULL;
+}
+
+//-----------------------------------------------------------------------------
+QStringList qSlicerMetafileImporterWriter::extensions(vtkObject* vtkNotUsed(object)) const
+{
+  return QStringList() << "Sequence Metafile (*.mha)";
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerMetafileImporterWriter::write(const qSlicerIO::IOProperties& properties)
+{
+  Q_D(qSlicerMetafileImporterWriter);
+  if (!properties.contains("nodeID") || !properties.contains("fileName"))
+  {
+    qCritical() << "qSlicerMetafileImporterWriter::write did not receive nodeID and fileName properties";
+    return false;
+  }
+  vtkMRMLSequenceBrowserNode* browserNode = vtkMRMLSequenceBrowserNode::SafeDownCast(
+    this->mrmlScene() ? this->mrmlScene()->GetNodeByID(properties["nodeID"].toString().toLatin1().constData()) : NULL);
+  if (browserNode == NULL)
+  {
+    qCritical() << "qSlicerMetafileImporterWriter::write failed: invalid sequence browser node" << properties["nodeID"].toString();
+    return false;
+  }
+  QString fileName = properties["fileName"].toString();
+  if (!d->MetafileImporterLogic->Write( browserNode, fileName.toStdString() ))
+  {
+    return false;
+  }
+  this->setWrittenNodes(QStringList() << browserNode->GetID());
+  return true;
+}
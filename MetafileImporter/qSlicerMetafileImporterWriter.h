@@ -0,0 +1,61 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __qSlicerMetafileImporterWriter_h
+#define __qSlicerMetafileImporterWriter_h
+
+// SlicerQt includes
+#include "qSlicerFileWriter.h"
+class qSlicerMetafileImporterWriterPrivate;
+
+// Slicer includes
+class vtkSlicerMetafileImporterLogic;
+
+//-----------------------------------------------------------------------------
+/// Writes the master image sequence and the synchronized linear transform sequences
+/// of a sequence browser node into a sequence metafile.
+class qSlicerMetafileImporterWriter
+  : public qSlicerFileWriter
+{
+  Q_OBJECT
+public:
+  typedef qSlicerFileWriter Superclass;
+  qSlicerMetafileImporterWriter( vtkSlicerMetafileImporterLogic* newMetafileImporterLogic = 0, QObject* parent = 0 );
+  virtual ~qSlicerMetafileImporterWriter();
+
+  void setMetafileImporterLogic( vtkSlicerMetafileImporterLogic* newMetafileImporterLogic);
+  vtkSlicerMetafileImporterLogic* MetafileImporterLogic() const;
+
+  virtual QString description() const;
+  virtual IOFileType fileType() const;
+
+  /// Only sequence browser nodes can be written
+  virtual bool canWriteObject( vtkObject* object ) const;
+  virtual QStringList extensions( vtkObject* object ) const;
+
+  /// Write the browser node specified by the nodeID property into the file specified by the fileName property
+  virtual bool write( const qSlicerIO::IOProperties& properties );
+
+protected:
+  QScopedPointer< qSlicerMetafileImporterWriterPrivate > d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE( qSlicerMetafileImporterWriter );
+  Q_DISABLE_COPY( qSlicerMetafileImporterWriter );
+};
+
+#endif
@@ -34,149 +34,1056 @@
 #include "vtkMRMLScene.h"
 
 // VTK includes
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkIntArray.h>
+#include <vtkMath.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkStringArray.h>
+#include <vtkTable.h>
 #include <vtkTimerLog.h>
 
 // STL includes
 #include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
 
 #ifdef ENABLE_PERFORMANCE_PROFILING
 #include "vtkTimerLog.h"
 #endif 
 
+// Minimum number of sequence items for computing region statistics in parallel
+static const int MIN_NUMBER_OF_ITEMS_FOR_PARALLEL_REGION_STATISTICS = 4;
+
+// Achieved playback frame rate is computed from the items displayed during this time period
+static const double PLAYBACK_STATISTICS_FPS_TIME_WINDOW_SEC = 2.0;
+
+// Update latency percentiles are computed from this many most recent updates
+static const unsigned int PLAYBACK_STATISTICS_MAX_NUMBER_OF_LATENCY_SAMPLES = 300;
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerSequenceBrowserLogic);
 
+//----------------------------------------------------------------------------
+// Consecutive voxels of an image row that belong to the region
+struct RegionVoxelRunType
+{
+  vtkIdType FirstVoxelIndex;
+  int NumberOfVoxels;
+};
+
+//----------------------------------------------------------------------------
+// Returns true if the voxels of two volumes are at the same position (IJK to RAS matrices are equal, within rounding errors)
+bool IsSameIjkToRasMatrix(vtkMatrix4x4* matrix1, vtkMatrix4x4* matrix2)
+{
+  const double tolerance = 1e-6;
+  for (int row=0; row<3; row++)
+  {
+    for (int column=0; column<4; column++)
+    {
+      if (fabs(matrix1->GetElement(row, column)-matrix2->GetElement(row, column))>tolerance)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Statistics of the region voxel values in one sequence item
+struct RegionStatisticsType
+{
+  vtkIdType NumberOfVoxels;
+  double Sum;
+  double SumOfSquares;
+  double Minimum;
+  double Maximum;
+};
+
+//----------------------------------------------------------------------------
+// Input and output of the threads that compute region statistics
+struct ComputeRegionStatisticsThreadDataType
+{
+  // Images of the sequence items (NULL if the item is not a compatible image)
+  std::vector<vtkImageData*>* Images;
+  std::vector<RegionVoxelRunType>* VoxelRuns;
+  std::vector<RegionStatisticsType>* Statistics;
+  int Component;
+};
+
+//----------------------------------------------------------------------------
+// Accumulate the statistics of the region voxels in a single pass over the image.
+// Each run is a contiguous range of voxels, which keeps the inner loop simple enough for the compiler to vectorize.
+template <class T>
+void ComputeRegionStatistics(const T* scalars, int numberOfComponents, int component,
+  const std::vector<RegionVoxelRunType>& voxelRuns, RegionStatisticsType& statistics)
+{
+  double sum = 0.0;
+  double sumOfSquares = 0.0;
+  T minimum = scalars[voxelRuns.front().FirstVoxelIndex*numberOfComponents+component];
+  T maximum = minimum;
+  vtkIdType numberOfVoxels = 0;
+  for (std::vector<RegionVoxelRunType>::const_iterator runIt = voxelRuns.begin(); runIt != voxelRuns.end(); ++runIt)
+  {
+    const T* runValues = scalars + runIt->FirstVoxelIndex*numberOfComponents + component;
+    const int runLength = runIt->NumberOfVoxels;
+    for (int i = 0; i < runLength; i++)
+    {
+      const T value = runValues[i*numberOfComponents];
+      sum += value;
+      sumOfSquares += static_cast<double>(value)*value;
+      minimum = (value < minimum) ? value : minimum;
+      maximum = (value > maximum) ? value : maximum;
+    }
+    numberOfVoxels += runLength;
+  }
+  statistics.NumberOfVoxels = numberOfVoxels;
+  statistics.Sum = sum;
+  statistics.SumOfSquares = sumOfSquares;
+  statistics.Minimum = minimum;
+  statistics.Maximum = maximum;
+}
+
+//----------------------------------------------------------------------------
+// Compute region statistics of the sequence items that are assigned to this thread.
+// Only the images are read, therefore items can be processed in parallel.
+VTK_THREAD_RETURN_TYPE ComputeRegionStatisticsThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ComputeRegionStatisticsThreadDataType* threadData = static_cast<ComputeRegionStatisticsThreadDataType*>(threadInfo->UserData);
+  int numberOfItems = threadData->Images->size();
+  for (int itemIndex = threadInfo->ThreadID; itemIndex < numberOfItems; itemIndex += threadInfo->NumberOfThreads)
+  {
+    vtkImageData* imageData = (*threadData->Images)[itemIndex];
+    if (imageData == NULL)
+    {
+      continue;
+    }
+    vtkDataArray* scalars = imageData->GetPointData()->GetScalars();
+    RegionStatisticsType& statistics = (*threadData->Statistics)[itemIndex];
+    switch (scalars->GetDataType())
+    {
+      vtkTemplateMacro(ComputeRegionStatistics<VTK_TT>(static_cast<VTK_TT*>(scalars->GetVoidPointer(0)),
+        scalars->GetNumberOfComponents(), threadData->Component, *threadData->VoxelRuns, statistics));
+    }
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+// Returns the index value where real-time playback of the last item ends
+// (the last item is displayed for the average time between items)
+double GetRealTimePlaybackEndIndexValue(const std::vector<double>& indexValues)
+{
+  int numberOfItems = indexValues.size();
+  if (numberOfItems<1)
+  {
+    return 0.0;
+  }
+  double lastIndexValue = indexValues[numberOfItems-1];
+  if (numberOfItems<2)
+  {
+    return lastIndexValue;
+  }
+  double firstIndexValue = indexValues[0];
+  return lastIndexValue + (lastIndexValue-firstIndexValue)/(numberOfItems-1);
+}
+
+//----------------------------------------------------------------------------
+// Returns the item that has the index value nearest to the specified value (-1 if the sequence is empty).
+// Index values are assumed to be increasing (as in recorded sequences).
+int GetNearestItemNumber(const std::vector<double>& indexValues, double indexValue)
+{
+  int numberOfItems = indexValues.size();
+  if (numberOfItems<1)
+  {
+    return -1;
+  }
+  // find the first item that has an index value >= indexValue (or the last item)
+  int lowerItemNumber = 0;
+  int upperItemNumber = numberOfItems-1;
+  while (lowerItemNumber<upperItemNumber)
+  {
+    int middleItemNumber = (lowerItemNumber+upperItemNumber)/2;
+    if (indexValues[middleItemNumber]<indexValue)
+    {
+      lowerItemNumber = middleItemNumber+1;
+    }
+    else
+    {
+      upperItemNumber = middleItemNumber;
+    }
+  }
+  if (lowerItemNumber>0 && indexValue-indexValues[lowerItemNumber-1] < indexValues[lowerItemNumber]-indexValue)
+  {
+    return lowerItemNumber-1;
+  }
+  return lowerItemNumber;
+}
+
 //----------------------------------------------------------------------------
 vtkSlicerSequenceBrowserLogic::vtkSlicerSequenceBrowserLogic()
-: UpdateVirtualOutputNodesInProgress(false)
+: PlaybackUpdateDueTimeSec(-1.0)
+, CompatibleNodesGeneration(0)
+, NumberOfPlayingBrowserNodes(0)
+, UpdateVirtualOutputNodesInProgress(false)
+, UpdateAllVirtualOutputNodesInProgress(false)
+{
+  this->ShallowCopyMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+}
+
+//----------------------------------------------------------------------------
+vtkSlicerSequenceBrowserLogic::~vtkSlicerSequenceBrowserLogic()
+{  
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+{
+  this->BrowserNodes.clear();
+  this->PlaybackClocks.clear();
+  this->SharedPlaybackClocks.clear();
+  this->NumberOfSkippedItems.clear();
+  this->PlaybackStatistics.clear();
+  this->NumericIndexValues.clear();
+  this->VirtualOutputUpdateStates.clear();
+  this->VirtualOutputImages.clear();
+  this->SequenceNodesByIndexName.clear();
+  this->SequenceNodeIndexNames.clear();
+  this->CompatibleNodesGeneration++;
+  vtkNew<vtkIntArray> events;
+  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
+  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
+  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
+  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+}
+
+//-----------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::RegisterNodes()
+{
+  if (this->GetMRMLScene()==NULL)
+  {
+    vtkErrorMacro("Scene is invalid");
+    return;
+  }
+  this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceBrowserNode>::New());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::UpdateFromMRMLScene()
+{
+  if (this->GetMRMLScene()==NULL)
+  {
+    vtkErrorMacro("Scene is invalid");
+    return;
+  }
+  // Observe all the browser nodes (nodes that are already in the scene don't trigger a NodeAdded event)
+  std::vector< vtkMRMLNode* > browserNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLSequenceBrowserNode", browserNodes);
+  for (std::vector< vtkMRMLNode* >::iterator browserNodeIt=browserNodes.begin(); browserNodeIt!=browserNodes.end(); ++browserNodeIt)
+  {
+    this->OnMRMLSceneNodeAdded(*browserNodeIt);
+  }
+  // Register all the sequence nodes (the registry may be incomplete if nodes were added while the logic was not observing the scene)
+  std::vector< vtkMRMLNode* > sequenceNodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLSequenceNode", sequenceNodes);
+  for (std::vector< vtkMRMLNode* >::iterator sequenceNodeIt=sequenceNodes.begin(); sequenceNodeIt!=sequenceNodes.end(); ++sequenceNodeIt)
+  {
+    this->OnMRMLSceneNodeAdded(*sequenceNodeIt);
+  }
+  this->UpdatePlaybackState();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  if (node==NULL)
+  {
+    vtkErrorMacro("An invalid node is attempted to be added");
+    return;
+  }
+  if (node->IsA("vtkMRMLSequenceBrowserNode"))
+  {
+    vtkDebugMacro("OnMRMLSceneNodeAdded: Have a vtkMRMLSequenceBrowserNode node");
+    vtkUnObserveMRMLNodeMacro(node); // remove any previous observation that might have been added
+    vtkObserveMRMLNodeMacro(node);
+    this->BrowserNodes.insert(vtkMRMLSequenceBrowserNode::SafeDownCast(node));
+    this->UpdatePlaybackState();
+  }
+  else if (node->IsA("vtkMRMLSequenceNode"))
+  {
+    // Sequence nodes are observed to keep the index name registry up-to-date
+    vtkUnObserveMRMLNodeMacro(node); // remove any previous observation that might have been added
+    vtkObserveMRMLNodeMacro(node);
+    this->UpdateSequenceNodeIndexNameRegistry(vtkMRMLSequenceNode::SafeDownCast(node));
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  if (node==NULL)
+  {
+    vtkErrorMacro("An invalid node is attempted to be removed");
+    return;
+  }
+  this->VirtualOutputImages.erase(node);
+  if (node->IsA("vtkMRMLSequenceBrowserNode"))
+  {
+    vtkDebugMacro("OnMRMLSceneNodeRemoved: Have a vtkMRMLSequenceBrowserNode node");
+    vtkUnObserveMRMLNodeMacro(node);
+    vtkMRMLSequenceBrowserNode* browserNode = vtkMRMLSequenceBrowserNode::SafeDownCast(node);
+    this->BrowserNodes.erase(browserNode);
+    this->PlaybackClocks.erase(browserNode);
+    this->NumberOfSkippedItems.erase(browserNode);
+    this->PlaybackStatistics.erase(browserNode);
+    this->VirtualOutputUpdateStates.erase(browserNode);
+    this->UpdatePlaybackState();
+  }
+  else if (node->IsA("vtkMRMLSequenceNode"))
+  {
+    vtkUnObserveMRMLNodeMacro(node);
+    this->RemoveSequenceNodeFromIndexNameRegistry(vtkMRMLSequenceNode::SafeDownCast(node));
+    this->NumericIndexValues.erase(vtkMRMLSequenceNode::SafeDownCast(node));
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::UpdateSequenceNodeIndexNameRegistry(vtkMRMLSequenceNode* sequenceNode)
+{
+  const char* indexName = sequenceNode->GetIndexName();
+  std::map< vtkMRMLSequenceNode*, std::string >::iterator registeredIndexNameIt = this->SequenceNodeIndexNames.find(sequenceNode);
+  if (registeredIndexNameIt!=this->SequenceNodeIndexNames.end())
+  {
+    if (indexName!=NULL && registeredIndexNameIt->second.compare(indexName)==0)
+    {
+      // index name is not changed (this is the case for most modifications, such as adding an item)
+      return;
+    }
+  }
+  else if (indexName==NULL)
+  {
+    // not registered and cannot be registered
+    return;
+  }
+  this->RemoveSequenceNodeFromIndexNameRegistry(sequenceNode);
+  if (indexName==NULL)
+  {
+    return;
+  }
+  this->SequenceNodesByIndexName[indexName].push_back(sequenceNode);
+  this->SequenceNodeIndexNames[sequenceNode] = indexName;
+  this->CompatibleNodesGeneration++;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::RemoveSequenceNodeFromIndexNameRegistry(vtkMRMLSequenceNode* sequenceNode)
 {
+  std::map< vtkMRMLSequenceNode*, std::string >::iterator registeredIndexNameIt = this->SequenceNodeIndexNames.find(sequenceNode);
+  if (registeredIndexNameIt==this->SequenceNodeIndexNames.end())
+  {
+    return;
+  }
+  std::map< std::string, std::vector< vtkMRMLSequenceNode* > >::iterator sequenceNodesIt = this->SequenceNodesByIndexName.find(registeredIndexNameIt->second);
+  if (sequenceNodesIt!=this->SequenceNodesByIndexName.end())
+  {
+    std::vector< vtkMRMLSequenceNode* >& sequenceNodes = sequenceNodesIt->second;
+    sequenceNodes.erase(std::remove(sequenceNodes.begin(), sequenceNodes.end(), sequenceNode), sequenceNodes.end());
+    if (sequenceNodes.empty())
+    {
+      this->SequenceNodesByIndexName.erase(sequenceNodesIt);
+    }
+  }
+  this->SequenceNodeIndexNames.erase(registeredIndexNameIt);
+  this->CompatibleNodesGeneration++;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::UpdateAllVirtualOutputNodes()
+{
+  double updateStartTimeSec = vtkTimerLog::GetUniversalTime();
+
+  vtkMRMLScene* scene=this->GetMRMLScene();
+  if (scene==NULL)
+  {
+    vtkErrorMacro("vtkSlicerSequenceBrowserLogic::UpdateAllVirtualOutputNodes failed: scene is invalid");
+    return;
+  }
+  // The update timer fires late if the application was busy (typically with rendering the previous item)
+  double updateDelaySec = 0.0;
+  if (this->PlaybackUpdateDueTimeSec>=0 && updateStartTimeSec>this->PlaybackUpdateDueTimeSec)
+  {
+    updateDelaySec = updateStartTimeSec-this->PlaybackUpdateDueTimeSec;
+  }
+  this->PlaybackUpdateDueTimeSec = -1.0;
+  this->UpdateAllVirtualOutputNodesInProgress = true;
+  for (std::map< vtkMRMLSequenceBrowserNode*, PlaybackClockType >::iterator clockIt=this->PlaybackClocks.begin(); clockIt!=this->PlaybackClocks.end(); ++clockIt)
+  {
+    PlaybackStatisticsType& statistics = this->PlaybackStatistics[clockIt->first];
+    statistics.NumberOfPlaybackUpdates++;
+    statistics.TotalPlaybackUpdateDelaySec += updateDelaySec;
+  }
+
+  // Browser nodes that use a shared clock are all updated at once
+  this->UpdateSharedPlaybackClocks(updateStartTimeSec);
+  // Browser nodes may be removed during update, therefore iterate through a copy of the list
+  std::vector< vtkMRMLSequenceBrowserNode* > browserNodes(this->BrowserNodes.begin(), this->BrowserNodes.end());
+  for (std::vector< vtkMRMLSequenceBrowserNode* >::iterator browserNodeIt=browserNodes.begin(); browserNodeIt!=browserNodes.end(); ++browserNodeIt)
+  {
+    vtkMRMLSequenceBrowserNode* browserNode = (*browserNodeIt);
+    if (this->BrowserNodes.find(browserNode)==this->BrowserNodes.end())
+    {
+      // browser node has been removed meanwhile
+      continue;
+    }
+    if (!browserNode->GetPlaybackActive())
+    {
+      this->PlaybackClocks.erase(browserNode);
+      continue;
+    }
+    if (this->IsSharedClockPlayback(browserNode))
+    {
+      // already updated
+      continue;
+    }
+    std::map< vtkMRMLSequenceBrowserNode*, PlaybackClockType >::iterator clockIt = this->PlaybackClocks.find(browserNode);
+    if (clockIt == this->PlaybackClocks.end())
+    {
+      // we just started to play now, no need to update output nodes yet
+      PlaybackClockType clock;
+      clock.LastUpdateTimeSec = updateStartTimeSec;
+      clock.ElapsedTimeRemainderSec = 0.0;
+      clock.SelectedItemNumber = browserNode->GetSelectedItemNumber();
+      clock.PlaybackIndexValue = 0.0;
+      if (browserNode->GetRootNode()!=NULL && clock.SelectedItemNumber>=0)
+      {
+        clock.PlaybackIndexValue = this->GetNthNumericIndexValue(browserNode->GetRootNode(), clock.SelectedItemNumber);
+      }
+      this->PlaybackClocks[browserNode] = clock;
+      this->NumberOfSkippedItems[browserNode] = 0;
+      this->ResetPlaybackStatistics(browserNode);
+      continue;
+    }
+
+    // play is already in progress
+    PlaybackClockType& clock = clockIt->second;
+    double elapsedTimeSec = updateStartTimeSec - clock.LastUpdateTimeSec;
+    clock.LastUpdateTimeSec = updateStartTimeSec;
+    int selectionIncrement = 0;
+    if (this->IsRealTimePlayback(browserNode))
+    {
+      selectionIncrement = this->GetRealTimeSelectionIncrement(browserNode, clock, elapsedTimeSec);
+    }
+    else if (browserNode->GetPlaybackRateFps()>0)
+    {
+      // compute how many items we need to jump; the fractional part of the elapsed time is kept
+      // for the next update, so that the playback rate does not drift
+      clock.ElapsedTimeRemainderSec += elapsedTimeSec;
+      selectionIncrement = static_cast<int>(floor(clock.ElapsedTimeRemainderSec * browserNode->GetPlaybackRateFps()));
+      clock.ElapsedTimeRemainderSec -= selectionIncrement / browserNode->GetPlaybackRateFps();
+    }
+    if (selectionIncrement>0)
+    {
+      // if we have to jump more than one item then the items in between are never displayed
+      this->NumberOfSkippedItems[browserNode] += selectionIncrement-1;
+      this->SelectNextItem(browserNode, selectionIncrement);
+      // playback may have been stopped, which removes the clock
+      clockIt = this->PlaybackClocks.find(browserNode);
+      if (clockIt != this->PlaybackClocks.end())
+      {
+        clockIt->second.SelectedItemNumber = browserNode->GetSelectedItemNumber();
+      }
+    }
+  }
+  this->UpdateAllVirtualOutputNodesInProgress = false;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSequenceBrowserLogic::IsRealTimePlayback(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  if (!browserNode->GetPlaybackRealTime())
+  {
+    return false;
+  }
+  vtkMRMLSequenceNode* rootNode = browserNode->GetRootNode();
+  if (rootNode==NULL || rootNode->GetIndexType()!=vtkMRMLSequenceNode::NumericIndex)
+  {
+    return false;
+  }
+  // at least two items with increasing index values are needed to determine the playback time
+  int numberOfItems = rootNode->GetNumberOfDataNodes();
+  return (numberOfItems>=2 && this->GetNthNumericIndexValue(rootNode, numberOfItems-1) > this->GetNthNumericIndexValue(rootNode, 0));
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerSequenceBrowserLogic::GetRealTimeSelectionIncrement(vtkMRMLSequenceBrowserNode* browserNode, PlaybackClockType& clock, double elapsedTimeSec)
+{
+  vtkMRMLSequenceNode* rootNode = browserNode->GetRootNode();
+  int numberOfItems = rootNode->GetNumberOfDataNodes();
+  int selectedItemNumber = browserNode->GetSelectedItemNumber();
+  if (selectedItemNumber<0 || selectedItemNumber>=numberOfItems)
+  {
+    // no valid selection, start from the first item
+    return 1;
+  }
+  if (selectedItemNumber != clock.SelectedItemNumber)
+  {
+    // selection was changed by the user, continue playback from the selected item
+    clock.PlaybackIndexValue = this->GetNthNumericIndexValue(rootNode, selectedItemNumber);
+    clock.SelectedItemNumber = selectedItemNumber;
+  }
+  clock.PlaybackIndexValue += elapsedTimeSec;
+
+  // find the last item that is due
+  int itemNumber = selectedItemNumber;
+  while (itemNumber+1<numberOfItems && this->GetNthNumericIndexValue(rootNode, itemNumber+1)<=clock.PlaybackIndexValue)
+  {
+    itemNumber++;
+  }
+  if (itemNumber==numberOfItems-1 && clock.PlaybackIndexValue>=GetRealTimePlaybackEndIndexValue(this->GetNumericIndexValues(rootNode)))
+  {
+    // reached the end: jump to the first item (SelectNextItem wraps around or stops playback)
+    clock.PlaybackIndexValue = this->GetNthNumericIndexValue(rootNode, 0);
+    return numberOfItems-selectedItemNumber;
+  }
+  return itemNumber-selectedItemNumber;
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSequenceBrowserLogic::IsSharedClockPlayback(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  const char* clockName = browserNode->GetPlaybackClockName();
+  if (clockName==NULL || clockName[0]==0)
+  {
+    return false;
+  }
+  vtkMRMLSequenceNode* rootNode = browserNode->GetRootNode();
+  return (rootNode!=NULL && rootNode->GetIndexType()==vtkMRMLSequenceNode::NumericIndex && rootNode->GetNumberOfDataNodes()>0);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::GetSharedClockBrowserNodes(const std::string& clockName, std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes)
+{
+  browserNodes.clear();
+  for (std::set< vtkMRMLSequenceBrowserNode* >::iterator browserNodeIt=this->BrowserNodes.begin(); browserNodeIt!=this->BrowserNodes.end(); ++browserNodeIt)
+  {
+    vtkMRMLSequenceBrowserNode* browserNode = (*browserNodeIt);
+    if (browserNode->GetPlaybackActive() && this->IsSharedClockPlayback(browserNode) && clockName==browserNode->GetPlaybackClockName())
+    {
+      browserNodes.push_back(browserNode);
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::UpdateSharedPlaybackClocks(double currentTimeSec)
+{
+  // Collect the playing browser nodes of each clock
+  std::map< std::string, std::vector< vtkMRMLSequenceBrowserNode* > > clockBrowserNodes;
+  for (std::set< vtkMRMLSequenceBrowserNode* >::iterator browserNodeIt=this->BrowserNodes.begin(); browserNodeIt!=this->BrowserNodes.end(); ++browserNodeIt)
+  {
+    vtkMRMLSequenceBrowserNode* browserNode = (*browserNodeIt);
+    if (browserNode->GetPlaybackActive() && this->IsSharedClockPlayback(browserNode))
+    {
+      clockBrowserNodes[browserNode->GetPlaybackClockName()].push_back(browserNode);
+    }
+  }
+
+  // Remove clocks that are not used by any playing browser node
+  std::map< std::string, SharedPlaybackClockType >::iterator clockIt = this->SharedPlaybackClocks.begin();
+  while (clockIt != this->SharedPlaybackClocks.end())
+  {
+    if (clockBrowserNodes.find(clockIt->first) == clockBrowserNodes.end())
+    {
+      this->SharedPlaybackClocks.erase(clockIt++);
+    }
+    else
+    {
+      ++clockIt;
+    }
+  }
+
+  for (std::map< std::string, std::vector< vtkMRMLSequenceBrowserNode* > >::iterator clockBrowserNodesIt=clockBrowserNodes.begin();
+    clockBrowserNodesIt!=clockBrowserNodes.end(); ++clockBrowserNodesIt)
+  {
+    const std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes = clockBrowserNodesIt->second;
+    clockIt = this->SharedPlaybackClocks.find(clockBrowserNodesIt->first);
+    if (clockIt == this->SharedPlaybackClocks.end())
+    {
+      // playback just started, start the clock from the item selected in the first browser node
+      vtkMRMLSequenceNode* firstRootNode = browserNodes.front()->GetRootNode();
+      int selectedItemNumber = browserNodes.front()->GetSelectedItemNumber();
+      if (selectedItemNumber<0 || selectedItemNumber>=firstRootNode->GetNumberOfDataNodes())
+      {
+        selectedItemNumber = 0;
+      }
+      SharedPlaybackClockType clock;
+      clock.LastUpdateTimeSec = currentTimeSec;
+      clock.ClockTimeSec = this->GetNthNumericIndexValue(firstRootNode, selectedItemNumber);
+      clockIt = this->SharedPlaybackClocks.insert(std::make_pair(clockBrowserNodesIt->first, clock)).first;
+    }
+    else
+    {
+      SharedPlaybackClockType& clock = clockIt->second;
+      // If the selection was changed by the user in any of the browser nodes then continue playback from there
+      for (std::vector< vtkMRMLSequenceBrowserNode* >::const_iterator browserNodeIt=browserNodes.begin(); browserNodeIt!=browserNodes.end(); ++browserNodeIt)
+      {
+        std::map< vtkMRMLSequenceBrowserNode*, PlaybackClockType >::iterator playbackClockIt = this->PlaybackClocks.find(*browserNodeIt);
+        int selectedItemNumber = (*browserNodeIt)->GetSelectedItemNumber();
+        if (playbackClockIt != this->PlaybackClocks.end() && selectedItemNumber != playbackClockIt->second.SelectedItemNumber
+          && selectedItemNumber>=0 && selectedItemNumber<(*browserNodeIt)->GetRootNode()->GetNumberOfDataNodes())
+        {
+          clock.ClockTimeSec = this->GetNthNumericIndexValue((*browserNodeIt)->GetRootNode(), selectedItemNumber);
+          break;
+        }
+      }
+      clock.ClockTimeSec += currentTimeSec - clock.LastUpdateTimeSec;
+      clock.LastUpdateTimeSec = currentTimeSec;
+
+      // The clock runs until all the sequences are played
+      double startTimeSec = 0.0;
+      double endTimeSec = 0.0;
+      bool looped = false;
+      this->GetSharedClockTimeRange(browserNodes, startTimeSec, endTimeSec, looped);
+      if (clock.ClockTimeSec>=endTimeSec)
+      {
+        if (looped && endTimeSec>startTimeSec)
+        {
+          clock.ClockTimeSec = startTimeSec + fmod(clock.ClockTimeSec-startTimeSec, endTimeSec-startTimeSec);
+        }
+        else
+        {
+          // reached the end, the clock is removed at the next update
+          for (std::vector< vtkMRMLSequenceBrowserNode* >::const_iterator browserNodeIt=browserNodes.begin(); browserNodeIt!=browserNodes.end(); ++browserNodeIt)
+          {
+            (*browserNodeIt)->SetPlaybackActive(false);
+          }
+          continue;
+        }
+      }
+    }
+    this->SelectItemsAtSharedClockTime(browserNodes, clockIt->second.ClockTimeSec);
+  }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::GetSharedClockTimeRange(const std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes,
+  double& startTimeSec, double& endTimeSec, bool& looped)
+{
+  startTimeSec = 0.0;
+  endTimeSec = 0.0;
+  looped = false;
+  for (std::vector< vtkMRMLSequenceBrowserNode* >::const_iterator browserNodeIt=browserNodes.begin(); browserNodeIt!=browserNodes.end(); ++browserNodeIt)
+  {
+    const std::vector<double>& indexValues = this->GetNumericIndexValues((*browserNodeIt)->GetRootNode());
+    double rootNodeStartTimeSec = indexValues.empty() ? 0.0 : indexValues.front();
+    double rootNodeEndTimeSec = GetRealTimePlaybackEndIndexValue(indexValues);
+    if (browserNodeIt==browserNodes.begin() || rootNodeStartTimeSec<startTimeSec)
+    {
+      startTimeSec = rootNodeStartTimeSec;
+    }
+    if (browserNodeIt==browserNodes.begin() || rootNodeEndTimeSec>endTimeSec)
+    {
+      endTimeSec = rootNodeEndTimeSec;
+    }
+    looped = looped || (*browserNodeIt)->GetPlaybackLooped();
+  }
+}
+
+//---------------------------------------------------------------------------
+const std::vector<double>& vtkSlicerSequenceBrowserLogic::GetNumericIndexValues(vtkMRMLSequenceNode* sequenceNode)
+{
+  NumericIndexValuesType& numericIndexValues = this->NumericIndexValues[sequenceNode];
+  if (sequenceNode==NULL)
+  {
+    numericIndexValues.IndexValues.clear();
+    return numericIndexValues.IndexValues;
+  }
+  if (numericIndexValues.SequenceNodeMTime==sequenceNode->GetMTime()
+    && static_cast<int>(numericIndexValues.IndexValues.size())==sequenceNode->GetNumberOfDataNodes())
+  {
+    // sequence node has not been modified since the index values were parsed
+    return numericIndexValues.IndexValues;
+  }
+  int numberOfItems = sequenceNode->GetNumberOfDataNodes();
+  numericIndexValues.IndexValues.resize(numberOfItems);
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    numericIndexValues.IndexValues[itemNumber] = atof(sequenceNode->GetNthIndexValue(itemNumber).c_str());
+  }
+  numericIndexValues.SequenceNodeMTime = sequenceNode->GetMTime();
+  return numericIndexValues.IndexValues;
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetNthNumericIndexValue(vtkMRMLSequenceNode* sequenceNode, int itemNumber)
+{
+  const std::vector<double>& indexValues = this->GetNumericIndexValues(sequenceNode);
+  if (itemNumber<0 || itemNumber>=static_cast<int>(indexValues.size()))
+  {
+    return 0.0;
+  }
+  return indexValues[itemNumber];
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::SelectItemsAtSharedClockTime(const std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes, double clockTimeSec)
+{
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  for (std::vector< vtkMRMLSequenceBrowserNode* >::const_iterator browserNodeIt=browserNodes.begin(); browserNodeIt!=browserNodes.end(); ++browserNodeIt)
+  {
+    vtkMRMLSequenceBrowserNode* browserNode = (*browserNodeIt);
+    if (this->BrowserNodes.find(browserNode)==this->BrowserNodes.end())
+    {
+      // browser node has been removed meanwhile
+      continue;
+    }
+    vtkMRMLSequenceNode* rootNode = browserNode->GetRootNode();
+    int itemNumber = GetNearestItemNumber(this->GetNumericIndexValues(rootNode), clockTimeSec);
+    int selectedItemNumber = browserNode->GetSelectedItemNumber();
+    bool playbackStarted = (this->PlaybackClocks.find(browserNode) == this->PlaybackClocks.end());
+    if (playbackStarted)
+    {
+      this->NumberOfSkippedItems[browserNode] = 0;
+      this->ResetPlaybackStatistics(browserNode);
+    }
+    // invalid items (e.g., dropped frames) are not selected, the previous item remains displayed
+    if (itemNumber>=0 && itemNumber!=selectedItemNumber && rootNode->GetNthItemValid(itemNumber))
+    {
+      if (!playbackStarted && selectedItemNumber>=0 && itemNumber>selectedItemNumber+1)
+      {
+        this->NumberOfSkippedItems[browserNode] += itemNumber-selectedItemNumber-1;
+      }
+      browserNode->SetSelectedItemNumber(itemNumber);
+    }
+    PlaybackClockType& playbackClock = this->PlaybackClocks[browserNode];
+    playbackClock.LastUpdateTimeSec = currentTimeSec;
+    playbackClock.ElapsedTimeRemainderSec = 0.0;
+    playbackClock.PlaybackIndexValue = clockTimeSec;
+    playbackClock.SelectedItemNumber = browserNode->GetSelectedItemNumber();
+  }
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetSharedPlaybackClockTimeSec(const char* clockName)
+{
+  if (clockName==NULL)
+  {
+    vtkErrorMacro("vtkSlicerSequenceBrowserLogic::GetSharedPlaybackClockTimeSec failed: clockName is invalid");
+    return 0.0;
+  }
+  std::map< std::string, SharedPlaybackClockType >::iterator clockIt = this->SharedPlaybackClocks.find(clockName);
+  if (clockIt == this->SharedPlaybackClocks.end())
+  {
+    return 0.0;
+  }
+  return clockIt->second.ClockTimeSec;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::SetSharedPlaybackClockTimeSec(const char* clockName, double clockTimeSec)
+{
+  if (clockName==NULL)
+  {
+    vtkErrorMacro("vtkSlicerSequenceBrowserLogic::SetSharedPlaybackClockTimeSec failed: clockName is invalid");
+    return;
+  }
+  std::vector< vtkMRMLSequenceBrowserNode* > browserNodes;
+  this->GetSharedClockBrowserNodes(clockName, browserNodes);
+  if (browserNodes.empty())
+  {
+    // the clock only exists while there are playing browser nodes that use it
+    return;
+  }
+  SharedPlaybackClockType& clock = this->SharedPlaybackClocks[clockName];
+  clock.LastUpdateTimeSec = vtkTimerLog::GetUniversalTime();
+  clock.ClockTimeSec = clockTimeSec;
+  this->SelectItemsAtSharedClockTime(browserNodes, clockTimeSec);
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerSequenceBrowserLogic::GetNumberOfSkippedItems(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  std::map< vtkMRMLSequenceBrowserNode*, int >::iterator skippedItemsIt = this->NumberOfSkippedItems.find(browserNode);
+  if (skippedItemsIt == this->NumberOfSkippedItems.end())
+  {
+    return 0;
+  }
+  return skippedItemsIt->second;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::ResetPlaybackStatistics(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  this->PlaybackStatistics[browserNode] = PlaybackStatisticsType();
+}
+
+//---------------------------------------------------------------------------
+const vtkSlicerSequenceBrowserLogic::PlaybackStatisticsType* vtkSlicerSequenceBrowserLogic::GetPlaybackStatistics(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  std::map< vtkMRMLSequenceBrowserNode*, PlaybackStatisticsType >::iterator statisticsIt = this->PlaybackStatistics.find(browserNode);
+  if (statisticsIt == this->PlaybackStatistics.end())
+  {
+    return NULL;
+  }
+  return &(statisticsIt->second);
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetAchievedPlaybackFps(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  if (statistics==NULL)
+  {
+    return 0.0;
+  }
+  // Only count the items displayed within the time window, so that the rate drops to zero when the display stops
+  double windowStartTimeSec = vtkTimerLog::GetUniversalTime()-PLAYBACK_STATISTICS_FPS_TIME_WINDOW_SEC;
+  std::deque<double>::const_iterator firstItemTimeIt = std::lower_bound(statistics->DisplayedItemTimesSec.begin(),
+    statistics->DisplayedItemTimesSec.end(), windowStartTimeSec);
+  int numberOfDisplayedItems = static_cast<int>(statistics->DisplayedItemTimesSec.end()-firstItemTimeIt);
+  if (numberOfDisplayedItems<2)
+  {
+    return 0.0;
+  }
+  double displayTimeSec = statistics->DisplayedItemTimesSec.back()-(*firstItemTimeIt);
+  if (displayTimeSec<=0)
+  {
+    return 0.0;
+  }
+  return (numberOfDisplayedItems-1)/displayTimeSec;
+}
+
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetUpdateLatencyPercentileSec(vtkMRMLSequenceBrowserNode* browserNode, double percentile)
+{
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  if (statistics==NULL || statistics->UpdateDurationsSec.empty())
+  {
+    return 0.0;
+  }
+  std::vector<double> updateDurationsSec(statistics->UpdateDurationsSec.begin(), statistics->UpdateDurationsSec.end());
+  int percentileIndex = static_cast<int>(floor(percentile/100.0*(updateDurationsSec.size()-1)+0.5));
+  percentileIndex = std::max(0, std::min<int>(percentileIndex, updateDurationsSec.size()-1));
+  std::nth_element(updateDurationsSec.begin(), updateDurationsSec.begin()+percentileIndex, updateDurationsSec.end());
+  return updateDurationsSec[percentileIndex];
 }
 
-//----------------------------------------------------------------------------
-vtkSlicerSequenceBrowserLogic::~vtkSlicerSequenceBrowserLogic()
-{  
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetTotalUpdateTimeSec(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  return statistics ? statistics->TotalUpdateTimeSec : 0.0;
 }
 
-//----------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::PrintSelf(ostream& os, vtkIndent indent)
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetTotalShallowCopyTimeSec(vtkMRMLSequenceBrowserNode* browserNode)
 {
-  this->Superclass::PrintSelf(os, indent);
-
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  return statistics ? statistics->TotalShallowCopyTimeSec : 0.0;
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
+double vtkSlicerSequenceBrowserLogic::GetTotalModifiedEventProcessingTimeSec(vtkMRMLSequenceBrowserNode* browserNode)
 {
-  vtkNew<vtkIntArray> events;
-  events->InsertNextValue(vtkMRMLScene::NodeAddedEvent);
-  events->InsertNextValue(vtkMRMLScene::NodeRemovedEvent);
-  events->InsertNextValue(vtkMRMLScene::EndBatchProcessEvent);
-  this->SetAndObserveMRMLSceneEventsInternal(newScene, events.GetPointer());
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  return statistics ? statistics->TotalModifiedEventProcessingTimeSec : 0.0;
 }
 
-//-----------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::RegisterNodes()
+//---------------------------------------------------------------------------
+double vtkSlicerSequenceBrowserLogic::GetTotalPlaybackUpdateDelaySec(vtkMRMLSequenceBrowserNode* browserNode)
 {
-  if (this->GetMRMLScene()==NULL)
-  {
-    vtkErrorMacro("Scene is invalid");
-    return;
-  }
-  this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceBrowserNode>::New());
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  return statistics ? statistics->TotalPlaybackUpdateDelaySec : 0.0;
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::UpdateFromMRMLScene()
+double vtkSlicerSequenceBrowserLogic::GetVirtualOutputCacheHitRate(vtkMRMLSequenceBrowserNode* browserNode)
 {
-  if (this->GetMRMLScene()==NULL)
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  if (statistics==NULL)
   {
-    vtkErrorMacro("Scene is invalid");
-    return;
+    return 0.0;
+  }
+  int numberOfVirtualOutputs = statistics->NumberOfUpdatedVirtualOutputs+statistics->NumberOfUnchangedVirtualOutputs;
+  if (numberOfVirtualOutputs==0)
+  {
+    return 0.0;
   }
-  // TODO: probably we need to add observer to all vtkMRMLSequenceBrowserNode-type nodes
+  return double(statistics->NumberOfUnchangedVirtualOutputs)/numberOfVirtualOutputs;
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+std::string vtkSlicerSequenceBrowserLogic::GetPlaybackStatisticsAsString(vtkMRMLSequenceBrowserNode* browserNode)
 {
-  if (node==NULL)
+  const PlaybackStatisticsType* statistics = this->GetPlaybackStatistics(browserNode);
+  if (statistics==NULL || statistics->NumberOfUpdates==0)
   {
-    vtkErrorMacro("An invalid node is attempted to be added");
-    return;
+    return "No statistics available";
   }
-  if (node->IsA("vtkMRMLSequenceBrowserNode"))
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1);
+  ss << this->GetAchievedPlaybackFps(browserNode) << " fps";
+  ss << ", update " << this->GetUpdateLatencyPercentileSec(browserNode, 50)*1000.0 << " ms (median), "
+    << this->GetUpdateLatencyPercentileSec(browserNode, 95)*1000.0 << " ms (95%)";
+  ss << ", copy " << statistics->TotalShallowCopyTimeSec/statistics->NumberOfUpdates*1000.0 << " ms";
+  ss << ", modified events " << statistics->TotalModifiedEventProcessingTimeSec/statistics->NumberOfUpdates*1000.0 << " ms";
+  if (statistics->NumberOfPlaybackUpdates>0)
   {
-    vtkDebugMacro("OnMRMLSceneNodeAdded: Have a vtkMRMLSequenceBrowserNode node");
-    vtkUnObserveMRMLNodeMacro(node); // remove any previous observation that might have been added
-    vtkObserveMRMLNodeMacro(node);
+    ss << ", render delay " << statistics->TotalPlaybackUpdateDelaySec/statistics->NumberOfPlaybackUpdates*1000.0 << " ms";
   }
+  ss << ", skipped " << this->GetNumberOfSkippedItems(browserNode);
+  ss << ", cache hit " << std::setprecision(0) << this->GetVirtualOutputCacheHitRate(browserNode)*100.0 << "%";
+  return ss.str();
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+bool vtkSlicerSequenceBrowserLogic::IsPlaybackActive()
 {
-  if (node==NULL)
+  for (std::set< vtkMRMLSequenceBrowserNode* >::iterator browserNodeIt=this->BrowserNodes.begin(); browserNodeIt!=this->BrowserNodes.end(); ++browserNodeIt)
   {
-    vtkErrorMacro("An invalid node is attempted to be removed");
-    return;
+    if ((*browserNodeIt)->GetPlaybackActive())
+    {
+      return true;
+    }
   }
-  if (node->IsA("vtkMRMLSequenceBrowserNode"))
-  {
-    vtkDebugMacro("OnMRMLSceneNodeRemoved: Have a vtkMRMLSequenceBrowserNode node");
-    vtkUnObserveMRMLNodeMacro(node);
-  } 
+  return false;
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSequenceBrowserLogic::UpdateAllVirtualOutputNodes()
+double vtkSlicerSequenceBrowserLogic::GetTimeUntilNextPlaybackUpdateSec()
 {
-  double updateStartTimeSec = vtkTimerLog::GetUniversalTime();
-
-  vtkMRMLScene* scene=this->GetMRMLScene();
-  if (scene==NULL)
-  {
-    vtkErrorMacro("vtkSlicerSequenceBrowserLogic::UpdateAllVirtualOutputNodes failed: scene is invalid");
-    return;
-  }
-  // remove the procedural color nodes (after the fs proc nodes as
-  // getting them by class)
-  std::vector< vtkMRMLNode* > browserNodes;
-  int numBrowserNodes = this->GetMRMLScene()->GetNodesByClass("vtkMRMLSequenceBrowserNode", browserNodes);
-  for (int i = 0; i < numBrowserNodes; i++)
+  double currentTimeSec = vtkTimerLog::GetUniversalTime();
+  double timeUntilNextUpdateSec = -1.0;
+  for (std::set< vtkMRMLSequenceBrowserNode* >::iterator browserNodeIt=this->BrowserNodes.begin(); browserNodeIt!=this->BrowserNodes.end(); ++browserNodeIt)
   {
-    vtkMRMLSequenceBrowserNode* browserNode = vtkMRMLSequenceBrowserNode::SafeDownCast(browserNodes[i]);
-    if (browserNode==NULL)
+    vtkMRMLSequenceBrowserNode* browserNode = (*browserNodeIt);
+    if (!browserNode->GetPlaybackActive())
     {
-      vtkErrorMacro("Browser node is invalid");
       continue;
     }
-    if (!browserNode->GetPlaybackActive())
+    if (this->IsSharedClockPlayback(browserNode))
     {
-      this->LastSequenceBrowserUpdateTimeSec.erase(browserNode);
+      double browserNodeTimeUntilNextUpdateSec = 0.0; // playback just started, update immediately
+      std::map< std::string, SharedPlaybackClockType >::iterator sharedClockIt = this->SharedPlaybackClocks.find(browserNode->GetPlaybackClockName());
+      if (sharedClockIt != this->SharedPlaybackClocks.end())
+      {
+        const SharedPlaybackClockType& clock = sharedClockIt->second;
+        double clockTimeSec = clock.ClockTimeSec + (currentTimeSec - clock.LastUpdateTimeSec);
+        // The next item is selected when the clock gets nearer to its index value than to the index value of the previous item.
+        // The search starts from the item at the current clock time (not from the selected item, which may lag behind
+        // if the nearest item is invalid) and skips invalid items, so that no update is requested for items that cannot be selected.
+        vtkMRMLSequenceNode* rootNode = browserNode->GetRootNode();
+        const std::vector<double>& indexValues = this->GetNumericIndexValues(rootNode);
+        int numberOfItems = indexValues.size();
+        int nextItemNumber = GetNearestItemNumber(indexValues, clockTimeSec)+1;
+        while (nextItemNumber<numberOfItems
+          && ((indexValues[nextItemNumber-1]+indexValues[nextItemNumber])/2.0<=clockTimeSec || !rootNode->GetNthItemValid(nextItemNumber)))
+        {
+          nextItemNumber++;
+        }
+        double nextSelectionTimeSec = 0.0;
+        if (nextItemNumber<numberOfItems)
+        {
+          nextSelectionTimeSec = (indexValues[nextItemNumber-1]+indexValues[nextItemNumber])/2.0;
+        }
+        else
+        {
+          // All items of this browser node are played, the next update is due when the clock reaches its end
+          // (playback is then stopped or restarted). Other browser nodes that use the clock may end later.
+          std::vector< vtkMRMLSequenceBrowserNode* > clockBrowserNodes;
+          this->GetSharedClockBrowserNodes(browserNode->GetPlaybackClockName(), clockBrowserNodes);
+          double clockStartTimeSec = 0.0;
+          bool looped = false;
+          this->GetSharedClockTimeRange(clockBrowserNodes, clockStartTimeSec, nextSelectionTimeSec, looped);
+        }
+        browserNodeTimeUntilNextUpdateSec = nextSelectionTimeSec - clockTimeSec;
+        if (browserNodeTimeUntilNextUpdateSec<0)
+        {
+          browserNodeTimeUntilNextUpdateSec = 0.0;
+        }
+      }
+      if (timeUntilNextUpdateSec<0 || browserNodeTimeUntilNextUpdateSec<timeUntilNextUpdateSec)
+      {
+        timeUntilNextUpdateSec = browserNodeTimeUntilNextUpdateSec;
+      }
       continue;
     }
-    if ( this->LastSequenceBrowserUpdateTimeSec.find(browserNode) == this->LastSequenceBrowserUpdateTimeSec.end() )
+    bool realTimePlayback = this->IsRealTimePlayback(browserNode);
+    if (!realTimePlayback && browserNode->GetPlaybackRateFps()<=0)
     {
-      // we just started to play now, no need to update output nodes yet
-      this->LastSequenceBrowserUpdateTimeSec[browserNode] = updateStartTimeSec;
+      // not playing: items are not selected until the playback rate becomes positive, then playback restarts
+      // with a new clock (time elapsed while paused would cause a jump)
+      this->PlaybackClocks.erase(browserNode);
+      continue;
     }
-    else
+    double browserNodeTimeUntilNextUpdateSec = 0.0; // playback just started, update immediately
+    std::map< vtkMRMLSequenceBrowserNode*, PlaybackClockType >::iterator clockIt = this->PlaybackClocks.find(browserNode);
+    if (clockIt != this->PlaybackClocks.end())
     {
-      // play is already in progress
-      double elapsedTimeSec = updateStartTimeSec - this->LastSequenceBrowserUpdateTimeSec[browserNode];
-      // compute how many items we need to jump; if not enough time passed to jump at least to the next item
-      // then we don't do anything (let the elapsed time cumulate)
-      int selectionIncrement = floor(elapsedTimeSec * browserNode->GetPlaybackRateFps());
-      if (selectionIncrement>0)
+      const PlaybackClockType& clock = clockIt->second;
+      double timeSinceLastUpdateSec = currentTimeSec - clock.LastUpdateTimeSec;
+      if (realTimePlayback)
+      {
+        vtkMRMLSequenceNode* rootNode = browserNode->GetRootNode();
+        int nextItemNumber = browserNode->GetSelectedItemNumber()+1;
+        double nextIndexValue = (nextItemNumber>0 && nextItemNumber<rootNode->GetNumberOfDataNodes())
+          ? this->GetNthNumericIndexValue(rootNode, nextItemNumber) : GetRealTimePlaybackEndIndexValue(this->GetNumericIndexValues(rootNode));
+        browserNodeTimeUntilNextUpdateSec = nextIndexValue - clock.PlaybackIndexValue - timeSinceLastUpdateSec;
+      }
+      else
+      {
+        browserNodeTimeUntilNextUpdateSec = 1.0/browserNode->GetPlaybackRateFps() - clock.ElapsedTimeRemainderSec - timeSinceLastUpdateSec;
+      }
+      if (browserNodeTimeUntilNextUpdateSec<0)
       {
-        this->LastSequenceBrowserUpdateTimeSec[browserNode] = updateStartTimeSec;
-        this->SelectNextItem(browserNode, selectionIncrement);
+        browserNodeTimeUntilNextUpdateSec = 0.0;
       }
     }
+    if (timeUntilNextUpdateSec<0 || browserNodeTimeUntilNextUpdateSec<timeUntilNextUpdateSec)
+    {
+      timeUntilNextUpdateSec = browserNodeTimeUntilNextUpdateSec;
+    }
+  }
+  // Store when the update is due, to measure how late the update actually happens
+  this->PlaybackUpdateDueTimeSec = (timeUntilNextUpdateSec>=0) ? currentTimeSec+timeUntilNextUpdateSec : -1.0;
+  return timeUntilNextUpdateSec;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::UpdatePlaybackState(vtkMRMLSequenceBrowserNode* modifiedBrowserNode/*=NULL*/)
+{
+  int numberOfPlayingBrowserNodes = 0;
+  for (std::set< vtkMRMLSequenceBrowserNode* >::iterator browserNodeIt=this->BrowserNodes.begin(); browserNodeIt!=this->BrowserNodes.end(); ++browserNodeIt)
+  {
+    if ((*browserNodeIt)->GetPlaybackActive())
+    {
+      numberOfPlayingBrowserNodes++;
+    }
+  }
+  bool playbackParametersMayHaveChanged = (modifiedBrowserNode!=NULL && modifiedBrowserNode->GetPlaybackActive()
+    && !this->UpdateAllVirtualOutputNodesInProgress);
+  if (numberOfPlayingBrowserNodes == this->NumberOfPlayingBrowserNodes && !playbackParametersMayHaveChanged)
+  {
+    return;
   }
+  this->NumberOfPlayingBrowserNodes = numberOfPlayingBrowserNodes;
+  this->InvokeEvent(PlaybackStateChangedEvent);
 }
 
 //---------------------------------------------------------------------------
@@ -229,6 +1136,26 @@ void vtkSlicerSequenceBrowserLogic::SelectNextItem(vtkMRMLSequenceBrowserNode* b
       }
     }
   }
+  if (rootNode->GetNumberOfInvalidItems()>0)
+  {
+    // Skip invalid items (e.g., dropped frames) in the direction of the selection change
+    int numberOfItems=rootNode->GetNumberOfDataNodes();
+    int step=(selectionIncrement<0) ? -1 : 1;
+    for (int skippedItems=0; skippedItems<numberOfItems && !rootNode->GetNthItemValid(selectedItemNumber); skippedItems++)
+    {
+      selectedItemNumber += step;
+      if (selectedItemNumber<0 || selectedItemNumber>=numberOfItems)
+      {
+        if (!browserNode->GetPlaybackLooped())
+        {
+          // reached the end, keep the last valid item selected
+          selectedItemNumber -= step;
+          break;
+        }
+        selectedItemNumber = (selectedItemNumber+numberOfItems) % numberOfItems;
+      }
+    }
+  }
   browserNode->SetSelectedItemNumber(selectedItemNumber);
   browserNode->EndModify(browserNodeModify);
 }
@@ -255,6 +1182,7 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
   if (browserNode->GetRootNode()==NULL)
   {
     browserNode->RemoveAllVirtualOutputNodes();
+    this->VirtualOutputUpdateStates.erase(browserNode);
     return;
   }
 
@@ -266,6 +1194,10 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
   }
 
   this->UpdateVirtualOutputNodesInProgress=true;
+  double updateStartTimeSec = vtkTimerLog::GetUniversalTime();
+  double shallowCopyTimeSec = 0.0;
+  int numberOfUpdatedVirtualOutputs = 0;
+  int numberOfUnchangedVirtualOutputs = 0;
   
   int selectedItemNumber=browserNode->GetSelectedItemNumber();
   std::string indexValue;
@@ -276,9 +1208,26 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
 
   std::vector< vtkMRMLSequenceNode* > synchronizedRootNodes;
   browserNode->GetSynchronizedRootNodes(synchronizedRootNodes, true);
+
+  // The new state is collected in a local variable and only stored when the update is completed,
+  // because observers of the output nodes may remove the browser node (and so its stored state) during the update.
+  bool newItemDisplayed = true;
+  std::map< vtkMRMLSequenceNode*, VirtualOutputStateType > previousVirtualOutputs;
+  std::map< vtkMRMLSequenceBrowserNode*, VirtualOutputUpdateStateType >::iterator previousUpdateStateIt = this->VirtualOutputUpdateStates.find(browserNode);
+  if (previousUpdateStateIt!=this->VirtualOutputUpdateStates.end())
+  {
+    newItemDisplayed = (previousUpdateStateIt->second.RootNode!=browserNode->GetRootNode() || previousUpdateStateIt->second.SelectedItemNumber!=selectedItemNumber);
+    previousVirtualOutputs = previousUpdateStateIt->second.VirtualOutputs;
+  }
+  VirtualOutputUpdateStateType updateState;
+  updateState.RootNode = browserNode->GetRootNode();
+  updateState.SelectedItemNumber = selectedItemNumber;
   
   // Store the previous modified state of nodes to allow calling EndModify when all the nodes are updated (to prevent multiple renderings on partial update)
-  std::vector< std::pair<vtkMRMLNode*, int> > nodeModifiedStates;
+  // Weak pointers are used, as observers invoked by EndModify may delete the other output nodes.
+  std::vector< std::pair<vtkWeakPointer<vtkMRMLNode>, int> > nodeModifiedStates;
+  // Synchronized nodes whose output node has been updated
+  std::vector< vtkMRMLSequenceNode* > updatedSynchronizedRootNodes;
 
   for (std::vector< vtkMRMLSequenceNode* >::iterator sourceRootNodeIt=synchronizedRootNodes.begin(); sourceRootNodeIt!=synchronizedRootNodes.end(); ++sourceRootNodeIt)
   {
@@ -288,6 +1237,18 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
       vtkErrorMacro("Synchronized root node is invalid");
       continue;
     }
+    updateState.SynchronizedRootNodes.push_back(std::make_pair(synchronizedRootNode, synchronizedRootNode->GetMTime()));
+    std::map< vtkMRMLSequenceNode*, VirtualOutputStateType >::iterator previousVirtualOutputIt = previousVirtualOutputs.find(synchronizedRootNode);
+    if (previousVirtualOutputIt!=previousVirtualOutputs.end())
+    {
+      // keep the previous state if the output node is not updated now
+      updateState.VirtualOutputs[synchronizedRootNode] = previousVirtualOutputIt->second;
+    }
+    if (!synchronizedRootNode->GetItemValidAtValue(indexValue.c_str()))
+    {
+      // the item is marked as invalid (e.g., tool was out of view), keep showing the previous valid item
+      continue;
+    }
     vtkMRMLNode* sourceNode=synchronizedRootNode->GetDataNodeAtValue(indexValue.c_str());
     if (sourceNode==NULL)
     {
@@ -307,6 +1268,19 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
       }
     }
 
+    if (targetOutputNode!=NULL && previousVirtualOutputIt!=previousVirtualOutputs.end())
+    {
+      // Skip the update if the output node has not been changed since it was updated from the same source node
+      const VirtualOutputStateType& previousVirtualOutput = previousVirtualOutputIt->second;
+      if (previousVirtualOutput.SourceNode.GetPointer()==sourceNode && previousVirtualOutput.SourceNodeMTime==sourceNode->GetMTime()
+        && previousVirtualOutput.TargetNode.GetPointer()==targetOutputNode && previousVirtualOutput.TargetNodeMTime==targetOutputNode->GetMTime()
+        && previousVirtualOutput.IndexValue==indexValue)
+      {
+        numberOfUnchangedVirtualOutputs++;
+        continue;
+      }
+    }
+
     // Create the virtual output node (and display nodes) if it doesn't exist yet
     if (targetOutputNode==NULL)
     {
@@ -340,15 +1314,19 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
     
     // Update the target node with the contents of the source node    
 
-    // Slice browser is updated when there is a rename, but we want to avoid update, because
-    // the source node may be hidden from editors and it would result in removing the target node
-    // from the slicer browser. To avoid update of the slice browser, we set the name in advance.
-    targetOutputNode->SetName(sourceNode->GetName());
-
     // Mostly it is a shallow copy (for example for volumes, models)
-    std::pair<vtkMRMLNode*, int> nodeModifiedState(targetOutputNode, targetOutputNode->StartModify());
-    nodeModifiedStates.push_back(nodeModifiedState);
+    nodeModifiedStates.push_back(std::make_pair(vtkWeakPointer<vtkMRMLNode>(targetOutputNode), targetOutputNode->StartModify()));
+    double shallowCopyStartTimeSec = vtkTimerLog::GetUniversalTime();
     this->ShallowCopy(targetOutputNode, sourceNode);
+    shallowCopyTimeSec += vtkTimerLog::GetUniversalTime()-shallowCopyStartTimeSec;
+    numberOfUpdatedVirtualOutputs++;
+
+    VirtualOutputStateType& virtualOutput = updateState.VirtualOutputs[synchronizedRootNode];
+    virtualOutput.SourceNode = sourceNode;
+    virtualOutput.SourceNodeMTime = sourceNode->GetMTime();
+    virtualOutput.TargetNode = targetOutputNode;
+    virtualOutput.IndexValue = indexValue;
+    updatedSynchronizedRootNodes.push_back(synchronizedRootNode);
 
     // Generation of data node name: root node name (IndexName = IndexValue IndexUnit)
     const char* rootName=synchronizedRootNode->GetName();
@@ -368,7 +1346,16 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
       dataNodeName+=unit;
     }
     dataNodeName+="]";
-    targetOutputNode->SetName(dataNodeName.c_str());
+
+    // Slice browser is updated when there is a rename, but we want to avoid update, because
+    // the source node may be hidden from editors and it would result in removing the target node
+    // from the slicer browser. Some node types copy the source node name, too, but modified events
+    // are only invoked at EndModify, so the slice browser only sees the final name.
+    const char* targetOutputNodeName=targetOutputNode->GetName();
+    if (targetOutputNodeName==NULL || dataNodeName.compare(targetOutputNodeName)!=0)
+    {
+      targetOutputNode->SetName(dataNodeName.c_str());
+    }
 
     vtkMRMLDisplayableNode* targetDisplayableNode=vtkMRMLDisplayableNode::SafeDownCast(targetOutputNode);
     if (targetDisplayableNode!=NULL)
@@ -411,9 +1398,33 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
   }
 
   // Finalize modifications, all at once. These will fire the node modified events and update renderers.
-  for (std::vector< std::pair<vtkMRMLNode*, int> >::iterator nodeModifiedStateIt = nodeModifiedStates.begin(); nodeModifiedStateIt!=nodeModifiedStates.end(); ++nodeModifiedStateIt)
+  double modifiedEventProcessingStartTimeSec = vtkTimerLog::GetUniversalTime();
+  for (std::vector< std::pair<vtkWeakPointer<vtkMRMLNode>, int> >::iterator nodeModifiedStateIt = nodeModifiedStates.begin(); nodeModifiedStateIt!=nodeModifiedStates.end(); ++nodeModifiedStateIt)
+  {
+    if (nodeModifiedStateIt->first.GetPointer()!=NULL)
+    {
+      (nodeModifiedStateIt->first)->EndModify(nodeModifiedStateIt->second);
+    }
+  }
+  double updateEndTimeSec = vtkTimerLog::GetUniversalTime();
+
+  // Store the update state and statistics (the browser node may have been removed by an observer of the output nodes)
+  if (this->BrowserNodes.find(browserNode)!=this->BrowserNodes.end())
   {
-    (nodeModifiedStateIt->first)->EndModify(nodeModifiedStateIt->second);
+    // Store the modification time of the updated output nodes (to detect if they are changed externally)
+    for (std::vector< vtkMRMLSequenceNode* >::iterator updatedRootNodeIt=updatedSynchronizedRootNodes.begin(); updatedRootNodeIt!=updatedSynchronizedRootNodes.end(); ++updatedRootNodeIt)
+    {
+      VirtualOutputStateType& virtualOutput = updateState.VirtualOutputs[*updatedRootNodeIt];
+      if (virtualOutput.TargetNode.GetPointer()!=NULL)
+      {
+        virtualOutput.TargetNodeMTime = virtualOutput.TargetNode->GetMTime();
+      }
+    }
+    this->VirtualOutputUpdateStates[browserNode] = updateState;
+
+    this->UpdatePlaybackStatistics(this->PlaybackStatistics[browserNode], updateStartTimeSec, updateEndTimeSec,
+      shallowCopyTimeSec, updateEndTimeSec-modifiedEventProcessingStartTimeSec,
+      numberOfUpdatedVirtualOutputs, numberOfUnchangedVirtualOutputs, newItemDisplayed);
   }
 
   this->UpdateVirtualOutputNodesInProgress=false;
@@ -424,9 +1435,44 @@ void vtkSlicerSequenceBrowserLogic::UpdateVirtualOutputNodes(vtkMRMLSequenceBrow
 #endif 
 }
 
+//---------------------------------------------------------------------------
+void vtkSlicerSequenceBrowserLogic::UpdatePlaybackStatistics(PlaybackStatisticsType& statistics, double updateStartTimeSec, double updateEndTimeSec,
+  double shallowCopyTimeSec, double modifiedEventProcessingTimeSec, int numberOfUpdatedVirtualOutputs, int numberOfUnchangedVirtualOutputs,
+  bool newItemDisplayed)
+{
+  statistics.NumberOfUpdates++;
+  statistics.TotalUpdateTimeSec += updateEndTimeSec-updateStartTimeSec;
+  statistics.TotalShallowCopyTimeSec += shallowCopyTimeSec;
+  statistics.TotalModifiedEventProcessingTimeSec += modifiedEventProcessingTimeSec;
+  statistics.NumberOfUpdatedVirtualOutputs += numberOfUpdatedVirtualOutputs;
+  statistics.NumberOfUnchangedVirtualOutputs += numberOfUnchangedVirtualOutputs;
+  statistics.UpdateDurationsSec.push_back(updateEndTimeSec-updateStartTimeSec);
+  if (statistics.UpdateDurationsSec.size()>PLAYBACK_STATISTICS_MAX_NUMBER_OF_LATENCY_SAMPLES)
+  {
+    statistics.UpdateDurationsSec.pop_front();
+  }
+  if (newItemDisplayed)
+  {
+    statistics.DisplayedItemTimesSec.push_back(updateEndTimeSec);
+    // the item displayed now is always within the time window, so the list does not become empty
+    while (statistics.DisplayedItemTimesSec.front()<updateEndTimeSec-PLAYBACK_STATISTICS_FPS_TIME_WINDOW_SEC)
+    {
+      statistics.DisplayedItemTimesSec.pop_front();
+    }
+  }
+}
+
 //---------------------------------------------------------------------------
 void vtkSlicerSequenceBrowserLogic::ProcessMRMLNodesEvents(vtkObject *caller, unsigned long event, void *vtkNotUsed(callData))
 {
+  vtkMRMLSequenceNode *sequenceNode = vtkMRMLSequenceNode::SafeDownCast(caller);
+  if (sequenceNode!=NULL)
+  {
+    // Index name may have been changed
+    this->UpdateSequenceNodeIndexNameRegistry(sequenceNode);
+    return;
+  }
+
   vtkMRMLSequenceBrowserNode *browserNode = vtkMRMLSequenceBrowserNode::SafeDownCast(caller);
   if (browserNode==NULL)
   {
@@ -434,7 +1480,69 @@ void vtkSlicerSequenceBrowserLogic::ProcessMRMLNodesEvents(vtkObject *caller, un
     return;
   }
 
-  this->UpdateVirtualOutputNodes(browserNode);
+  // Playback may have been started or stopped
+  if (!browserNode->GetPlaybackActive())
+  {
+    this->PlaybackClocks.erase(browserNode);
+  }
+  this->UpdatePlaybackState(browserNode);
+
+  // Changes that do not affect the output nodes (such as playback rate) do not require an update
+  if (this->IsVirtualOutputUpdateNeeded(browserNode))
+  {
+    this->UpdateVirtualOutputNodes(browserNode);
+  }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSequenceBrowserLogic::IsVirtualOutputUpdateNeeded(vtkMRMLSequenceBrowserNode* browserNode)
+{
+  std::map< vtkMRMLSequenceBrowserNode*, VirtualOutputUpdateStateType >::iterator updateStateIt = this->VirtualOutputUpdateStates.find(browserNode);
+  if (updateStateIt==this->VirtualOutputUpdateStates.end())
+  {
+    // not updated yet
+    return true;
+  }
+  const VirtualOutputUpdateStateType& updateState = updateStateIt->second;
+  if (updateState.RootNode!=browserNode->GetRootNode() || updateState.SelectedItemNumber!=browserNode->GetSelectedItemNumber())
+  {
+    return true;
+  }
+
+  // Check if synchronized nodes have been added, removed, or modified
+  std::vector< vtkMRMLSequenceNode* > synchronizedRootNodes;
+  browserNode->GetSynchronizedRootNodes(synchronizedRootNodes, true);
+  if (synchronizedRootNodes.size()!=updateState.SynchronizedRootNodes.size())
+  {
+    return true;
+  }
+  for (unsigned int synchronizedNodeIndex=0; synchronizedNodeIndex<synchronizedRootNodes.size(); synchronizedNodeIndex++)
+  {
+    vtkMRMLSequenceNode* synchronizedRootNode=synchronizedRootNodes[synchronizedNodeIndex];
+    if (synchronizedRootNode!=updateState.SynchronizedRootNodes[synchronizedNodeIndex].first
+      || synchronizedRootNode->GetMTime()!=updateState.SynchronizedRootNodes[synchronizedNodeIndex].second)
+    {
+      return true;
+    }
+  }
+
+  // Check if output nodes have been replaced, removed, or modified
+  for (std::map< vtkMRMLSequenceNode*, VirtualOutputStateType >::const_iterator virtualOutputIt=updateState.VirtualOutputs.begin();
+    virtualOutputIt!=updateState.VirtualOutputs.end(); ++virtualOutputIt)
+  {
+    const VirtualOutputStateType& virtualOutput = virtualOutputIt->second;
+    vtkMRMLNode* targetOutputNode=browserNode->GetVirtualOutputDataNode(virtualOutputIt->first);
+    if (targetOutputNode==NULL || targetOutputNode!=virtualOutput.TargetNode.GetPointer() || targetOutputNode->GetMTime()!=virtualOutput.TargetNodeMTime)
+    {
+      return true;
+    }
+    // Data nodes stored in a sequence may be modified without modifying the sequence node
+    if (virtualOutput.SourceNode.GetPointer()==NULL || virtualOutput.SourceNode->GetMTime()!=virtualOutput.SourceNodeMTime)
+    {
+      return true;
+    }
+  }
+  return false;
 }
 
 //---------------------------------------------------------------------------
@@ -446,12 +1554,38 @@ void vtkSlicerSequenceBrowserLogic::ShallowCopy(vtkMRMLNode* target, vtkMRMLNode
     vtkMRMLScalarVolumeNode* targetScalarVolumeNode=vtkMRMLScalarVolumeNode::SafeDownCast(target);
     vtkMRMLScalarVolumeNode* sourceScalarVolumeNode=vtkMRMLScalarVolumeNode::SafeDownCast(source);
     // targetScalarVolumeNode->SetAndObserveTransformNodeID is not called, as we want to keep the currently applied transform
-    vtkSmartPointer<vtkMatrix4x4> ijkToRasmatrix=vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkMatrix4x4* ijkToRasmatrix=this->ShallowCopyMatrix;
     sourceScalarVolumeNode->GetIJKToRASMatrix(ijkToRasmatrix);
     targetScalarVolumeNode->SetIJKToRASMatrix(ijkToRasmatrix);
     targetScalarVolumeNode->SetLabelMap(sourceScalarVolumeNode->GetLabelMap());
-    targetScalarVolumeNode->SetName(sourceScalarVolumeNode->GetName());
-    targetScalarVolumeNode->SetAndObserveImageData(sourceScalarVolumeNode->GetImageData()); // invokes vtkMRMLVolumeNode::ImageDataModifiedEvent, which is not masked by StartModify
+    // The output node has its own image object, which shares the scalars of the source image.
+    // Sequence item images are not shared, because vtkMRMLSequenceImageBufferPool recycles the scalars
+    // of a removed item if no other image refers to them.
+    vtkImageData* sourceImageData=sourceScalarVolumeNode->GetImageData();
+    if (sourceImageData==NULL)
+    {
+      targetScalarVolumeNode->SetAndObserveImageData(NULL);
+    }
+    else
+    {
+      vtkImageData* targetImageData=targetScalarVolumeNode->GetImageData();
+      std::map< vtkMRMLNode*, vtkWeakPointer<vtkImageData> >::iterator outputImageIt=this->VirtualOutputImages.find(target);
+      if (targetImageData==NULL || outputImageIt==this->VirtualOutputImages.end() || outputImageIt->second.GetPointer()!=targetImageData)
+      {
+        // the current image of the output node may be the image of a sequence item (e.g., if the output node was created
+        // by copying the item node), it must not be overwritten
+        vtkSmartPointer<vtkImageData> newTargetImageData=vtkSmartPointer<vtkImageData>::New();
+        newTargetImageData->ShallowCopy(sourceImageData);
+        targetScalarVolumeNode->SetAndObserveImageData(newTargetImageData); // invokes vtkMRMLVolumeNode::ImageDataModifiedEvent, which is not masked by StartModify
+        this->VirtualOutputImages[target]=newTargetImageData;
+      }
+      else
+      {
+        targetImageData->ShallowCopy(sourceImageData);
+        targetImageData->Modified();
+        targetScalarVolumeNode->InvokeCustomModifiedEvent(vtkMRMLVolumeNode::ImageDataModifiedEvent);
+      }
+    }
   }
   else if (target->IsA("vtkMRMLModelNode"))
   {
@@ -465,6 +1599,16 @@ void vtkSlicerSequenceBrowserLogic::ShallowCopy(vtkMRMLNode* target, vtkMRMLNode
     vtkMRMLMarkupsFiducialNode* sourceMarkupsFiducialNode=vtkMRMLMarkupsFiducialNode::SafeDownCast(source);
     targetMarkupsFiducialNode->Copy(sourceMarkupsFiducialNode);
   }
+  else if (target->IsA("vtkMRMLLinearTransformNode") && source->IsA("vtkMRMLLinearTransformNode"))
+  {
+    // The matrix is copied instead of sharing the transform object, because the source node
+    // may be reused for all the items of the sequence (see vtkMRMLLinearTransformSequenceNode)
+    vtkMRMLLinearTransformNode* targetTransformNode=vtkMRMLLinearTransformNode::SafeDownCast(target);
+    vtkMRMLLinearTransformNode* sourceTransformNode=vtkMRMLLinearTransformNode::SafeDownCast(source);
+    vtkMatrix4x4* matrix=this->ShallowCopyMatrix;
+    sourceTransformNode->GetMatrixTransformToParent(matrix);
+    targetTransformNode->SetMatrixTransformToParent(matrix);
+  }
   else if (target->IsA("vtkMRMLTransformNode"))
   {
     vtkMRMLTransformNode* targetTransformNode=vtkMRMLTransformNode::SafeDownCast(target);
@@ -519,30 +1663,227 @@ void vtkSlicerSequenceBrowserLogic::GetCompatibleNodesFromScene(vtkCollection* c
     vtkErrorMacro("vtkSlicerSequenceBrowserLogic::GetCompatibleNodesFromScene failed: root node index name is invalid");
     return;
   }
-  std::string masterRootNodeIndexName=multidimDataRootNode->GetIndexName();
-  vtkSmartPointer<vtkCollection> multidimNodes = vtkSmartPointer<vtkCollection>::Take(this->GetMRMLScene()->GetNodesByClass("vtkMRMLSequenceNode"));
-  vtkObject* nextObject = NULL;
-  for (multidimNodes->InitTraversal(); (nextObject = multidimNodes->GetNextItemAsObject()); )
+  // Nodes with matching index name are considered compatible
+  std::map< std::string, std::vector< vtkMRMLSequenceNode* > >::iterator sequenceNodesIt = this->SequenceNodesByIndexName.find(multidimDataRootNode->GetIndexName());
+  if (sequenceNodesIt==this->SequenceNodesByIndexName.end())
+  {
+    return;
+  }
+  for (std::vector< vtkMRMLSequenceNode* >::iterator multidimNodeIt=sequenceNodesIt->second.begin(); multidimNodeIt!=sequenceNodesIt->second.end(); ++multidimNodeIt)
   {
-    vtkMRMLSequenceNode* multidimNode = vtkMRMLSequenceNode::SafeDownCast(nextObject);
-    if (multidimNode==NULL)
+    if (*multidimNodeIt==multidimDataRootNode)
     {
+      // do not add the master node itself to the list of compatible nodes
       continue;
     }
-    if (multidimNode==multidimDataRootNode)
+    compatibleNodes->AddItem(*multidimNodeIt);
+  }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSequenceBrowserLogic::ComputeRegionTimeCurves(vtkMRMLSequenceNode* volumeSequenceNode, const int regionExtent[6],
+  vtkMRMLScalarVolumeNode* labelmap, int labelValue, vtkTable* timeCurves, int component/*=0*/)
+{
+  if (volumeSequenceNode==NULL || timeCurves==NULL)
+  {
+    vtkErrorMacro("vtkSlicerSequenceBrowserLogic::ComputeRegionTimeCurves failed: volumeSequenceNode or timeCurves is invalid");
+    return false;
+  }
+  timeCurves->Initialize();
+
+  // Collect the images of the items. Invalid items and items that are not compatible with the first image are skipped.
+  int numberOfItems = volumeSequenceNode->GetNumberOfDataNodes();
+  std::vector<vtkImageData*> images(numberOfItems, static_cast<vtkImageData*>(NULL));
+  int imageExtent[6] = {0, -1, 0, -1, 0, -1};
+  bool imageExtentValid = false;
+  vtkSmartPointer<vtkMatrix4x4> imageIjkToRas = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkSmartPointer<vtkMatrix4x4> itemIjkToRas = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int itemIndex=0; itemIndex<numberOfItems; itemIndex++)
+  {
+    if (!volumeSequenceNode->GetNthItemValid(itemIndex))
     {
-      // do not add the master node itself to the list of compatible nodes
       continue;
     }
-    if (multidimNode->GetIndexName()==NULL)
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(volumeSequenceNode->GetNthDataNode(itemIndex));
+    vtkImageData* imageData = volumeNode ? volumeNode->GetImageData() : NULL;
+    vtkDataArray* scalars = imageData ? imageData->GetPointData()->GetScalars() : NULL;
+    if (scalars==NULL || component<0 || component>=scalars->GetNumberOfComponents())
     {
-      vtkErrorMacro("vtkSlicerSequenceBrowserLogic::GetCompatibleNodesFromScene failed: potential compatible root node index name is invalid");
       continue;
     }
-    if (masterRootNodeIndexName.compare(multidimNode->GetIndexName())==0)
+    int* extent = imageData->GetExtent();
+    if (!imageExtentValid)
+    {
+      std::copy(extent, extent+6, imageExtent);
+      volumeNode->GetIJKToRASMatrix(imageIjkToRas);
+      imageExtentValid = true;
+    }
+    else
+    {
+      volumeNode->GetIJKToRASMatrix(itemIjkToRas);
+      if (!std::equal(extent, extent+6, imageExtent) || !IsSameIjkToRasMatrix(itemIjkToRas, imageIjkToRas))
+      {
+        continue;
+      }
+    }
+    images[itemIndex] = imageData;
+  }
+  if (!imageExtentValid)
+  {
+    vtkErrorMacro("vtkSlicerSequenceBrowserLogic::ComputeRegionTimeCurves failed: sequence does not contain a valid scalar volume with component "<<component);
+    return false;
+  }
+
+  // Clamp the region to the image extent
+  int extent[6] = {0};
+  for (int axis=0; axis<3; axis++)
+  {
+    extent[axis*2] = std::max(regionExtent[axis*2], imageExtent[axis*2]);
+    extent[axis*2+1] = std::min(regionExtent[axis*2+1], imageExtent[axis*2+1]);
+    if (extent[axis*2]>extent[axis*2+1])
+    {
+      vtkErrorMacro("vtkSlicerSequenceBrowserLogic::ComputeRegionTimeCurves failed: region does not overlap with the image");
+      return false;
+    }
+  }
+  vtkDataArray* labelScalars = NULL;
+  if (labelmap!=NULL)
+  {
+    vtkImageData* labelmapImageData = labelmap->GetImageData();
+    labelScalars = labelmapImageData ? labelmapImageData->GetPointData()->GetScalars() : NULL;
+    if (labelScalars==NULL)
+    {
+      vtkErrorMacro("vtkSlicerSequenceBrowserLogic::ComputeRegionTimeCurves failed: labelmap is empty");
+      return false;
+    }
+    // Voxels are matched by index, which is only correct if the labelmap voxels are at the same position as the image voxels
+    labelmap->GetIJKToRASMatrix(itemIjkToRas);
+    if (!std::equal(imageExtent, imageExtent+6, labelmapImageData->GetExtent()) || !IsSameIjkToRasMatrix(itemIjkToRas, imageIjkToRas))
+    {
+      vtkErrorMacro("vtkSlicerSequenceBrowserLogic::ComputeRegionTimeCurves failed: labelmap extent or geometry does not match the image");
+      return false;
+    }
+  }
+
+  // Find the runs of consecutive region voxels in each image row. The region is the same in all items,
+  // therefore the labelmap is only read once.
+  std::vector<RegionVoxelRunType> voxelRuns;
+  vtkIdType rowSize = imageExtent[1]-imageExtent[0]+1;
+  vtkIdType sliceSize = rowSize*(imageExtent[3]-imageExtent[2]+1);
+  for (int k=extent[4]; k<=extent[5]; k++)
+  {
+    for (int j=extent[2]; j<=extent[3]; j++)
+    {
+      vtkIdType rowStartVoxelIndex = (k-imageExtent[4])*sliceSize + (j-imageExtent[2])*rowSize - imageExtent[0];
+      RegionVoxelRunType run;
+      run.NumberOfVoxels = 0;
+      for (int i=extent[0]; i<=extent[1]; i++)
+      {
+        vtkIdType voxelIndex = rowStartVoxelIndex + i;
+        if (labelScalars==NULL || labelScalars->GetComponent(voxelIndex, 0)==labelValue)
+        {
+          if (run.NumberOfVoxels==0)
+          {
+            run.FirstVoxelIndex = voxelIndex;
+          }
+          run.NumberOfVoxels++;
+        }
+        else if (run.NumberOfVoxels>0)
+        {
+          voxelRuns.push_back(run);
+          run.NumberOfVoxels = 0;
+        }
+      }
+      if (run.NumberOfVoxels>0)
+      {
+        voxelRuns.push_back(run);
+      }
+    }
+  }
+
+  // Compute statistics of each item
+  RegionStatisticsType emptyStatistics = {0, 0.0, 0.0, 0.0, 0.0};
+  std::vector<RegionStatisticsType> statistics(numberOfItems, emptyStatistics);
+  if (!voxelRuns.empty())
+  {
+    ComputeRegionStatisticsThreadDataType threadData;
+    threadData.Images = &images;
+    threadData.VoxelRuns = &voxelRuns;
+    threadData.Statistics = &statistics;
+    threadData.Component = component;
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    int numberOfThreads = 1;
+    if (numberOfItems>=MIN_NUMBER_OF_ITEMS_FOR_PARALLEL_REGION_STATISTICS)
     {
-      // index name is matching, so we consider it compatible
-      compatibleNodes->AddItem(multidimNode);
+      numberOfThreads = std::min<int>(threader->GetNumberOfThreads(), numberOfItems);
+    }
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(ComputeRegionStatisticsThreadFunction, &threadData);
+    threader->SingleMethodExecute();
+  }
+
+  // Fill the output table
+  vtkSmartPointer<vtkAbstractArray> indexValueArray;
+  if (volumeSequenceNode->GetIndexType()==vtkMRMLSequenceNode::NumericIndex)
+  {
+    indexValueArray = vtkSmartPointer<vtkDoubleArray>::New();
+  }
+  else
+  {
+    indexValueArray = vtkSmartPointer<vtkStringArray>::New();
+  }
+  indexValueArray->SetName("IndexValue");
+  indexValueArray->SetNumberOfTuples(numberOfItems);
+  vtkSmartPointer<vtkDoubleArray> meanArray = vtkSmartPointer<vtkDoubleArray>::New();
+  meanArray->SetName("Mean");
+  meanArray->SetNumberOfTuples(numberOfItems);
+  vtkSmartPointer<vtkDoubleArray> minimumArray = vtkSmartPointer<vtkDoubleArray>::New();
+  minimumArray->SetName("Minimum");
+  minimumArray->SetNumberOfTuples(numberOfItems);
+  vtkSmartPointer<vtkDoubleArray> maximumArray = vtkSmartPointer<vtkDoubleArray>::New();
+  maximumArray->SetName("Maximum");
+  maximumArray->SetNumberOfTuples(numberOfItems);
+  vtkSmartPointer<vtkDoubleArray> standardDeviationArray = vtkSmartPointer<vtkDoubleArray>::New();
+  standardDeviationArray->SetName("StandardDeviation");
+  standardDeviationArray->SetNumberOfTuples(numberOfItems);
+  vtkSmartPointer<vtkIdTypeArray> numberOfVoxelsArray = vtkSmartPointer<vtkIdTypeArray>::New();
+  numberOfVoxelsArray->SetName("NumberOfVoxels");
+  numberOfVoxelsArray->SetNumberOfTuples(numberOfItems);
+  for (int itemIndex=0; itemIndex<numberOfItems; itemIndex++)
+  {
+    std::string indexValue = volumeSequenceNode->GetNthIndexValue(itemIndex);
+    vtkDoubleArray* numericIndexValueArray = vtkDoubleArray::SafeDownCast(indexValueArray);
+    if (numericIndexValueArray!=NULL)
+    {
+      numericIndexValueArray->SetValue(itemIndex, atof(indexValue.c_str()));
+    }
+    else
+    {
+      vtkStringArray::SafeDownCast(indexValueArray)->SetValue(itemIndex, indexValue);
+    }
+    const RegionStatisticsType& itemStatistics = statistics[itemIndex];
+    numberOfVoxelsArray->SetValue(itemIndex, itemStatistics.NumberOfVoxels);
+    if (itemStatistics.NumberOfVoxels==0)
+    {
+      meanArray->SetValue(itemIndex, vtkMath::Nan());
+      minimumArray->SetValue(itemIndex, vtkMath::Nan());
+      maximumArray->SetValue(itemIndex, vtkMath::Nan());
+      standardDeviationArray->SetValue(itemIndex, vtkMath::Nan());
+      continue;
     }
+    double mean = itemStatistics.Sum/itemStatistics.NumberOfVoxels;
+    double variance = itemStatistics.SumOfSquares/itemStatistics.NumberOfVoxels - mean*mean;
+    meanArray->SetValue(itemIndex, mean);
+    minimumArray->SetValue(itemIndex, itemStatistics.Minimum);
+    maximumArray->SetValue(itemIndex, itemStatistics.Maximum);
+    // variance may be slightly negative due to rounding errors
+    standardDeviationArray->SetValue(itemIndex, sqrt(std::max(0.0, variance)));
   }
+  timeCurves->AddColumn(indexValueArray);
+  timeCurves->AddColumn(meanArray);
+  timeCurves->AddColumn(minimumArray);
+  timeCurves->AddColumn(maximumArray);
+  timeCurves->AddColumn(standardDeviationArray);
+  timeCurves->AddColumn(numberOfVoxelsArray);
+  return true;
 }
@@ -29,14 +29,28 @@
 
 // MRML includes
 
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
 // STD includes
 #include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "vtkSlicerSequenceBrowserModuleLogicExport.h"
 
+class vtkImageData;
+class vtkMatrix4x4;
 class vtkMRMLNode;
+class vtkMRMLScalarVolumeNode;
 class vtkMRMLSequenceBrowserNode;
 class vtkMRMLSequenceNode;
+class vtkTable;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class VTK_SLICER_SEQUENCEBROWSER_MODULE_LOGIC_EXPORT vtkSlicerSequenceBrowserLogic :
@@ -48,17 +62,94 @@ public:
   vtkTypeMacro(vtkSlicerSequenceBrowserLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
-  /// Refreshes the output of all the active browser nodes. Called regularly by a timer.
+  enum
+  {
+    /// Invoked when playback is started or stopped in any of the browser nodes,
+    /// or when a playing browser node is modified (not by the playback itself), as its playback rate may have changed
+    PlaybackStateChangedEvent = vtkCommand::UserEvent + 1
+  };
+
+  /// Refreshes the output of all the active browser nodes. Called by the playback timer.
   void UpdateAllVirtualOutputNodes();
 
-  /// Updates the contents of all the virtual output nodes (all the nodes copied from the master and synchronized sequences to the scene)
+  /// Returns true if playback is active in any of the browser nodes
+  bool IsPlaybackActive();
+
+  /// Returns the time until the next item has to be selected in any of the playing browser nodes.
+  /// Returns a negative value if there is no active playback (no update is needed).
+  /// Browser nodes that are not played in real time and have a playback rate of 0 fps or less are treated as not playing.
+  double GetTimeUntilNextPlaybackUpdateSec();
+
+  /// Returns the current time of a shared playback clock (see vtkMRMLSequenceBrowserNode::SetPlaybackClockName).
+  /// Returns 0 if no playing browser node uses the clock.
+  double GetSharedPlaybackClockTimeSec(const char* clockName);
+
+  /// Moves a shared playback clock to the specified time and selects the item nearest to this time
+  /// in all the playing browser nodes that use the clock.
+  void SetSharedPlaybackClockTimeSec(const char* clockName, double clockTimeSec);
+
+  /// Returns the number of items that were skipped during the current (or last) playback of the browser node
+  /// because the items could not be displayed fast enough. Invalid items that are skipped are not included.
+  int GetNumberOfSkippedItems(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Playback statistics of a browser node. Statistics are collected all the time (not just during playback)
+  /// and are reset when playback is started.
+  void ResetPlaybackStatistics(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns the number of new items displayed per second during the last few seconds
+  double GetAchievedPlaybackFps(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns the given percentile (between 0 and 100) of the duration of the recent virtual output node updates
+  double GetUpdateLatencyPercentileSec(vtkMRMLSequenceBrowserNode* browserNode, double percentile);
+
+  /// Returns the total time spent with updating the virtual output nodes
+  double GetTotalUpdateTimeSec(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns the total time spent with copying content of sequence items to the virtual output nodes (part of the update time)
+  double GetTotalShallowCopyTimeSec(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns the total time spent in processing modified events of the virtual output nodes (part of the update time).
+  /// This includes updates of the display pipelines that observe the output nodes.
+  double GetTotalModifiedEventProcessingTimeSec(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns the total time the playback updates were late compared to when they were due.
+  /// This is the time the application spent with rendering and other processing between playback updates.
+  double GetTotalPlaybackUpdateDelaySec(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns the ratio of virtual output node updates that were skipped because the output node
+  /// already contained the content of the source node (between 0 and 1)
+  double GetVirtualOutputCacheHitRate(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Returns all the playback statistics of the browser node in a single line of text
+  std::string GetPlaybackStatisticsAsString(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Updates the contents of all the virtual output nodes (all the nodes copied from the master and synchronized sequences to the scene).
+  /// Output nodes that already contain the content of their source node are not modified.
   void UpdateVirtualOutputNodes(vtkMRMLSequenceBrowserNode* browserNode);
 
   /// Selectes the next sequence item for display
   void SelectNextItem(vtkMRMLSequenceBrowserNode* browserNode, int selectionIncrement=1);
 
+  /// Get all the sequence nodes in the scene that have the same index name as the master node (master node is not included).
+  /// Sequence nodes are looked up in an index name registry that the logic keeps up-to-date, so the scene is not searched.
   void GetCompatibleNodesFromScene(vtkCollection* compatibleNodes, vtkMRMLSequenceNode* multidimDataRootNode);
 
+  /// Returns a number that is incremented each time a sequence node is added to or removed from the index name registry
+  /// (or its index name is changed), i.e., when the result of GetCompatibleNodesFromScene may change.
+  vtkGetMacro(CompatibleNodesGeneration, unsigned long);
+
+  /// Computes statistics of the voxel values in a region for each item of a scalar volume sequence.
+  /// The region is an IJK extent, which is clamped to the image extent. If a labelmap is specified then only those voxels
+  /// of the region are included where the labelmap value is labelValue (the labelmap must have the same extent and
+  /// IJK to RAS matrix as the images, it is not resampled).
+  /// The output table contains one row for each item, with columns IndexValue, Mean, Minimum, Maximum, StandardDeviation,
+  /// and NumberOfVoxels. Statistics of invalid items and of items that are not scalar volumes with the same extent and
+  /// IJK to RAS matrix as the first valid item are NaN (and NumberOfVoxels is 0).
+  /// Returns false if the sequence does not contain a valid scalar volume, the region does not overlap with the image,
+  /// or the labelmap geometry does not match the image geometry.
+  bool ComputeRegionTimeCurves(vtkMRMLSequenceNode* volumeSequenceNode, const int regionExtent[6],
+    vtkMRMLScalarVolumeNode* labelmap, int labelValue, vtkTable* timeCurves, int component=0);
+
 protected:
   vtkSlicerSequenceBrowserLogic();
   virtual ~vtkSlicerSequenceBrowserLogic();
@@ -73,15 +164,182 @@ protected:
 
   bool IsDataConnectorNode(vtkMRMLNode*);
 
+  /// Copy the content of the source node to the target node. The target node name is not preserved.
+  /// Only called from the main thread, uses member scratch objects to avoid memory allocation at each playback update.
   void ShallowCopy(vtkMRMLNode* target, vtkMRMLNode* source);
 
-  // Time of the last update of each browser node (in universal time)
-  std::map< vtkMRMLSequenceBrowserNode*, double > LastSequenceBrowserUpdateTimeSec;
+  /// Invokes PlaybackStateChangedEvent if playback has been started or stopped in any browser node since the last call.
+  /// The event is invoked as well if modifiedBrowserNode is playing and it was not modified by the playback update,
+  /// because then its playback parameters (rate, real-time mode, selected item) may have been changed.
+  void UpdatePlaybackState(vtkMRMLSequenceBrowserNode* modifiedBrowserNode=NULL);
+
+  /// Returns true if any property of the browser node that affects the virtual output nodes
+  /// (root node, selected item, synchronized nodes, output nodes) changed since the last update
+  bool IsVirtualOutputUpdateNeeded(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Adds the sequence node to the index name registry or moves it to a different index name if its index name has changed
+  void UpdateSequenceNodeIndexNameRegistry(vtkMRMLSequenceNode* sequenceNode);
+
+  /// Removes the sequence node from the index name registry
+  void RemoveSequenceNodeFromIndexNameRegistry(vtkMRMLSequenceNode* sequenceNode);
+
+  /// Content of a virtual output node at the last update
+  struct VirtualOutputStateType
+  {
+    vtkWeakPointer<vtkMRMLNode> SourceNode;
+    unsigned long SourceNodeMTime;
+    vtkWeakPointer<vtkMRMLNode> TargetNode;
+    unsigned long TargetNodeMTime;
+    std::string IndexValue;
+  };
+
+  /// Browser node properties and virtual output node contents at the last update
+  struct VirtualOutputUpdateStateType
+  {
+    vtkMRMLSequenceNode* RootNode;
+    int SelectedItemNumber;
+    /// Synchronized sequence nodes and their modification time
+    std::vector< std::pair< vtkMRMLSequenceNode*, unsigned long > > SynchronizedRootNodes;
+    /// Virtual output node content for each synchronized sequence node
+    std::map< vtkMRMLSequenceNode*, VirtualOutputStateType > VirtualOutputs;
+  };
+
+  /// Playback timing of a browser node
+  struct PlaybackClockType
+  {
+    /// Time of the last update (in universal time)
+    double LastUpdateTimeSec;
+    /// Elapsed time that has not been consumed by item changes yet (when playing at PlaybackRateFps)
+    double ElapsedTimeRemainderSec;
+    /// Current playback position in index value units (when playing in real time)
+    double PlaybackIndexValue;
+    /// Item that was selected after the last update, to detect selection changes made by the user
+    int SelectedItemNumber;
+  };
+
+  /// Returns true if the browser node has to be played in real time (based on the index values of the master sequence)
+  bool IsRealTimePlayback(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Advances the real-time playback position and returns the number of items to move forward
+  int GetRealTimeSelectionIncrement(vtkMRMLSequenceBrowserNode* browserNode, PlaybackClockType& clock, double elapsedTimeSec);
+
+  /// Performance statistics of a browser node
+  struct PlaybackStatisticsType
+  {
+    /// Time when new items were displayed during the last few seconds (in universal time)
+    std::deque<double> DisplayedItemTimesSec;
+    /// Duration of the most recent virtual output node updates
+    std::deque<double> UpdateDurationsSec;
+    int NumberOfUpdates;
+    double TotalUpdateTimeSec;
+    double TotalShallowCopyTimeSec;
+    double TotalModifiedEventProcessingTimeSec;
+    int NumberOfPlaybackUpdates;
+    double TotalPlaybackUpdateDelaySec;
+    /// Number of virtual output nodes that were updated or skipped because they were already up-to-date
+    int NumberOfUpdatedVirtualOutputs;
+    int NumberOfUnchangedVirtualOutputs;
+  };
+
+  /// Returns the statistics of the browser node or NULL if no statistics are available
+  const PlaybackStatisticsType* GetPlaybackStatistics(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Adds the measurements of a virtual output node update to the statistics
+  void UpdatePlaybackStatistics(PlaybackStatisticsType& statistics, double updateStartTimeSec, double updateEndTimeSec,
+    double shallowCopyTimeSec, double modifiedEventProcessingTimeSec, int numberOfUpdatedVirtualOutputs, int numberOfUnchangedVirtualOutputs,
+    bool newItemDisplayed);
+
+  /// Playback timing shared by multiple browser nodes
+  struct SharedPlaybackClockType
+  {
+    /// Time of the last update (in universal time)
+    double LastUpdateTimeSec;
+    /// Current playback position in index value units
+    double ClockTimeSec;
+  };
+
+  /// Returns true if the browser node is played by a shared playback clock
+  bool IsSharedClockPlayback(vtkMRMLSequenceBrowserNode* browserNode);
+
+  /// Advances all the shared playback clocks and selects the nearest item in each playing browser node that uses them
+  void UpdateSharedPlaybackClocks(double currentTimeSec);
+
+  /// Selects the item nearest to the clock time in each browser node
+  void SelectItemsAtSharedClockTime(const std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes, double clockTimeSec);
+
+  /// Returns the playing browser nodes that use the shared clock
+  void GetSharedClockBrowserNodes(const std::string& clockName, std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes);
+
+  /// Returns the time range that a shared clock has to run through to play all the browser nodes
+  /// and if playback has to be restarted when the end is reached
+  void GetSharedClockTimeRange(const std::vector< vtkMRMLSequenceBrowserNode* >& browserNodes, double& startTimeSec, double& endTimeSec, bool& looped);
+
+  /// Numeric index values of all the items of a sequence node
+  struct NumericIndexValuesType
+  {
+    /// Modification time of the sequence node when the index values were parsed
+    unsigned long SequenceNodeMTime;
+    std::vector<double> IndexValues;
+  };
+
+  /// Returns the numeric index values of all the items of the sequence node.
+  /// Index values are only parsed again if the sequence node has been modified, as they are needed at each playback update.
+  const std::vector<double>& GetNumericIndexValues(vtkMRMLSequenceNode* sequenceNode);
+
+  /// Returns the index value of the n-th item as a number (0 if the item number is out of range)
+  double GetNthNumericIndexValue(vtkMRMLSequenceNode* sequenceNode, int itemNumber);
+
+  // Playback timing of each playing browser node
+  std::map< vtkMRMLSequenceBrowserNode*, PlaybackClockType > PlaybackClocks;
+
+  // Shared playback clocks, indexed by clock name
+  std::map< std::string, SharedPlaybackClockType > SharedPlaybackClocks;
+
+  // Number of items skipped during playback of each browser node
+  std::map< vtkMRMLSequenceBrowserNode*, int > NumberOfSkippedItems;
+
+  // Performance statistics of each browser node
+  std::map< vtkMRMLSequenceBrowserNode*, PlaybackStatisticsType > PlaybackStatistics;
+
+  // Cached numeric index values of sequence nodes
+  std::map< vtkMRMLSequenceNode*, NumericIndexValuesType > NumericIndexValues;
+
+  // Time when the next playback update is due (in universal time), as computed by GetTimeUntilNextPlaybackUpdateSec.
+  // Negative if no update is expected.
+  double PlaybackUpdateDueTimeSec;
+
+  // State of each browser node at the last virtual output node update (pointers are only compared, never dereferenced)
+  std::map< vtkMRMLSequenceBrowserNode*, VirtualOutputUpdateStateType > VirtualOutputUpdateStates;
+
+  // All the browser nodes in the scene (to avoid searching the scene at each playback update)
+  std::set< vtkMRMLSequenceBrowserNode* > BrowserNodes;
+
+  // Sequence nodes in the scene grouped by index name, in the order they were added (to find compatible nodes without searching the scene).
+  // Sequence nodes that have no index name are not included.
+  std::map< std::string, std::vector< vtkMRMLSequenceNode* > > SequenceNodesByIndexName;
+
+  // Index name of each sequence node in SequenceNodesByIndexName (to detect index name changes)
+  std::map< vtkMRMLSequenceNode*, std::string > SequenceNodeIndexNames;
+
+  // Incremented at each change of the index name registry
+  unsigned long CompatibleNodesGeneration;
+
+  // Number of playing browser nodes at the last UpdatePlaybackState call
+  int NumberOfPlayingBrowserNodes;
+
+  // Scratch matrix for ShallowCopy (reused to avoid allocation for each copied volume and transform)
+  vtkSmartPointer<vtkMatrix4x4> ShallowCopyMatrix;
+
+  // Image objects that ShallowCopy created for volume output nodes (these share the scalars of the item images)
+  std::map< vtkMRMLNode*, vtkWeakPointer<vtkImageData> > VirtualOutputImages;
 
 private:
 
   bool UpdateVirtualOutputNodesInProgress;
 
+  // True while the playback timer selects the next items (browser node modifications are not caused by the user then)
+  bool UpdateAllVirtualOutputNodesInProgress;
+
   vtkSlicerSequenceBrowserLogic(const vtkSlicerSequenceBrowserLogic&); // Not implemented
   void operator=(const vtkSlicerSequenceBrowserLogic&);               // Not implemented
 };
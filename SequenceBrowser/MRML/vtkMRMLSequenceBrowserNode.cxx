@@ -32,8 +32,10 @@
 // VTK includes
 #include <vtkObjectFactory.h>
 #include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
 
 // STD includes
+#include <iomanip>
 #include <sstream>
 #include <algorithm> // for std::find
 
@@ -52,14 +54,21 @@ vtkMRMLSequenceBrowserNode::vtkMRMLSequenceBrowserNode()
   this->PlaybackActive=false;
   this->PlaybackRateFps=10.0;
   this->PlaybackLooped=true;
+  this->PlaybackRealTime=false;
+  this->PlaybackClockName=NULL;
   this->SelectedItemNumber=0;
   this->LastPostfixIndex=0;
+  this->CachedRootNodeReferencesValid=false;
+  this->RecordingActive=false;
+  this->RecordingMaximumNumberOfItems=0;
+  this->RecordingMaximumTimeWindowSec=0.0;
+  this->ResetRecordingStatistics();
 }
 
 //----------------------------------------------------------------------------
 vtkMRMLSequenceBrowserNode::~vtkMRMLSequenceBrowserNode()
 {
- 
+  this->SetPlaybackClockName(NULL);
 }
 
 //----------------------------------------------------------------------------
@@ -71,7 +80,14 @@ void vtkMRMLSequenceBrowserNode::WriteXML(ostream& of, int nIndent)
   of << indent << " playbackActive=\"" << (this->PlaybackActive ? "true" : "false") << "\"";
   of << indent << " playbackRateFps=\"" << this->PlaybackRateFps << "\""; 
   of << indent << " playbackLooped=\"" << (this->PlaybackLooped ? "true" : "false") << "\"";  
+  of << indent << " playbackRealTime=\"" << (this->PlaybackRealTime ? "true" : "false") << "\"";
+  if (this->PlaybackClockName!=NULL)
+  {
+    of << indent << " playbackClockName=\"" << this->PlaybackClockName << "\"";
+  }
   of << indent << " selectedItemNumber=\"" << this->SelectedItemNumber << "\"";
+  of << indent << " recordingMaximumNumberOfItems=\"" << this->RecordingMaximumNumberOfItems << "\"";
+  of << indent << " recordingMaximumTimeWindowSec=\"" << this->RecordingMaximumTimeWindowSec << "\"";
 
   of << indent << " virtualNodePostfixes=\"";
   for(std::vector< std::string >::iterator roleNameIt=this->VirtualNodePostfixes.begin();
@@ -130,6 +146,21 @@ void vtkMRMLSequenceBrowserNode::ReadXMLAttributes(const char** atts)
         this->SetPlaybackLooped(0);
       }
     }
+    else if (!strcmp(attName, "playbackRealTime"))
+    {
+      if (!strcmp(attValue,"true"))
+      {
+        this->SetPlaybackRealTime(1);
+      }
+      else
+      {
+        this->SetPlaybackRealTime(0);
+      }
+    }
+    else if (!strcmp(attName, "playbackClockName"))
+    {
+      this->SetPlaybackClockName(attValue);
+    }
     else if (!strcmp(attName, "selectedItemNumber")) 
     {
       std::stringstream ss;
@@ -138,9 +169,26 @@ void vtkMRMLSequenceBrowserNode::ReadXMLAttributes(const char** atts)
       ss >> selectedItemNumber;
       this->SetSelectedItemNumber(selectedItemNumber);
     }
+    else if (!strcmp(attName, "recordingMaximumNumberOfItems"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      int recordingMaximumNumberOfItems=0;
+      ss >> recordingMaximumNumberOfItems;
+      this->SetRecordingMaximumNumberOfItems(recordingMaximumNumberOfItems);
+    }
+    else if (!strcmp(attName, "recordingMaximumTimeWindowSec"))
+    {
+      std::stringstream ss;
+      ss << attValue;
+      double recordingMaximumTimeWindowSec=0.0;
+      ss >> recordingMaximumTimeWindowSec;
+      this->SetRecordingMaximumTimeWindowSec(recordingMaximumTimeWindowSec);
+    }
     else if (!strcmp(attName, "virtualNodePostfixes"))
     {
       this->VirtualNodePostfixes.clear();
+      this->CachedRootNodeReferencesValid=false;
       std::stringstream ss(attValue);
       while (!ss.eof())
       {
@@ -169,6 +217,7 @@ void vtkMRMLSequenceBrowserNode::Copy(vtkMRMLNode *anode)
     return;
   }
   this->VirtualNodePostfixes=node->VirtualNodePostfixes;
+  this->CachedRootNodeReferencesValid=false;
 }
 
 //----------------------------------------------------------------------------
@@ -206,6 +255,7 @@ void vtkMRMLSequenceBrowserNode::SetAndObserveRootNodeID(const char *rootNodeID)
   {
     rolePostfix=GenerateVirtualNodePostfix();
     this->VirtualNodePostfixes.push_back(rolePostfix);
+    this->CachedRootNodeReferencesValid=false;
     std::string rootNodeReferenceRole=ROOT_NODE_REFERENCE_ROLE_BASE+rolePostfix;
     this->SetAndObserveNodeReferenceID(rootNodeReferenceRole.c_str(), rootNodeID);
   }
@@ -215,13 +265,67 @@ void vtkMRMLSequenceBrowserNode::SetAndObserveRootNodeID(const char *rootNodeID)
 //----------------------------------------------------------------------------
 vtkMRMLSequenceNode* vtkMRMLSequenceBrowserNode::GetRootNode()
 {
-  if (this->VirtualNodePostfixes.empty())
+  this->UpdateCachedRootNodeReferences();
+  if (this->CachedRootNodeReferences.empty())
   {
     return NULL;
-  }  
-  std::string rootNodeReferenceRole=ROOT_NODE_REFERENCE_ROLE_BASE+this->VirtualNodePostfixes[0];  
-  vtkMRMLSequenceNode* node=vtkMRMLSequenceNode::SafeDownCast(this->GetNodeReference(rootNodeReferenceRole.c_str()));
-  return node;
+  }
+  return this->CachedRootNodeReferences[0].RootNode;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::OnNodeReferenceAdded(vtkMRMLNodeReference *reference)
+{
+  this->CachedRootNodeReferencesValid=false;
+  Superclass::OnNodeReferenceAdded(reference);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::OnNodeReferenceRemoved(vtkMRMLNodeReference *reference)
+{
+  this->CachedRootNodeReferencesValid=false;
+  Superclass::OnNodeReferenceRemoved(reference);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::OnNodeReferenceModified(vtkMRMLNodeReference *reference)
+{
+  this->CachedRootNodeReferencesValid=false;
+  Superclass::OnNodeReferenceModified(reference);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::UpdateCachedRootNodeReferences()
+{
+  if (this->CachedRootNodeReferencesValid)
+  {
+    return;
+  }
+  this->CachedRootNodeReferences.clear();
+  this->CachedRootNodeReferenceIndices.clear();
+  // References that are not resolved yet (e.g., right after scene loading) are not cached
+  bool allReferencesResolved=true;
+  for (std::vector< std::string >::iterator rolePostfixIt=this->VirtualNodePostfixes.begin();
+    rolePostfixIt!=this->VirtualNodePostfixes.end(); ++rolePostfixIt)
+  {
+    RootNodeReferencesType references;
+    references.Postfix=(*rolePostfixIt);
+    std::string rootNodeRef=ROOT_NODE_REFERENCE_ROLE_BASE+(*rolePostfixIt);
+    references.RootNode=vtkMRMLSequenceNode::SafeDownCast(this->GetNodeReference(rootNodeRef.c_str()));
+    std::string dataNodeRef=DATA_NODE_REFERENCE_ROLE_BASE+(*rolePostfixIt);
+    references.DataNode=this->GetNodeReference(dataNodeRef.c_str());
+    if ((references.RootNode==NULL && this->GetNodeReferenceID(rootNodeRef.c_str())!=NULL)
+      || (references.DataNode==NULL && this->GetNodeReferenceID(dataNodeRef.c_str())!=NULL))
+    {
+      allReferencesResolved=false;
+    }
+    if (references.RootNode!=NULL && this->CachedRootNodeReferenceIndices.find(references.RootNode)==this->CachedRootNodeReferenceIndices.end())
+    {
+      this->CachedRootNodeReferenceIndices[references.RootNode]=this->CachedRootNodeReferences.size();
+    }
+    this->CachedRootNodeReferences.push_back(references);
+  }
+  this->CachedRootNodeReferencesValid=allReferencesResolved;
 }
 
 //----------------------------------------------------------------------------
@@ -256,6 +360,7 @@ void vtkMRMLSequenceBrowserNode::RemoveAllRootNodes()
       if (rolePostfixInOriginalIt!=this->VirtualNodePostfixes.end())
       {
         this->VirtualNodePostfixes.erase(rolePostfixInOriginalIt);
+        this->CachedRootNodeReferencesValid=false;
       }
       continue;
     }
@@ -273,16 +378,13 @@ std::string vtkMRMLSequenceBrowserNode::GetVirtualNodePostfixFromRoot(vtkMRMLSeq
     vtkErrorMacro("vtkMRMLSequenceBrowserNode::GetVirtualNodePostfixFromRoot failed: rootNode is invalid");
     return "";
   }
-  for (std::vector< std::string >::iterator rolePostfixIt=this->VirtualNodePostfixes.begin();
-    rolePostfixIt!=this->VirtualNodePostfixes.end(); ++rolePostfixIt)
+  this->UpdateCachedRootNodeReferences();
+  std::map< vtkMRMLSequenceNode*, int >::iterator referenceIndexIt=this->CachedRootNodeReferenceIndices.find(rootNode);
+  if (referenceIndexIt==this->CachedRootNodeReferenceIndices.end())
   {
-    std::string dataNodeRef=ROOT_NODE_REFERENCE_ROLE_BASE+(*rolePostfixIt);
-    if (this->GetNodeReference(dataNodeRef.c_str())==rootNode)
-    {
-      return (*rolePostfixIt);
-    }
+    return "";
   }
-  return "";
+  return this->CachedRootNodeReferences[referenceIndexIt->second].Postfix;
 }
 
 //----------------------------------------------------------------------------
@@ -293,13 +395,13 @@ vtkMRMLNode* vtkMRMLSequenceBrowserNode::GetVirtualOutputDataNode(vtkMRMLSequenc
     vtkErrorMacro("vtkMRMLSequenceBrowserNode::GetVirtualOutputNode failed: rootNode is invalid");
     return NULL;
   }
-  std::string rolePostfix=GetVirtualNodePostfixFromRoot(rootNode);
-  if (rolePostfix.empty())
+  this->UpdateCachedRootNodeReferences();
+  std::map< vtkMRMLSequenceNode*, int >::iterator referenceIndexIt=this->CachedRootNodeReferenceIndices.find(rootNode);
+  if (referenceIndexIt==this->CachedRootNodeReferenceIndices.end())
   {
     return NULL;
   }
-  std::string dataNodeRef=DATA_NODE_REFERENCE_ROLE_BASE+rolePostfix;
-  return this->GetNodeReference(dataNodeRef.c_str());
+  return this->CachedRootNodeReferences[referenceIndexIt->second].DataNode;
 }
 
 //----------------------------------------------------------------------------
@@ -385,11 +487,11 @@ vtkMRMLNode* vtkMRMLSequenceBrowserNode::AddVirtualOutputNodes(vtkMRMLNode* sour
 void vtkMRMLSequenceBrowserNode::GetAllVirtualOutputDataNodes(std::vector< vtkMRMLNode* >& nodes)
 {
   nodes.clear();
-  for (std::vector< std::string >::iterator rolePostfixIt=this->VirtualNodePostfixes.begin();
-    rolePostfixIt!=this->VirtualNodePostfixes.end(); ++rolePostfixIt)
+  this->UpdateCachedRootNodeReferences();
+  for (std::vector< RootNodeReferencesType >::iterator referencesIt=this->CachedRootNodeReferences.begin();
+    referencesIt!=this->CachedRootNodeReferences.end(); ++referencesIt)
   {
-    std::string dataNodeRef=DATA_NODE_REFERENCE_ROLE_BASE+(*rolePostfixIt);
-    nodes.push_back(this->GetNodeReference(dataNodeRef.c_str()));
+    nodes.push_back(referencesIt->DataNode);
   }
 }
 
@@ -401,6 +503,8 @@ void vtkMRMLSequenceBrowserNode::RemoveVirtualOutputDataNode(const std::string&
   vtkMRMLNode* dataNode=this->GetNodeReference(dataNodeRef.c_str());
   if (dataNode!=NULL)
   {
+    // the cache must not refer to the node after it is removed
+    this->CachedRootNodeReferencesValid=false;
     this->Scene->RemoveNode(dataNode);
     this->RemoveAllNodeReferenceIDs(dataNodeRef.c_str());
   }
@@ -430,21 +534,20 @@ bool vtkMRMLSequenceBrowserNode::IsSynchronizedRootNode(const char* nodeId)
     vtkWarningMacro("vtkMRMLSequenceBrowserNode::IsSynchronizedRootNode nodeId is NULL");
     return false;
   }
-  for (std::vector< std::string >::iterator rolePostfixIt=this->VirtualNodePostfixes.begin();
-    rolePostfixIt!=this->VirtualNodePostfixes.end(); ++rolePostfixIt)
+  this->UpdateCachedRootNodeReferences();
+  for (std::vector< RootNodeReferencesType >::iterator referencesIt=this->CachedRootNodeReferences.begin();
+    referencesIt!=this->CachedRootNodeReferences.end(); ++referencesIt)
   {
-    if (rolePostfixIt==this->VirtualNodePostfixes.begin())
+    if (referencesIt==this->CachedRootNodeReferences.begin())
     {
       // the first one is the master root node, don't consider as a synchronized root node
       continue;
     }
-    std::string rootNodeRef=ROOT_NODE_REFERENCE_ROLE_BASE+(*rolePostfixIt);
-    const char* foundNodeId=this->GetNodeReferenceID(rootNodeRef.c_str());
-    if (foundNodeId==NULL)
+    if (referencesIt->RootNode==NULL || referencesIt->RootNode->GetID()==NULL)
     {
       continue;
     }
-    if (strcmp(foundNodeId,nodeId)==0)
+    if (strcmp(referencesIt->RootNode->GetID(),nodeId)==0)
     {
       return true;
     }
@@ -458,6 +561,7 @@ std::string vtkMRMLSequenceBrowserNode::AddSynchronizedRootNode(const char* sync
   bool oldModify=this->StartModify();
   std::string rolePostfix=GenerateVirtualNodePostfix();
   this->VirtualNodePostfixes.push_back(rolePostfix);
+  this->CachedRootNodeReferencesValid=false;
   std::string rootNodeReferenceRole=ROOT_NODE_REFERENCE_ROLE_BASE+rolePostfix;
   this->SetAndObserveNodeReferenceID(rootNodeReferenceRole.c_str(), synchronizedRootNodeId);
   this->EndModify(oldModify);
@@ -493,6 +597,7 @@ void vtkMRMLSequenceBrowserNode::RemoveSynchronizedRootNode(const char* nodeId)
       std::string rolePostfix=(*rolePostfixIt);
       bool oldModify=this->StartModify();
       this->VirtualNodePostfixes.erase(rolePostfixIt);
+      this->CachedRootNodeReferencesValid=false;
       this->RemoveAllNodeReferenceIDs(rootNodeRef.c_str());
       this->RemoveVirtualOutputDataNode(rolePostfix);
       this->RemoveVirtualOutputDisplayNodes(rolePostfix);      
@@ -508,16 +613,16 @@ void vtkMRMLSequenceBrowserNode::GetSynchronizedRootNodes(std::vector< vtkMRMLSe
 {
   synchronizedDataNodes.clear();
 
-  for (std::vector< std::string >::iterator rolePostfixIt=this->VirtualNodePostfixes.begin();
-    rolePostfixIt!=this->VirtualNodePostfixes.end(); ++rolePostfixIt)
+  this->UpdateCachedRootNodeReferences();
+  for (std::vector< RootNodeReferencesType >::iterator referencesIt=this->CachedRootNodeReferences.begin();
+    referencesIt!=this->CachedRootNodeReferences.end(); ++referencesIt)
   {
-    if (!includeMasterNode && rolePostfixIt==this->VirtualNodePostfixes.begin())
+    if (!includeMasterNode && referencesIt==this->CachedRootNodeReferences.begin())
     {
       // the first one is the master root node, don't consider as a synchronized root node
       continue;
     }
-    std::string rootNodeRef=ROOT_NODE_REFERENCE_ROLE_BASE+(*rolePostfixIt);
-    vtkMRMLSequenceNode* synchronizedNode=vtkMRMLSequenceNode::SafeDownCast(this->GetNodeReference(rootNodeRef.c_str()));
+    vtkMRMLSequenceNode* synchronizedNode=referencesIt->RootNode;
     if (synchronizedNode==NULL)
     {
       // valid case during scene updates
@@ -526,3 +631,104 @@ void vtkMRMLSequenceBrowserNode::GetSynchronizedRootNodes(std::vector< vtkMRMLSe
     synchronizedDataNodes.push_back(synchronizedNode);
   }
 }
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::SetRecordingActive(bool recording)
+{
+  if (this->RecordingActive==recording)
+  {
+    return;
+  }
+  if (recording)
+  {
+    this->ResetRecordingStatistics();
+  }
+  this->RecordingActive=recording;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::ResetRecordingStatistics()
+{
+  this->NumberOfRecordedSamples=0;
+  this->NumberOfDroppedItems=0;
+  this->RecordingStartTimeSec=0.0;
+  this->LastRecordingLatencySec=0.0;
+  this->MaximumRecordingLatencySec=0.0;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLSequenceBrowserNode::GetRecordingRateFps()
+{
+  if (this->NumberOfRecordedSamples<2)
+  {
+    return 0.0;
+  }
+  double recordingTimeSec=vtkTimerLog::GetUniversalTime()-this->RecordingStartTimeSec;
+  if (recordingTimeSec<=0)
+  {
+    return 0.0;
+  }
+  return (this->NumberOfRecordedSamples-1)/recordingTimeSec;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceBrowserNode::RecordVirtualOutputNodes(double indexValue)
+{
+  if (!this->RecordingActive)
+  {
+    return;
+  }
+  double recordingStartTimeSec=vtkTimerLog::GetUniversalTime();
+  if (this->NumberOfRecordedSamples==0)
+  {
+    this->RecordingStartTimeSec=recordingStartTimeSec;
+  }
+
+  std::stringstream indexValueStream;
+  indexValueStream << std::fixed << std::setprecision(6) << indexValue;
+  std::string indexValueString=indexValueStream.str();
+
+  this->UpdateCachedRootNodeReferences();
+  // Make a copy, as the cached references may be invalidated while nodes are added to the sequences
+  std::vector< RootNodeReferencesType > rootNodeReferences=this->CachedRootNodeReferences;
+  for (std::vector< RootNodeReferencesType >::iterator referencesIt=rootNodeReferences.begin();
+    referencesIt!=rootNodeReferences.end(); ++referencesIt)
+  {
+    vtkMRMLSequenceNode* rootNode=referencesIt->RootNode;
+    if (rootNode==NULL || referencesIt->DataNode==NULL)
+    {
+      continue;
+    }
+    // Determine how many of the oldest items have to be dropped to make room for the new item
+    int numberOfItems=rootNode->GetNumberOfDataNodes();
+    int numberOfItemsToRemove=0;
+    if (this->RecordingMaximumNumberOfItems>0 && numberOfItems>=this->RecordingMaximumNumberOfItems)
+    {
+      numberOfItemsToRemove=numberOfItems-this->RecordingMaximumNumberOfItems+1;
+    }
+    if (this->RecordingMaximumTimeWindowSec>0 && rootNode->GetIndexType()==vtkMRMLSequenceNode::NumericIndex)
+    {
+      double oldestIndexValueToKeep=indexValue-this->RecordingMaximumTimeWindowSec;
+      while (numberOfItemsToRemove<numberOfItems
+        && atof(rootNode->GetNthIndexValue(numberOfItemsToRemove).c_str())<oldestIndexValueToKeep)
+      {
+        numberOfItemsToRemove++;
+      }
+    }
+    if (numberOfItemsToRemove>1)
+    {
+      rootNode->RemoveFirstDataNodes(numberOfItemsToRemove-1);
+    }
+    // the data node of the last dropped item is reused for the new item
+    rootNode->AppendDataNodeAtValue(referencesIt->DataNode, indexValueString.c_str(), numberOfItemsToRemove>0);
+    this->NumberOfDroppedItems+=numberOfItemsToRemove;
+  }
+
+  this->NumberOfRecordedSamples++;
+  this->LastRecordingLatencySec=vtkTimerLog::GetUniversalTime()-recordingStartTimeSec;
+  if (this->LastRecordingLatencySec>this->MaximumRecordingLatencySec)
+  {
+    this->MaximumRecordingLatencySec=this->LastRecordingLatencySec;
+  }
+}
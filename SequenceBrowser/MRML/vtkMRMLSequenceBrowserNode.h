@@ -75,11 +75,57 @@ public:
   vtkGetMacro(PlaybackLooped, bool);
   vtkSetMacro(PlaybackLooped, bool);
   vtkBooleanMacro(PlaybackLooped, bool);
+
+  /// Get/Set real-time playback. If enabled and the master sequence has a numeric index then
+  /// items are played at the pace of their index values (interpreted as time in seconds) instead of PlaybackRateFps.
+  vtkGetMacro(PlaybackRealTime, bool);
+  vtkSetMacro(PlaybackRealTime, bool);
+  vtkBooleanMacro(PlaybackRealTime, bool);
+
+  /// Get/Set the name of the shared playback clock. Playing browser nodes that have the same clock name
+  /// are played together in real time: at each playback update all of them select the item that has
+  /// the index value nearest to the common clock time (the master sequence must have a numeric index).
+  /// If empty then the browser node is played independently.
+  vtkGetStringMacro(PlaybackClockName);
+  vtkSetStringMacro(PlaybackClockName);
   
   /// Get/Set selected bundle index
   vtkGetMacro(SelectedItemNumber, int);
   vtkSetMacro(SelectedItemNumber, int);
 
+  /// Get/Set live recording. If active then RecordVirtualOutputNodes appends the current content
+  /// of the virtual output nodes to their sequences. Recording statistics are reset when recording is started.
+  vtkGetMacro(RecordingActive, bool);
+  void SetRecordingActive(bool recording);
+  vtkBooleanMacro(RecordingActive, bool);
+
+  /// Get/Set the maximum number of items kept in each recorded sequence (0 = unlimited).
+  /// When the limit is reached then the oldest items are dropped and their data nodes are reused for the new items.
+  vtkGetMacro(RecordingMaximumNumberOfItems, int);
+  vtkSetMacro(RecordingMaximumNumberOfItems, int);
+
+  /// Get/Set the maximum time span of the items kept in recorded sequences (in seconds, 0 = unlimited).
+  /// Only used for sequences with numeric index.
+  vtkGetMacro(RecordingMaximumTimeWindowSec, double);
+  vtkSetMacro(RecordingMaximumTimeWindowSec, double);
+
+  /// Append the current content of all the virtual output nodes to their sequences at the specified index value
+  /// (typically the acquisition time in seconds). Does nothing if recording is not active.
+  void RecordVirtualOutputNodes(double indexValue);
+
+  /// Number of samples recorded since recording was started
+  vtkGetMacro(NumberOfRecordedSamples, int);
+  /// Number of items dropped from the recorded sequences because of the capacity or time window limit
+  vtkGetMacro(NumberOfDroppedItems, int);
+  /// Time spent in the last RecordVirtualOutputNodes call (in seconds)
+  vtkGetMacro(LastRecordingLatencySec, double);
+  /// Maximum time spent in a RecordVirtualOutputNodes call since recording was started (in seconds)
+  vtkGetMacro(MaximumRecordingLatencySec, double);
+  /// Average number of recorded samples per second since recording was started
+  double GetRecordingRateFps();
+  /// Reset all the recording counters
+  void ResetRecordingStatistics();
+
   void RemoveAllVirtualOutputNodes();
 
   vtkMRMLNode* GetVirtualOutputDataNode(vtkMRMLSequenceNode* rootNode);
@@ -118,18 +164,57 @@ protected:
   std::string GenerateVirtualNodePostfix();
   std::string GetVirtualNodePostfixFromRoot(vtkMRMLSequenceNode* rootNode);
 
+  /// Invalidate the cached root node references when any node reference changes
+  virtual void OnNodeReferenceAdded(vtkMRMLNodeReference *reference);
+  virtual void OnNodeReferenceRemoved(vtkMRMLNodeReference *reference);
+  virtual void OnNodeReferenceModified(vtkMRMLNodeReference *reference);
+
+  /// Rebuild CachedRootNodeReferences if they are not valid
+  void UpdateCachedRootNodeReferences();
+
 protected:
   bool PlaybackActive;
   double PlaybackRateFps;
   bool PlaybackLooped;
+  bool PlaybackRealTime;
+  char* PlaybackClockName;
   int SelectedItemNumber;
 
+  bool RecordingActive;
+  int RecordingMaximumNumberOfItems;
+  double RecordingMaximumTimeWindowSec;
+
+  // Recording statistics
+  int NumberOfRecordedSamples;
+  int NumberOfDroppedItems;
+  double RecordingStartTimeSec;
+  double LastRecordingLatencySec;
+  double MaximumRecordingLatencySec;
+
   // Unique postfixes for storing references to root nodes, virtual data nodes, and virtual display nodes
   // For example, a root node reference role name is ROOT_NODE_REFERENCE_ROLE_BASE+virtualNodePostfix
   std::vector< std::string > VirtualNodePostfixes;
 
   // Counter that is used for generating the unique (only for this class) virtual node postfix strings
   int LastPostfixIndex;
+
+  // Nodes referenced with the same virtual node postfix
+  struct RootNodeReferencesType
+  {
+    std::string Postfix;
+    vtkMRMLSequenceNode* RootNode;
+    vtkMRMLNode* DataNode;
+  };
+
+  // Referenced nodes for each postfix (in the same order as VirtualNodePostfixes), to avoid
+  // building reference role names and looking up references by name at each playback update.
+  // Display node references are not cached: they are only read when virtual output display nodes are removed,
+  // which changes the references anyway, and GetVirtualOutputDisplayNodes gets them from the virtual output data node.
+  std::vector< RootNodeReferencesType > CachedRootNodeReferences;
+  // Index of the first CachedRootNodeReferences item of each root node
+  std::map< vtkMRMLSequenceNode*, int > CachedRootNodeReferenceIndices;
+  // If false then the cached references have to be rebuilt before use
+  bool CachedRootNodeReferencesValid;
 };
 
 #endif
@@ -0,0 +1,162 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SequenceBrowser includes
+#include "vtkSlicerSequenceBrowserLogic.h"
+
+// Sequences includes
+#include "vtkMRMLSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+vtkMRMLSequenceNode* AddSequenceNode(vtkMRMLScene* scene, const char* name, const char* indexName)
+{
+  vtkSmartPointer<vtkMRMLSequenceNode> sequenceNode = vtkSmartPointer<vtkMRMLSequenceNode>::New();
+  sequenceNode->SetName(name);
+  sequenceNode->SetIndexName(indexName);
+  scene->AddNode(sequenceNode);
+  return sequenceNode;
+}
+
+//----------------------------------------------------------------------------
+// Checks that the compatible nodes of the root node are the expected nodes, in the expected order
+bool CheckCompatibleNodes(vtkSlicerSequenceBrowserLogic* logic, vtkMRMLSequenceNode* rootNode,
+  const std::vector<vtkMRMLSequenceNode*>& expectedNodes)
+{
+  vtkNew<vtkCollection> compatibleNodes;
+  logic->GetCompatibleNodesFromScene(compatibleNodes.GetPointer(), rootNode);
+  bool match = (compatibleNodes->GetNumberOfItems() == static_cast<int>(expectedNodes.size()));
+  for (int i=0; match && i<compatibleNodes->GetNumberOfItems(); i++)
+  {
+    match = (compatibleNodes->GetItemAsObject(i) == expectedNodes[i]);
+  }
+  if (!match)
+  {
+    std::cerr << "Compatible nodes of " << rootNode->GetName() << " - expected:";
+    for (std::vector<vtkMRMLSequenceNode*>::const_iterator nodeIt = expectedNodes.begin(); nodeIt != expectedNodes.end(); ++nodeIt)
+    {
+      std::cerr << " " << (*nodeIt)->GetName();
+    }
+    std::cerr << ", got:";
+    for (int i=0; i<compatibleNodes->GetNumberOfItems(); i++)
+    {
+      std::cerr << " " << vtkMRMLSequenceNode::SafeDownCast(compatibleNodes->GetItemAsObject(i))->GetName();
+    }
+    std::cerr << std::endl;
+  }
+  return match;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerSequenceBrowserLogicCompatibleNodesTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceNode>::New());
+
+  // Nodes that are in the scene before the logic is set up are registered, too
+  vtkMRMLSequenceNode* timeNodeA = AddSequenceNode(scene.GetPointer(), "TimeA", "time");
+  vtkMRMLSequenceNode* frameNode = AddSequenceNode(scene.GetPointer(), "Frame", "frame");
+
+  vtkNew<vtkSlicerSequenceBrowserLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  vtkMRMLSequenceNode* timeNodeB = AddSequenceNode(scene.GetPointer(), "TimeB", "time");
+  vtkMRMLSequenceNode* timeNodeC = AddSequenceNode(scene.GetPointer(), "TimeC", "time");
+
+  // The root node itself is not included, nodes are returned in the order they were added
+  std::vector<vtkMRMLSequenceNode*> expectedNodes;
+  expectedNodes.push_back(timeNodeB);
+  expectedNodes.push_back(timeNodeC);
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeA, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+  expectedNodes.clear();
+  if (!CheckCompatibleNodes(logic.GetPointer(), frameNode, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Modifications that do not change the index name do not change the registry
+  timeNodeB->SetIndexUnit("s");
+  expectedNodes.push_back(timeNodeA);
+  expectedNodes.push_back(timeNodeB);
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeC, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Changing the index name moves the node to the end of the list of the new index name
+  frameNode->SetIndexName("time");
+  timeNodeA->SetIndexName("frame");
+  expectedNodes.clear();
+  expectedNodes.push_back(timeNodeB);
+  expectedNodes.push_back(frameNode);
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeC, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+  expectedNodes.clear();
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeA, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Removed nodes are not compatible anymore
+  scene->RemoveNode(timeNodeB);
+  expectedNodes.push_back(frameNode);
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeC, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Nodes without index name are not compatible with any node
+  frameNode->SetIndexName(NULL);
+  expectedNodes.clear();
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeC, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Registry is rebuilt when the scene is changed
+  vtkNew<vtkMRMLScene> otherScene;
+  otherScene->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceNode>::New());
+  vtkMRMLSequenceNode* otherTimeNode = AddSequenceNode(otherScene.GetPointer(), "OtherTime", "time");
+  logic->SetMRMLScene(otherScene.GetPointer());
+  expectedNodes.push_back(otherTimeNode);
+  if (!CheckCompatibleNodes(logic.GetPointer(), timeNodeC, expectedNodes))
+  {
+    return EXIT_FAILURE;
+  }
+
+  logic->SetMRMLScene(NULL);
+  return EXIT_SUCCESS;
+}
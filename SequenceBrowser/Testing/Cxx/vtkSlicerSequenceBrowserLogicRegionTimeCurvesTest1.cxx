@@ -0,0 +1,250 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SequenceBrowser includes
+#include "vtkSlicerSequenceBrowserLogic.h"
+
+// Sequences includes
+#include "vtkMRMLSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTable.h>
+#include <vtkVersion.h>
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+// At least 4 items, so that the statistics are computed in multiple threads
+const int NUMBER_OF_ITEMS = 6;
+const int INVALID_ITEM_NUMBER = 2;
+const int DIFFERENT_GEOMETRY_ITEM_NUMBER = 4;
+const int LABEL_VALUE = 3;
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> CreateImage(const int extent[6], int scalarType)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetExtent(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+#if (VTK_MAJOR_VERSION <= 5)
+  image->SetScalarType(scalarType);
+  image->SetNumberOfScalarComponents(1);
+  image->AllocateScalars();
+#else
+  image->AllocateScalars(scalarType, 1);
+#endif
+  return image;
+}
+
+//----------------------------------------------------------------------------
+struct ExpectedStatisticsType
+{
+  vtkIdType NumberOfVoxels;
+  double Mean;
+  double Minimum;
+  double Maximum;
+  double StandardDeviation;
+};
+
+//----------------------------------------------------------------------------
+// Computes the statistics of the region voxels directly from the image (labelmap is optional)
+ExpectedStatisticsType ComputeExpectedStatistics(vtkImageData* image, const int region[6], vtkImageData* labelmap)
+{
+  ExpectedStatisticsType expected = {0, 0.0, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, 0.0};
+  double sum = 0.0;
+  double sumOfSquares = 0.0;
+  int* extent = image->GetExtent();
+  for (int k=std::max(region[4], extent[4]); k<=std::min(region[5], extent[5]); k++)
+  {
+    for (int j=std::max(region[2], extent[2]); j<=std::min(region[3], extent[3]); j++)
+    {
+      for (int i=std::max(region[0], extent[0]); i<=std::min(region[1], extent[1]); i++)
+      {
+        if (labelmap!=NULL && labelmap->GetScalarComponentAsDouble(i, j, k, 0)!=LABEL_VALUE)
+        {
+          continue;
+        }
+        double value = image->GetScalarComponentAsDouble(i, j, k, 0);
+        sum += value;
+        sumOfSquares += value*value;
+        expected.Minimum = std::min(expected.Minimum, value);
+        expected.Maximum = std::max(expected.Maximum, value);
+        expected.NumberOfVoxels++;
+      }
+    }
+  }
+  expected.Mean = sum/expected.NumberOfVoxels;
+  expected.StandardDeviation = sqrt(sumOfSquares/expected.NumberOfVoxels - expected.Mean*expected.Mean);
+  return expected;
+}
+
+//----------------------------------------------------------------------------
+bool IsEqual(double actual, double expected)
+{
+  return fabs(actual-expected) <= 1e-6*std::max(1.0, fabs(expected));
+}
+
+//----------------------------------------------------------------------------
+// Checks the statistics of all the items in the output table
+bool CheckTimeCurves(vtkTable* timeCurves, vtkMRMLSequenceNode* sequenceNode, const int region[6], vtkImageData* labelmap)
+{
+  vtkDoubleArray* indexValueArray = vtkDoubleArray::SafeDownCast(timeCurves->GetColumnByName("IndexValue"));
+  vtkDoubleArray* meanArray = vtkDoubleArray::SafeDownCast(timeCurves->GetColumnByName("Mean"));
+  vtkDoubleArray* minimumArray = vtkDoubleArray::SafeDownCast(timeCurves->GetColumnByName("Minimum"));
+  vtkDoubleArray* maximumArray = vtkDoubleArray::SafeDownCast(timeCurves->GetColumnByName("Maximum"));
+  vtkDoubleArray* standardDeviationArray = vtkDoubleArray::SafeDownCast(timeCurves->GetColumnByName("StandardDeviation"));
+  vtkIdTypeArray* numberOfVoxelsArray = vtkIdTypeArray::SafeDownCast(timeCurves->GetColumnByName("NumberOfVoxels"));
+  if (indexValueArray==NULL || meanArray==NULL || minimumArray==NULL || maximumArray==NULL
+    || standardDeviationArray==NULL || numberOfVoxelsArray==NULL || timeCurves->GetNumberOfRows()!=NUMBER_OF_ITEMS)
+  {
+    std::cerr << "Time curves table does not contain the expected columns and rows" << std::endl;
+    return false;
+  }
+  for (int itemNumber=0; itemNumber<NUMBER_OF_ITEMS; itemNumber++)
+  {
+    if (indexValueArray->GetValue(itemNumber) != itemNumber*0.5)
+    {
+      std::cerr << "Item " << itemNumber << ": incorrect index value " << indexValueArray->GetValue(itemNumber) << std::endl;
+      return false;
+    }
+    if (itemNumber==INVALID_ITEM_NUMBER || itemNumber==DIFFERENT_GEOMETRY_ITEM_NUMBER)
+    {
+      // these items are skipped
+      if (numberOfVoxelsArray->GetValue(itemNumber)!=0 || !vtkMath::IsNan(meanArray->GetValue(itemNumber)))
+      {
+        std::cerr << "Item " << itemNumber << " is expected to be skipped" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(sequenceNode->GetNthDataNode(itemNumber));
+    ExpectedStatisticsType expected = ComputeExpectedStatistics(volumeNode->GetImageData(), region, labelmap);
+    if (numberOfVoxelsArray->GetValue(itemNumber)!=expected.NumberOfVoxels
+      || !IsEqual(meanArray->GetValue(itemNumber), expected.Mean)
+      || !IsEqual(minimumArray->GetValue(itemNumber), expected.Minimum)
+      || !IsEqual(maximumArray->GetValue(itemNumber), expected.Maximum)
+      || !IsEqual(standardDeviationArray->GetValue(itemNumber), expected.StandardDeviation))
+    {
+      std::cerr << "Item " << itemNumber << ": expected " << expected.NumberOfVoxels << " voxels, mean " << expected.Mean
+        << ", minimum " << expected.Minimum << ", maximum " << expected.Maximum << ", standard deviation " << expected.StandardDeviation
+        << "; got " << numberOfVoxelsArray->GetValue(itemNumber) << " voxels, mean " << meanArray->GetValue(itemNumber)
+        << ", minimum " << minimumArray->GetValue(itemNumber) << ", maximum " << maximumArray->GetValue(itemNumber)
+        << ", standard deviation " << standardDeviationArray->GetValue(itemNumber) << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerSequenceBrowserLogicRegionTimeCurvesTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkSlicerSequenceBrowserLogic> logic;
+
+  const int extent[6] = {0, 5, 0, 3, 0, 2};
+  vtkNew<vtkMRMLSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  sequenceNode->SetIndexType(vtkMRMLSequenceNode::NumericIndex);
+  for (int itemNumber=0; itemNumber<NUMBER_OF_ITEMS; itemNumber++)
+  {
+    vtkSmartPointer<vtkImageData> image = CreateImage(extent, VTK_SHORT);
+    for (int k=extent[4]; k<=extent[5]; k++)
+    {
+      for (int j=extent[2]; j<=extent[3]; j++)
+      {
+        for (int i=extent[0]; i<=extent[1]; i++)
+        {
+          // values vary along all axes and in time, with both positive and negative values
+          image->SetScalarComponentFromDouble(i, j, k, 0, (i*i - 7*j + 3*k)*(itemNumber+1) - 20);
+        }
+      }
+    }
+    vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+    volumeNode->SetAndObserveImageData(image);
+    if (itemNumber==DIFFERENT_GEOMETRY_ITEM_NUMBER)
+    {
+      volumeNode->SetSpacing(2.0, 1.0, 1.0);
+    }
+    std::ostringstream indexValueStr;
+    indexValueStr << itemNumber*0.5;
+    sequenceNode->SetDataNodeAtValue(volumeNode.GetPointer(), indexValueStr.str().c_str());
+  }
+  sequenceNode->SetNthItemValid(INVALID_ITEM_NUMBER, false);
+
+  // Region is clamped to the image extent
+  const int region[6] = {-2, 3, 1, 2, 1, 10};
+  vtkNew<vtkTable> timeCurves;
+  if (!logic->ComputeRegionTimeCurves(sequenceNode.GetPointer(), region, NULL, 0, timeCurves.GetPointer())
+    || !CheckTimeCurves(timeCurves.GetPointer(), sequenceNode.GetPointer(), region, NULL))
+  {
+    std::cerr << "Region time curves are incorrect" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Only voxels with the label value are included (not contiguous in the rows)
+  vtkSmartPointer<vtkImageData> labelmapImage = CreateImage(extent, VTK_UNSIGNED_CHAR);
+  for (int k=extent[4]; k<=extent[5]; k++)
+  {
+    for (int j=extent[2]; j<=extent[3]; j++)
+    {
+      for (int i=extent[0]; i<=extent[1]; i++)
+      {
+        labelmapImage->SetScalarComponentFromDouble(i, j, k, 0, (i%3==0 || i==j) ? 0 : LABEL_VALUE);
+      }
+    }
+  }
+  vtkNew<vtkMRMLScalarVolumeNode> labelmap;
+  labelmap->SetAndObserveImageData(labelmapImage);
+  if (!logic->ComputeRegionTimeCurves(sequenceNode.GetPointer(), region, labelmap.GetPointer(), LABEL_VALUE, timeCurves.GetPointer())
+    || !CheckTimeCurves(timeCurves.GetPointer(), sequenceNode.GetPointer(), region, labelmapImage))
+  {
+    std::cerr << "Labelmap region time curves are incorrect" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Labelmap geometry must match the image geometry
+  labelmap->SetOrigin(0.5, 0.0, 0.0);
+  if (logic->ComputeRegionTimeCurves(sequenceNode.GetPointer(), region, labelmap.GetPointer(), LABEL_VALUE, timeCurves.GetPointer()))
+  {
+    std::cerr << "Labelmap with different geometry is accepted" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Region outside the image
+  const int outsideRegion[6] = {10, 12, 0, 3, 0, 2};
+  if (logic->ComputeRegionTimeCurves(sequenceNode.GetPointer(), outsideRegion, NULL, 0, timeCurves.GetPointer()))
+  {
+    std::cerr << "Region outside the image is accepted" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
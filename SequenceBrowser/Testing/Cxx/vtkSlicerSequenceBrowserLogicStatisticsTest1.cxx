@@ -0,0 +1,145 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SequenceBrowser includes
+#include "vtkMRMLSequenceBrowserNode.h"
+#include "vtkSlicerSequenceBrowserLogic.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace
+{
+const int NUMBER_OF_UPDATES = 100;
+// Same as the maximum number of latency samples that the logic keeps
+const int MAX_NUMBER_OF_LATENCY_SAMPLES = 300;
+const double UPDATE_START_TIME_SEC = 100.0;
+
+//----------------------------------------------------------------------------
+bool CheckValue(const char* description, double actual, double expected)
+{
+  if (fabs(actual-expected) > 1e-9)
+  {
+    std::cerr << description << ": expected " << expected << ", got " << actual << std::endl;
+    return false;
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+// Allows adding updates with known durations to the statistics
+class vtkSlicerSequenceBrowserLogicStatisticsTester : public vtkSlicerSequenceBrowserLogic
+{
+public:
+  static vtkSlicerSequenceBrowserLogicStatisticsTester *New();
+  vtkTypeMacro(vtkSlicerSequenceBrowserLogicStatisticsTester, vtkSlicerSequenceBrowserLogic);
+
+  void AddUpdate(vtkMRMLSequenceBrowserNode* browserNode, double durationSec, int numberOfUpdatedVirtualOutputs, int numberOfUnchangedVirtualOutputs)
+  {
+    this->UpdatePlaybackStatistics(this->PlaybackStatistics[browserNode], UPDATE_START_TIME_SEC, UPDATE_START_TIME_SEC+durationSec,
+      0.0, 0.0, numberOfUpdatedVirtualOutputs, numberOfUnchangedVirtualOutputs, false);
+  }
+
+protected:
+  vtkSlicerSequenceBrowserLogicStatisticsTester() {}
+  ~vtkSlicerSequenceBrowserLogicStatisticsTester() {}
+
+private:
+  vtkSlicerSequenceBrowserLogicStatisticsTester(const vtkSlicerSequenceBrowserLogicStatisticsTester&); // Not implemented
+  void operator=(const vtkSlicerSequenceBrowserLogicStatisticsTester&); // Not implemented
+};
+
+vtkStandardNewMacro(vtkSlicerSequenceBrowserLogicStatisticsTester);
+
+//----------------------------------------------------------------------------
+int vtkSlicerSequenceBrowserLogicStatisticsTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkSlicerSequenceBrowserLogicStatisticsTester> logic;
+  vtkNew<vtkMRMLSequenceBrowserNode> browserNode;
+
+  // No statistics
+  if (!CheckValue("Median without statistics", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 50), 0.0)
+    || logic->GetPlaybackStatisticsAsString(browserNode.GetPointer()) != "No statistics available")
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Update durations of 1, 2, ..., 100 ms, added in a shuffled order
+  logic->ResetPlaybackStatistics(browserNode.GetPointer());
+  double totalUpdateTimeSec = 0.0;
+  for (int updateIndex=0; updateIndex<NUMBER_OF_UPDATES; updateIndex++)
+  {
+    double durationSec = ((updateIndex*37)%NUMBER_OF_UPDATES+1)*0.001;
+    logic->AddUpdate(browserNode.GetPointer(), durationSec, 3, 1);
+    totalUpdateTimeSec += durationSec;
+  }
+  // The percentile is the sample at the nearest rank, out of range percentiles are clamped
+  if (!CheckValue("Minimum", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 0), 0.001)
+    || !CheckValue("Median", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 50), 0.051)
+    || !CheckValue("95th percentile", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 95), 0.095)
+    || !CheckValue("Maximum", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 100), 0.100)
+    || !CheckValue("Negative percentile", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), -10), 0.001)
+    || !CheckValue("Percentile above 100", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 150), 0.100))
+  {
+    return EXIT_FAILURE;
+  }
+  if (!CheckValue("Total update time", logic->GetTotalUpdateTimeSec(browserNode.GetPointer()), totalUpdateTimeSec)
+    || !CheckValue("Cache hit rate", logic->GetVirtualOutputCacheHitRate(browserNode.GetPointer()), 0.25))
+  {
+    return EXIT_FAILURE;
+  }
+  std::string statisticsString = logic->GetPlaybackStatisticsAsString(browserNode.GetPointer());
+  if (statisticsString.find("51.0 ms (median)") == std::string::npos || statisticsString.find("95.0 ms (95%)") == std::string::npos)
+  {
+    std::cerr << "Percentiles are missing from the statistics string: " << statisticsString << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Only the most recent updates are used for the percentiles
+  for (int updateIndex=0; updateIndex<MAX_NUMBER_OF_LATENCY_SAMPLES; updateIndex++)
+  {
+    logic->AddUpdate(browserNode.GetPointer(), 1.0, 1, 0);
+  }
+  if (!CheckValue("Minimum of recent updates", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 0), 1.0))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Statistics of other browser nodes are not affected, statistics are cleared by reset
+  vtkNew<vtkMRMLSequenceBrowserNode> otherBrowserNode;
+  logic->AddUpdate(otherBrowserNode.GetPointer(), 0.5, 1, 0);
+  if (!CheckValue("Median of other browser node", logic->GetUpdateLatencyPercentileSec(otherBrowserNode.GetPointer(), 50), 0.5))
+  {
+    return EXIT_FAILURE;
+  }
+  logic->ResetPlaybackStatistics(browserNode.GetPointer());
+  if (!CheckValue("Median after reset", logic->GetUpdateLatencyPercentileSec(browserNode.GetPointer(), 50), 0.0)
+    || !CheckValue("Total update time after reset", logic->GetTotalUpdateTimeSec(browserNode.GetPointer()), 0.0)
+    || !CheckValue("Cache hit rate after reset", logic->GetVirtualOutputCacheHitRate(browserNode.GetPointer()), 0.0))
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
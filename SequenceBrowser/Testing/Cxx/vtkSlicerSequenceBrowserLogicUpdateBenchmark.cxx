@@ -0,0 +1,164 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Measures the time of virtual output node updates of a browser node that has many synchronized sequences.
+// Most of the update time is spent in ShallowCopy, which copies the selected item of each sequence into
+// its virtual output node (the scratch matrix of the logic is reused for all volumes and transforms).
+// The update time is only checked if the maximum time per update (in milliseconds) is specified as
+// the first argument, as timing depends on the machine (a generous bound is 1.0 ms).
+
+// SequenceBrowser includes
+#include "vtkMRMLSequenceBrowserNode.h"
+#include "vtkSlicerSequenceBrowserLogic.h"
+
+// Sequences includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLSequenceImageBufferPool.h"
+#include "vtkMRMLSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+const int NUMBER_OF_VOLUME_SEQUENCES = 10;
+const int NUMBER_OF_TRANSFORM_SEQUENCES = 10;
+const int NUMBER_OF_ITEMS = 100;
+const int NUMBER_OF_UPDATES = 1000;
+
+//----------------------------------------------------------------------------
+std::string GetIndexValue(int itemNumber)
+{
+  std::ostringstream indexValueStr;
+  indexValueStr << itemNumber*0.1;
+  return indexValueStr.str();
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerSequenceBrowserLogicUpdateBenchmark(int argc, char* argv[])
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceNode>::New());
+  scene->RegisterNodeClass(vtkSmartPointer<vtkMRMLLinearTransformSequenceNode>::New());
+  vtkNew<vtkSlicerSequenceBrowserLogic> logic;
+  logic->SetMRMLScene(scene.GetPointer());
+
+  std::vector< vtkSmartPointer<vtkMRMLSequenceNode> > sequenceNodes;
+  int dimensions[3] = {64, 64, 1};
+  for (int sequenceIndex=0; sequenceIndex<NUMBER_OF_VOLUME_SEQUENCES; sequenceIndex++)
+  {
+    vtkSmartPointer<vtkMRMLSequenceNode> sequenceNode = vtkSmartPointer<vtkMRMLSequenceNode>::New();
+    sequenceNode->SetIndexName("time");
+    sequenceNode->SetIndexUnit("s");
+    scene->AddNode(sequenceNode);
+    for (int itemNumber=0; itemNumber<NUMBER_OF_ITEMS; itemNumber++)
+    {
+      vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::Take(
+        vtkMRMLSequenceImageBufferPool::GetInstance()->NewImage(dimensions, VTK_UNSIGNED_CHAR, 1));
+      vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+      volumeNode->SetAndObserveImageData(imageData);
+      volumeNode->SetOrigin(itemNumber, 0, 0);
+      sequenceNode->SetDataNodeAtValue(volumeNode.GetPointer(), GetIndexValue(itemNumber).c_str());
+    }
+    sequenceNodes.push_back(sequenceNode);
+  }
+  for (int sequenceIndex=0; sequenceIndex<NUMBER_OF_TRANSFORM_SEQUENCES; sequenceIndex++)
+  {
+    vtkSmartPointer<vtkMRMLLinearTransformSequenceNode> sequenceNode = vtkSmartPointer<vtkMRMLLinearTransformSequenceNode>::New();
+    sequenceNode->SetIndexName("time");
+    sequenceNode->SetIndexUnit("s");
+    scene->AddNode(sequenceNode);
+    vtkNew<vtkMatrix4x4> matrix;
+    for (int itemNumber=0; itemNumber<NUMBER_OF_ITEMS; itemNumber++)
+    {
+      matrix->SetElement(0, 3, itemNumber);
+      sequenceNode->SetMatrixAtValue(matrix.GetPointer(), GetIndexValue(itemNumber).c_str());
+    }
+    sequenceNodes.push_back(sequenceNode);
+  }
+
+  vtkNew<vtkMRMLSequenceBrowserNode> browserNode;
+  scene->AddNode(browserNode.GetPointer());
+  browserNode->SetAndObserveRootNodeID(sequenceNodes[0]->GetID());
+  for (unsigned int sequenceIndex=1; sequenceIndex<sequenceNodes.size(); sequenceIndex++)
+  {
+    browserNode->AddSynchronizedRootNode(sequenceNodes[sequenceIndex]->GetID());
+  }
+  // Create the virtual output nodes
+  logic->UpdateVirtualOutputNodes(browserNode.GetPointer());
+  logic->ResetPlaybackStatistics(browserNode.GetPointer());
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  for (int updateIndex=0; updateIndex<NUMBER_OF_UPDATES; updateIndex++)
+  {
+    // The logic updates the virtual output nodes when the selected item is changed
+    browserNode->SetSelectedItemNumber(updateIndex%NUMBER_OF_ITEMS);
+  }
+  timer->StopTimer();
+
+  // Check that the outputs contain the selected item
+  int expectedItemNumber = (NUMBER_OF_UPDATES-1)%NUMBER_OF_ITEMS;
+  vtkMRMLScalarVolumeNode* volumeOutputNode = vtkMRMLScalarVolumeNode::SafeDownCast(browserNode->GetVirtualOutputDataNode(sequenceNodes[0]));
+  if (volumeOutputNode==NULL || volumeOutputNode->GetOrigin()[0]!=expectedItemNumber)
+  {
+    std::cerr << "Volume output node does not contain item " << expectedItemNumber << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkMRMLLinearTransformNode* transformOutputNode = vtkMRMLLinearTransformNode::SafeDownCast(browserNode->GetVirtualOutputDataNode(sequenceNodes.back()));
+  vtkNew<vtkMatrix4x4> outputMatrix;
+  if (transformOutputNode!=NULL)
+  {
+    transformOutputNode->GetMatrixTransformToParent(outputMatrix.GetPointer());
+  }
+  if (transformOutputNode==NULL || outputMatrix->GetElement(0, 3)!=expectedItemNumber)
+  {
+    std::cerr << "Transform output node does not contain item " << expectedItemNumber << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double updateTimeMs = timer->GetElapsedTime()*1000.0/NUMBER_OF_UPDATES;
+  std::cout << "Browser node with " << sequenceNodes.size() << " sequences: "
+    << updateTimeMs << " ms per update" << std::endl;
+  std::cout << logic->GetPlaybackStatisticsAsString(browserNode.GetPointer()) << std::endl;
+  if (argc>1)
+  {
+    double maximumUpdateTimeMs = atof(argv[1]);
+    if (updateTimeMs>maximumUpdateTimeMs)
+    {
+      std::cerr << "Update time " << updateTimeMs << " ms is longer than the maximum " << maximumUpdateTimeMs << " ms" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
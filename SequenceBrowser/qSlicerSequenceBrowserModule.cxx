@@ -19,6 +19,9 @@
 #include <QTimer>
 #include <QtPlugin>
 
+// STD includes
+#include <cmath>
+
 #include "qSlicerCoreApplication.h"
 
 #include "vtkMRMLScene.h"
@@ -32,8 +35,6 @@
 
 #include "vtkMRMLSequenceBrowserNode.h"
 
-static const double UPDATE_VIRTUAL_OUTPUT_NODES_PERIOD_SEC = 0.033; // refresh output with a maximum of 30FPS
-
 //-----------------------------------------------------------------------------
 Q_EXPORT_PLUGIN2(qSlicerSequenceBrowserModule, qSlicerSequenceBrowserModule);
 
@@ -65,14 +66,13 @@ qSlicerSequenceBrowserModule
   , d_ptr(new qSlicerSequenceBrowserModulePrivate)
 {
   Q_D(qSlicerSequenceBrowserModule);
+  // The timer is only running during playback and it is restarted after each update
+  // with the time remaining until the next item has to be displayed
+  d->UpdateAllVirtualOutputNodesTimer.setSingleShot(true);
+#if QT_VERSION >= 0x050000
+  d->UpdateAllVirtualOutputNodesTimer.setTimerType(Qt::PreciseTimer);
+#endif
   connect(&d->UpdateAllVirtualOutputNodesTimer, SIGNAL(timeout()), this, SLOT(updateAllVirtualOutputNodes()));
-  vtkMRMLScene * scene = qSlicerCoreApplication::application()->mrmlScene();
-  if (scene)
-    {
-    // Need to listen for any new sequence browser nodes being added to start/stop timer
-    this->qvtkConnect(scene, vtkMRMLScene::NodeAddedEvent, this, SLOT(onNodeAddedEvent(vtkObject*,vtkObject*)));
-    this->qvtkConnect(scene, vtkMRMLScene::NodeRemovedEvent, this, SLOT(onNodeRemovedEvent(vtkObject*,vtkObject*)));
-    }
 }
 
 //-----------------------------------------------------------------------------
@@ -122,22 +122,9 @@ QStringList qSlicerSequenceBrowserModule::dependencies() const
 void qSlicerSequenceBrowserModule::setup()
 {
   this->Superclass::setup();
-}
-
-//-----------------------------------------------------------------------------
-void qSlicerSequenceBrowserModule::setMRMLScene(vtkMRMLScene* scene)
-{
-  vtkMRMLScene* oldScene = this->mrmlScene();
-  this->Superclass::setMRMLScene(scene);
-
-  if (scene == NULL)
-    {
-    return;
-    }
-
-  // Need to listen for any new sequence browser nodes being added to start/stop timer
-  this->qvtkReconnect(oldScene, scene, vtkMRMLScene::NodeAddedEvent, this, SLOT(onNodeAddedEvent(vtkObject*,vtkObject*)));
-  this->qvtkReconnect(oldScene, scene, vtkMRMLScene::NodeRemovedEvent, this, SLOT(onNodeRemovedEvent(vtkObject*,vtkObject*)));
+  // Start, stop, or reschedule the playback timer when playback is started or stopped in any of the browser nodes
+  // or the playback parameters (such as playback rate) of a playing browser node are changed
+  this->qvtkConnect(this->logic(), vtkSlicerSequenceBrowserLogic::PlaybackStateChangedEvent, this, SLOT(scheduleVirtualOutputNodesUpdate()));
 }
 
 //-----------------------------------------------------------------------------
@@ -153,50 +140,6 @@ vtkMRMLAbstractLogic* qSlicerSequenceBrowserModule::createLogic()
   return vtkSlicerSequenceBrowserLogic::New();
 }
 
-// --------------------------------------------------------------------------
-void qSlicerSequenceBrowserModule::onNodeAddedEvent(vtkObject*, vtkObject* node)
-{
-  Q_D(qSlicerSequenceBrowserModule);
-
-  vtkMRMLSequenceBrowserNode* sequenceBrowserNode = vtkMRMLSequenceBrowserNode::SafeDownCast(node);
-  if (sequenceBrowserNode)
-    {
-    // If the timer is not active
-    if (!d->UpdateAllVirtualOutputNodesTimer.isActive())
-      {
-      d->UpdateAllVirtualOutputNodesTimer.start(UPDATE_VIRTUAL_OUTPUT_NODES_PERIOD_SEC*1000.0);
-      }
-    }
-}
-
-
-// --------------------------------------------------------------------------
-void qSlicerSequenceBrowserModule::onNodeRemovedEvent(vtkObject*, vtkObject* node)
-{
-  Q_D(qSlicerSequenceBrowserModule);
-
-  vtkMRMLSequenceBrowserNode* sequenceBrowserNode = vtkMRMLSequenceBrowserNode::SafeDownCast(node);
-  if (sequenceBrowserNode)
-    {
-    // If the timer is active
-    if (d->UpdateAllVirtualOutputNodesTimer.isActive())
-      {
-      // Check if there is any other sequence browser node left in the Scene
-      vtkMRMLScene * scene = qSlicerCoreApplication::application()->mrmlScene();
-      if (scene)
-        {
-        std::vector<vtkMRMLNode *> nodes;
-        this->mrmlScene()->GetNodesByClass("vtkMRMLSequenceBrowserNode", nodes);
-        if (nodes.size() == 0)
-          {
-          // The last sequence browser was removed
-          d->UpdateAllVirtualOutputNodesTimer.stop();
-          }
-        }
-      }
-    }
-}
-
 //-----------------------------------------------------------------------------
 void qSlicerSequenceBrowserModule::updateAllVirtualOutputNodes()
 {
@@ -206,4 +149,21 @@ void qSlicerSequenceBrowserModule::updateAllVirtualOutputNodes()
     {
     sequenceBrowserLogic->UpdateAllVirtualOutputNodes();
     }
+  this->scheduleVirtualOutputNodesUpdate();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModule::scheduleVirtualOutputNodesUpdate()
+{
+  Q_D(qSlicerSequenceBrowserModule);
+  vtkSlicerSequenceBrowserLogic* sequenceBrowserLogic = vtkSlicerSequenceBrowserLogic::SafeDownCast(this->logic());
+  double timeUntilNextUpdateSec = sequenceBrowserLogic ? sequenceBrowserLogic->GetTimeUntilNextPlaybackUpdateSec() : -1.0;
+  if (timeUntilNextUpdateSec < 0)
+    {
+    // no active playback, no need for updates
+    d->UpdateAllVirtualOutputNodesTimer.stop();
+    return;
+    }
+  // Round up, to not wake up before the next item is due
+  d->UpdateAllVirtualOutputNodesTimer.start(static_cast<int>(ceil(timeUntilNextUpdateSec*1000.0)));
 }
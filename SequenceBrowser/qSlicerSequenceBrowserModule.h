@@ -68,10 +68,10 @@ protected:
   virtual vtkMRMLAbstractLogic* createLogic();
 
 public slots:
-  virtual void setMRMLScene(vtkMRMLScene*);
-  void onNodeAddedEvent(vtkObject*, vtkObject*);
-  void onNodeRemovedEvent(vtkObject*, vtkObject*);
+  /// Update the outputs of the playing browser nodes and schedule the next update
   void updateAllVirtualOutputNodes();
+  /// Start the playback timer with the time remaining until the next item is due (stop it if there is no active playback)
+  void scheduleVirtualOutputNodesUpdate();
 
 protected:
   QScopedPointer<qSlicerSequenceBrowserModulePrivate> d_ptr;
@@ -16,8 +16,11 @@
 ==============================================================================*/
 
 // Qt includes
+#include <QAtomicInt>
 #include <QCheckBox>
 #include <QDebug>
+#include <QThread>
+#include <QTimer>
 
 // SlicerQt includes
 #include "qSlicerSequenceBrowserModuleWidget.h"
@@ -34,6 +37,7 @@
 
 // Sequence includes
 #include "vtkSlicerSequenceBrowserLogic.h"
+#include "vtkMRMLLinearTransformSequenceNode.h"
 #include "vtkMRMLSequenceBrowserNode.h"
 #include "vtkMRMLSequenceNode.h"
 
@@ -41,15 +45,24 @@
 #include <vtkAbstractTransform.h>
 #include <vtkAxis.h>
 #include <vtkChartXY.h>
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
 #include <vtkFloatArray.h>
 #include <vtkGeneralTransform.h>
 #include <vtkImageData.h>
 #include <vtkMath.h>
 #include <vtkNew.h>
 #include <vtkPlot.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
 #include <vtkTable.h>
 #include <vtkMatrix4x4.h>
 
+// STD includes
+#include <algorithm>
+#include <vector>
+
 enum
 {
   SYNCH_NODES_SELECTION_COLUMN=0,
@@ -59,6 +72,137 @@ enum
   SYNCH_NODES_NUMBER_OF_COLUMNS // this must be the last line in this enum
 };
 
+// Minimum time between widget updates triggered by browser or sequence node modifications (about 30 updates per second).
+// During playback the browser node is modified at each item change, updating the widget more frequently
+// would not be visible, just slow down the playback.
+static const int WIDGET_UPDATE_INTERVAL_MSEC = 33;
+
+// Maximum number of scalar components that are displayed in the interactive chart
+static const int MAX_NUMBER_OF_CHARTED_COMPONENTS = 3;
+
+//-----------------------------------------------------------------------------
+// Copies the scalar components of a voxel
+template <class T>
+void GetVoxelComponentValues(const T* voxel, int numberOfComponents, double* values)
+{
+  for (int c = 0; c<numberOfComponents; c++)
+  {
+    values[c] = static_cast<double>(voxel[c]);
+  }
+}
+
+//-----------------------------------------------------------------------------
+/// Geometry and voxel access information of a volume item, cached for interactive charting
+struct ChartingFrameType
+{
+  /// Volume node and image data at the time of caching (only compared, never dereferenced)
+  vtkMRMLScalarVolumeNode* VolumeNode;
+  unsigned long VolumeNodeMTime;
+  vtkImageData* ImageData;
+  unsigned long ImageDataMTime;
+  /// First three rows of the RAS to IJK matrix
+  double RASToIJK[3][4];
+  /// Pointer to the first voxel, NULL if the item has no image
+  void* Scalars;
+  int ScalarType;
+  int NumberOfComponents;
+  int Extent[6];
+  vtkIdType Increments[3];
+};
+
+//-----------------------------------------------------------------------------
+// Get voxel values of a cached volume item at the specified position (in the coordinate system of the volume).
+// Returns false if the position is outside the image.
+bool SampleChartingFrame(const ChartingFrameType& frame, const double position_RAS[3], double* values, int numberOfComponents)
+{
+  if (frame.Scalars==NULL)
+  {
+    return false;
+  }
+  int position_IJK[3] = {0,0,0};
+  for (int row = 0; row<3; row++)
+  {
+    position_IJK[row] = vtkMath::Round(frame.RASToIJK[row][0]*position_RAS[0] + frame.RASToIJK[row][1]*position_RAS[1]
+      + frame.RASToIJK[row][2]*position_RAS[2] + frame.RASToIJK[row][3]);
+    if (position_IJK[row]<frame.Extent[row*2] || position_IJK[row]>frame.Extent[row*2+1])
+    {
+      return false;
+    }
+  }
+  vtkIdType offset = (position_IJK[0]-frame.Extent[0])*frame.Increments[0]
+    + (position_IJK[1]-frame.Extent[2])*frame.Increments[1]
+    + (position_IJK[2]-frame.Extent[4])*frame.Increments[2];
+  if (numberOfComponents>frame.NumberOfComponents)
+  {
+    numberOfComponents = frame.NumberOfComponents;
+  }
+  switch (frame.ScalarType)
+  {
+    vtkTemplateMacro(GetVoxelComponentValues(static_cast<VTK_TT*>(frame.Scalars)+offset, numberOfComponents, values));
+    default:
+      return false;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Samples all the volume items at a position in a background thread, so that
+/// moving the crosshair over large 4D volumes does not block the user interface.
+class qSlicerSequenceBrowserChartingThread : public QThread
+{
+public:
+  qSlicerSequenceBrowserChartingThread()
+    : NumberOfComponents(0)
+    , NumberOfValidPoints(0)
+    , Completed(false)
+  {
+    this->Position[0] = this->Position[1] = this->Position[2] = 0.0;
+  }
+
+  /// Inputs, set on the main thread before the thread is started
+  std::vector<ChartingFrameType> Frames;
+  double Position[3];
+  int NumberOfComponents;
+  /// References to the voxel buffers, to keep them valid while sampling (only modified on the main thread)
+  std::vector< vtkSmartPointer<vtkDataArray> > Buffers;
+
+  /// Outputs, only valid if Completed is true
+  std::vector<double> Values;
+  int NumberOfValidPoints;
+  bool Completed;
+
+  /// Set to nonzero to stop sampling as soon as possible
+  QAtomicInt CancelRequested;
+  /// Set to nonzero when sampling of the latest request has been completed or cancelled
+  QAtomicInt SamplingFinished;
+
+protected:
+  virtual void run()
+  {
+    this->sample();
+    this->SamplingFinished.fetchAndStoreOrdered(1);
+  }
+
+  void sample()
+  {
+    this->Completed = false;
+    this->NumberOfValidPoints = 0;
+    this->Values.assign(this->Frames.size()*MAX_NUMBER_OF_CHARTED_COMPONENTS, 0.0);
+    for (size_t i = 0; i<this->Frames.size(); i++)
+    {
+      if (this->CancelRequested.fetchAndAddOrdered(0))
+      {
+        return;
+      }
+      if (SampleChartingFrame(this->Frames[i], this->Position, &this->Values[i*MAX_NUMBER_OF_CHARTED_COMPONENTS], this->NumberOfComponents))
+      {
+        this->NumberOfValidPoints++;
+      }
+    }
+    this->Completed = true;
+  }
+};
+
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_Sequence
 class qSlicerSequenceBrowserModuleWidgetPrivate: public Ui_qSlicerSequenceBrowserModuleWidget
@@ -77,6 +221,24 @@ public:
   void updateInteractiveCharting();
   void setAndObserveCrosshairNode();
 
+  /// Update cached information of volume items that were modified since the last update
+  void updateChartingFrameCache(vtkMRMLSequenceNode* rootNode);
+
+  /// Returns the matrices of all the items of a linear transform sequence in a N x 16 array.
+  /// Only matrices of items that were modified since the last update are copied.
+  /// Returns NULL if any of the items is not a linear transform.
+  vtkDoubleArray* updateChartingMatrixCache(vtkMRMLSequenceNode* rootNode);
+
+  /// Start sampling the volume items in the background. If sampling is already in progress then
+  /// it is cancelled and a new request is made when it is finished (only the latest request is completed).
+  void requestChartingCurves(const double position_RAS[3], int numberOfComponents);
+
+  /// Cancel the sampling that is in progress, the results are not displayed
+  void cancelChartingCurves();
+
+  /// Display the curves computed in the background
+  void showChartingCurves();
+
   /// Using this flag prevents overriding the parameter set node contents when the
   ///   QMRMLCombobox selects the first instance of the specified node type when initializing
   bool ModuleWindowInitialized;
@@ -91,6 +253,37 @@ public:
   vtkFloatArray* ArrayY3;
 
   vtkWeakPointer<vtkMRMLCrosshairNode> CrosshairNode;
+
+  std::vector<ChartingFrameType> ChartingFrames;
+
+  /// Matrices of the items of a transform sequence that does not store the matrices in an array
+  vtkSmartPointer<vtkDoubleArray> ChartingMatrices;
+  /// Transform node and its modification time for each item in ChartingMatrices
+  std::vector< std::pair<vtkMRMLTransformNode*, unsigned long> > ChartingMatrixNodes;
+  /// Displacement of the crosshair position for each item of a transform sequence
+  vtkSmartPointer<vtkDoubleArray> ChartingDisplacements;
+
+  qSlicerSequenceBrowserChartingThread* ChartingThread;
+  /// A new charting update was requested while sampling was in progress
+  bool ChartingUpdatePending;
+
+  /// Coalesces the widget updates requested by node modifications
+  QTimer* WidgetUpdateTimer;
+
+  /// Returns true if the root node or the synchronized root nodes of the active browser node
+  /// are different from the ones shown in the synchronized root nodes table
+  bool isSynchronizedRootNodesTableUpdateNeeded();
+
+  /// Show the current playback statistics of the active browser node (if statistics display is enabled)
+  void updatePlaybackStatisticsLabel();
+
+  /// Master and synchronized root nodes shown in the synchronized root nodes table (only compared, never dereferenced)
+  vtkMRMLSequenceNode* SynchronizedRootNodesTableRootNode;
+  std::vector< vtkMRMLSequenceNode* > SynchronizedRootNodesTableNodes;
+  /// Index name of the master node and generation of the compatible nodes when the table was filled
+  /// (the list of compatible nodes changes when index names are changed or sequence nodes are added or removed)
+  std::string SynchronizedRootNodesTableIndexName;
+  unsigned long SynchronizedRootNodesTableCompatibleNodesGeneration;
 };
 
 //-----------------------------------------------------------------------------
@@ -106,6 +299,11 @@ qSlicerSequenceBrowserModuleWidgetPrivate::qSlicerSequenceBrowserModuleWidgetPri
   , ArrayY1(0)
   , ArrayY2(0)
   , ArrayY3(0)
+  , ChartingThread(0)
+  , ChartingUpdatePending(false)
+  , WidgetUpdateTimer(0)
+  , SynchronizedRootNodesTableRootNode(0)
+  , SynchronizedRootNodesTableCompatibleNodesGeneration(0)
 {
   this->CrosshairNode = 0;
 }
@@ -113,6 +311,12 @@ qSlicerSequenceBrowserModuleWidgetPrivate::qSlicerSequenceBrowserModuleWidgetPri
 //-----------------------------------------------------------------------------
 qSlicerSequenceBrowserModuleWidgetPrivate::~qSlicerSequenceBrowserModuleWidgetPrivate()
 {
+  if (this->ChartingThread)
+  {
+    this->ChartingThread->CancelRequested.fetchAndStoreOrdered(1);
+    this->ChartingThread->wait();
+    delete this->ChartingThread;
+  }
   if (ChartTable)
   {
     this->ChartTable->Delete();
@@ -200,6 +404,15 @@ void qSlicerSequenceBrowserModuleWidgetPrivate::init()
   this->ChartTable->AddColumn(this->ArrayY1);
   this->ChartTable->AddColumn(this->ArrayY2);
   this->ChartTable->AddColumn(this->ArrayY3);
+  this->ChartingThread = new qSlicerSequenceBrowserChartingThread;
+  this->ChartingMatrices = vtkSmartPointer<vtkDoubleArray>::New();
+  this->ChartingMatrices->SetNumberOfComponents(16);
+  this->ChartingDisplacements = vtkSmartPointer<vtkDoubleArray>::New();
+
+  Q_Q(qSlicerSequenceBrowserModuleWidget);
+  this->WidgetUpdateTimer = new QTimer(q);
+  this->WidgetUpdateTimer->setSingleShot(true);
+  this->WidgetUpdateTimer->setInterval(WIDGET_UPDATE_INTERVAL_MSEC);
 
   this->resetInteractiveCharting();
 }
@@ -207,9 +420,224 @@ void qSlicerSequenceBrowserModuleWidgetPrivate::init()
 //-----------------------------------------------------------------------------
 void qSlicerSequenceBrowserModuleWidgetPrivate::resetInteractiveCharting()
 {
+  this->cancelChartingCurves();
+  this->ChartXY->RemovePlot(0);
+  this->ChartXY->RemovePlot(0);
+  this->ChartXY->RemovePlot(0);
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerSequenceBrowserModuleWidgetPrivate::isSynchronizedRootNodesTableUpdateNeeded()
+{
+  vtkMRMLSequenceNode* rootNode = this->activeBrowserNode() ? this->activeBrowserNode()->GetRootNode() : NULL;
+  if (rootNode!=this->SynchronizedRootNodesTableRootNode)
+  {
+    return true;
+  }
+  if (rootNode==NULL)
+  {
+    return false;
+  }
+  std::string indexName = rootNode->GetIndexName() ? rootNode->GetIndexName() : "";
+  if (indexName!=this->SynchronizedRootNodesTableIndexName
+    || this->logic()->GetCompatibleNodesGeneration()!=this->SynchronizedRootNodesTableCompatibleNodesGeneration)
+  {
+    return true;
+  }
+  std::vector< vtkMRMLSequenceNode* > synchronizedRootNodes;
+  this->activeBrowserNode()->GetSynchronizedRootNodes(synchronizedRootNodes);
+  return synchronizedRootNodes!=this->SynchronizedRootNodesTableNodes;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidgetPrivate::updatePlaybackStatisticsLabel()
+{
+  if (!this->checkBox_PlaybackStatistics->isChecked())
+  {
+    return;
+  }
+  if (this->activeBrowserNode()==NULL || this->logic()==NULL)
+  {
+    this->label_PlaybackStatistics->setText("");
+    return;
+  }
+  this->label_PlaybackStatistics->setText(QString::fromStdString(this->logic()->GetPlaybackStatisticsAsString(this->activeBrowserNode())));
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidgetPrivate::updateChartingFrameCache(vtkMRMLSequenceNode* rootNode)
+{
+  ChartingFrameType emptyFrame;
+  emptyFrame.VolumeNode = NULL;
+  emptyFrame.VolumeNodeMTime = 0;
+  emptyFrame.ImageData = NULL;
+  emptyFrame.ImageDataMTime = 0;
+  emptyFrame.Scalars = NULL;
+  int numberOfDataNodes = rootNode->GetNumberOfDataNodes();
+  this->ChartingFrames.resize(numberOfDataNodes, emptyFrame);
+  for (int i = 0; i<numberOfDataNodes; i++)
+  {
+    ChartingFrameType& frame = this->ChartingFrames[i];
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(rootNode->GetNthDataNode(i));
+    vtkImageData* imageData = volumeNode ? volumeNode->GetImageData() : NULL;
+    unsigned long volumeNodeMTime = volumeNode ? volumeNode->GetMTime() : 0;
+    unsigned long imageDataMTime = imageData ? imageData->GetMTime() : 0;
+    if (volumeNode==frame.VolumeNode && volumeNodeMTime==frame.VolumeNodeMTime
+      && imageData==frame.ImageData && imageDataMTime==frame.ImageDataMTime)
+    {
+      // geometry and voxels are not changed
+      continue;
+    }
+    frame.VolumeNode = volumeNode;
+    frame.VolumeNodeMTime = volumeNodeMTime;
+    frame.ImageData = imageData;
+    frame.ImageDataMTime = imageDataMTime;
+    frame.Scalars = NULL;
+    if (imageData==NULL || imageData->GetPointData()->GetScalars()==NULL)
+    {
+      continue;
+    }
+    vtkNew<vtkMatrix4x4> rasToIjkMatrix;
+    volumeNode->GetRASToIJKMatrix(rasToIjkMatrix.GetPointer());
+    for (int row = 0; row<3; row++)
+    {
+      for (int column = 0; column<4; column++)
+      {
+        frame.RASToIJK[row][column] = rasToIjkMatrix->GetElement(row, column);
+      }
+    }
+    frame.Scalars = imageData->GetScalarPointer();
+    frame.ScalarType = imageData->GetScalarType();
+    frame.NumberOfComponents = imageData->GetNumberOfScalarComponents();
+    imageData->GetExtent(frame.Extent);
+    imageData->GetIncrements(frame.Increments);
+  }
+}
+
+//-----------------------------------------------------------------------------
+vtkDoubleArray* qSlicerSequenceBrowserModuleWidgetPrivate::updateChartingMatrixCache(vtkMRMLSequenceNode* rootNode)
+{
+  vtkMRMLLinearTransformSequenceNode* linearTransformSequenceNode = vtkMRMLLinearTransformSequenceNode::SafeDownCast(rootNode);
+  if (linearTransformSequenceNode)
+  {
+    // matrices are already stored in a contiguous array
+    return linearTransformSequenceNode->GetMatrices();
+  }
+  int numberOfDataNodes = rootNode->GetNumberOfDataNodes();
+  this->ChartingMatrices->SetNumberOfTuples(numberOfDataNodes);
+  this->ChartingMatrixNodes.resize(numberOfDataNodes, std::pair<vtkMRMLTransformNode*, unsigned long>(NULL, 0));
+  vtkNew<vtkMatrix4x4> matrix;
+  for (int i = 0; i<numberOfDataNodes; i++)
+  {
+    vtkMRMLTransformNode* transformNode = vtkMRMLTransformNode::SafeDownCast(rootNode->GetNthDataNode(i));
+    if (transformNode==NULL || !transformNode->IsLinear())
+    {
+      this->ChartingMatrixNodes.clear();
+      return NULL;
+    }
+    unsigned long transformNodeMTime = std::max(transformNode->GetMTime(), transformNode->GetTransformToParent()->GetMTime());
+    std::pair<vtkMRMLTransformNode*, unsigned long>& cachedNode = this->ChartingMatrixNodes[i];
+    if (cachedNode.first==transformNode && cachedNode.second==transformNodeMTime)
+    {
+      // matrix is not changed
+      continue;
+    }
+    cachedNode.first = transformNode;
+    cachedNode.second = transformNodeMTime;
+    transformNode->GetMatrixTransformToParent(matrix.GetPointer());
+    // vtkMatrix4x4 stores the elements in row-major order
+    this->ChartingMatrices->SetTuple(i, &(matrix->Element[0][0]));
+  }
+  return this->ChartingMatrices;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidgetPrivate::requestChartingCurves(const double position_RAS[3], int numberOfComponents)
+{
+  if (this->ChartingThread->isRunning())
+  {
+    // only the latest request matters: stop the current computation and start again when it is finished
+    this->ChartingThread->CancelRequested.fetchAndStoreOrdered(1);
+    this->ChartingUpdatePending = true;
+    return;
+  }
+  // The thread only reads the cached frame information, MRML nodes are not accessed
+  this->ChartingThread->Frames = this->ChartingFrames;
+  this->ChartingThread->Buffers.clear();
+  for (std::vector<ChartingFrameType>::iterator frameIt = this->ChartingFrames.begin(); frameIt != this->ChartingFrames.end(); ++frameIt)
+  {
+    if (frameIt->Scalars != NULL)
+    {
+      this->ChartingThread->Buffers.push_back(frameIt->ImageData->GetPointData()->GetScalars());
+    }
+  }
+  for (int i = 0; i<3; i++)
+  {
+    this->ChartingThread->Position[i] = position_RAS[i];
+  }
+  this->ChartingThread->NumberOfComponents = numberOfComponents;
+  this->ChartingThread->Completed = false;
+  this->ChartingThread->CancelRequested.fetchAndStoreOrdered(0);
+  this->ChartingThread->SamplingFinished.fetchAndStoreOrdered(0);
+  this->ChartingThread->start();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidgetPrivate::cancelChartingCurves()
+{
+  this->ChartingUpdatePending = false;
+  if (this->ChartingThread && this->ChartingThread->isRunning())
+  {
+    this->ChartingThread->CancelRequested.fetchAndStoreOrdered(1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidgetPrivate::showChartingCurves()
+{
+  if (!this->ChartingThread->Completed || this->ChartingThread->CancelRequested.fetchAndAddOrdered(0))
+  {
+    return;
+  }
+  int numberOfDataNodes = static_cast<int>(this->ChartingThread->Frames.size());
+  int numOfScalarComponents = this->ChartingThread->NumberOfComponents;
+  const std::vector<double>& values = this->ChartingThread->Values;
+  this->ChartTable->SetNumberOfRows(numberOfDataNodes);
+  vtkFloatArray* arraysY[MAX_NUMBER_OF_CHARTED_COMPONENTS] = {this->ArrayY1, this->ArrayY2, this->ArrayY3};
+  for (int i = 0; i<numberOfDataNodes; i++)
+  {
+    this->ArrayX->SetValue(i, i);
+    for (int c = 0; c<numOfScalarComponents; c++)
+    {
+      arraysY[c]->SetValue(i, values[i*MAX_NUMBER_OF_CHARTED_COMPONENTS+c]);
+    }
+  }
+  this->ArrayX->Modified();
+  for (int c = 0; c<numOfScalarComponents; c++)
+  {
+    arraysY[c]->Modified();
+  }
+  this->ChartTable->Modified();
+  //this->ChartTable->Update();
   this->ChartXY->RemovePlot(0);
   this->ChartXY->RemovePlot(0);
   this->ChartXY->RemovePlot(0);
+
+  if (this->ChartingThread->NumberOfValidPoints>0)
+  {
+    this->ChartXY->GetAxis(0)->SetTitle("Signal Intensity");
+    this->ChartXY->GetAxis(1)->SetTitle("Time");
+    for (int c = 0; c<numOfScalarComponents; c++)
+    {
+      vtkPlot* line = this->ChartXY->AddPlot(vtkChart::LINE);
+#if (VTK_MAJOR_VERSION <= 5)
+      line->SetInput(this->ChartTable, 0, c+1);
+#else
+      line->SetInputData(this->ChartTable, 0, c+1);
+#endif
+      //line->SetColor(255,0,0,255);
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -240,91 +668,77 @@ void qSlicerSequenceBrowserModuleWidgetPrivate::updateInteractiveCharting()
   vtkMRMLTransformableNode* transformableVirtualOutputNode = vtkMRMLTransformableNode::SafeDownCast(virtualOutputNode);
 
   int numberOfDataNodes = rootNode->GetNumberOfDataNodes();
-  this->ChartTable->SetNumberOfRows(numberOfDataNodes);
 
   vtkMRMLScalarVolumeNode *vNode = vtkMRMLScalarVolumeNode::SafeDownCast(rootNode->GetNthDataNode(0));
-  if (vNode)
+  if (vNode && vNode->GetImageData())
   {
     int numOfScalarComponents = 0;
     numOfScalarComponents = vNode->GetImageData()->GetNumberOfScalarComponents();
-    if (numOfScalarComponents > 3)
+    if (numOfScalarComponents > MAX_NUMBER_OF_CHARTED_COMPONENTS)
     {
       return;
     }
-    vtkNew<vtkGeneralTransform> worldTransform;
-    worldTransform->Identity();
+    // The parent transform is the same for all the items, so the crosshair position is transformed only once
+    double croshairPosition_Local[3]={croshairPosition_RAS[0], croshairPosition_RAS[1], croshairPosition_RAS[2]};
     vtkMRMLTransformNode *transformNode = transformableVirtualOutputNode ? transformableVirtualOutputNode->GetParentTransformNode() : NULL;
     if ( transformNode )
     {
+      vtkNew<vtkGeneralTransform> worldTransform;
       transformNode->GetTransformFromWorld(worldTransform.GetPointer());
+      worldTransform->TransformPoint(croshairPosition_RAS, croshairPosition_Local);
     }
 
-    int numberOfValidPoints = 0;
-    for (int i = 0; i<numberOfDataNodes; i++)
-    {
-      vNode = vtkMRMLScalarVolumeNode::SafeDownCast(rootNode->GetNthDataNode(i));
-      this->ChartTable->SetValue(i, 0, i);
-
-      vtkNew<vtkGeneralTransform> worldToIjkTransform;
-      worldToIjkTransform->PostMultiply();
-      worldToIjkTransform->Identity();
-      vtkNew<vtkMatrix4x4> rasToIjkMatrix;
-      vNode->GetRASToIJKMatrix(rasToIjkMatrix.GetPointer());
-      worldToIjkTransform->Concatenate(rasToIjkMatrix.GetPointer());
-      worldToIjkTransform->Concatenate(worldTransform.GetPointer());
-
-      double *crosshairPositionDouble_IJK = worldToIjkTransform->TransformDoublePoint(croshairPosition_RAS);
-      int croshairPosition_IJK[3]={vtkMath::Round(crosshairPositionDouble_IJK[0]), vtkMath::Round(crosshairPositionDouble_IJK[1]), vtkMath::Round(crosshairPositionDouble_IJK[2])};
-      int* imageExtent = vNode->GetImageData()->GetExtent();
-      bool isCrosshairInsideImage = imageExtent[0]<=croshairPosition_IJK[0] && croshairPosition_IJK[0]<=imageExtent[1] 
-          && imageExtent[2]<=croshairPosition_IJK[1] && croshairPosition_IJK[1]<=imageExtent[3]
-          && imageExtent[4]<=croshairPosition_IJK[2] && croshairPosition_IJK[2]<=imageExtent[5];
-      if (isCrosshairInsideImage)
-      {
-        numberOfValidPoints++;
-      }
-      for (int c = 0; c<numOfScalarComponents; c++)
-      {
-        double val = isCrosshairInsideImage ? vNode->GetImageData()->GetScalarComponentAsDouble(croshairPosition_IJK[0], croshairPosition_IJK[1], croshairPosition_IJK[2], c) : 0;
-        this->ChartTable->SetValue(i, c+1, val);
-      }
-    }
-    //this->ChartTable->Update();
-    this->ChartXY->RemovePlot(0);
-    this->ChartXY->RemovePlot(0);
-    this->ChartXY->RemovePlot(0);
+    // Only items that changed since the last crosshair move are processed here
+    this->updateChartingFrameCache(rootNode);
 
-    if (numberOfValidPoints>0)
-    {
-      this->ChartXY->GetAxis(0)->SetTitle("Signal Intensity");
-      this->ChartXY->GetAxis(1)->SetTitle("Time");
-      for (int c = 0; c<numOfScalarComponents; c++)
-      {
-        vtkPlot* line = this->ChartXY->AddPlot(vtkChart::LINE);
-#if (VTK_MAJOR_VERSION <= 5)
-        line->SetInput(this->ChartTable, 0, c+1);
-#else
-        line->SetInputData(this->ChartTable, 0, c+1);
-#endif
-        //line->SetColor(255,0,0,255);
-      }
-    }
+    // Voxel values are read in the background, the chart is updated in showChartingCurves
+    this->requestChartingCurves(croshairPosition_Local, numOfScalarComponents);
   }
 
   vtkMRMLTransformNode *tNode = vtkMRMLTransformNode::SafeDownCast(rootNode->GetNthDataNode(0));
   if (tNode)
   {
-    for (int i = 0; i<numberOfDataNodes; i++)
+    this->cancelChartingCurves();
+    this->ChartTable->SetNumberOfRows(numberOfDataNodes);
+    vtkDoubleArray* matrices = this->updateChartingMatrixCache(rootNode);
+    if (matrices)
     {
-      tNode = vtkMRMLTransformNode::SafeDownCast(rootNode->GetNthDataNode(i));
-      vtkAbstractTransform* trans2Parent = tNode->GetTransformToParent();
-
-      double* transformedcroshairPosition_RAS = trans2Parent->TransformDoublePoint(croshairPosition_RAS);
-
-      this->ChartTable->SetValue(i, 0, i);
-      this->ChartTable->SetValue(i, 1, transformedcroshairPosition_RAS[0]-croshairPosition_RAS[0]);
-      this->ChartTable->SetValue(i, 2, transformedcroshairPosition_RAS[1]-croshairPosition_RAS[1]);
-      this->ChartTable->SetValue(i, 3, transformedcroshairPosition_RAS[2]-croshairPosition_RAS[2]);
+      // Linear transforms: displacements of all the items are computed at once from the cached matrices
+      vtkNew<vtkPoints> croshairPoints;
+      croshairPoints->InsertNextPoint(croshairPosition_RAS);
+      vtkMRMLLinearTransformSequenceNode::ComputeDisplacements(matrices, croshairPoints.GetPointer(), this->ChartingDisplacements);
+      for (int i = 0; i<numberOfDataNodes; i++)
+      {
+        const double* displacement = this->ChartingDisplacements->GetPointer(i*3);
+        this->ArrayX->SetValue(i, i);
+        this->ArrayY1->SetValue(i, displacement[0]);
+        this->ArrayY2->SetValue(i, displacement[1]);
+        this->ArrayY3->SetValue(i, displacement[2]);
+      }
+      this->ArrayX->Modified();
+      this->ArrayY1->Modified();
+      this->ArrayY2->Modified();
+      this->ArrayY3->Modified();
+      this->ChartTable->Modified();
+    }
+    else
+    {
+      for (int i = 0; i<numberOfDataNodes; i++)
+      {
+        tNode = vtkMRMLTransformNode::SafeDownCast(rootNode->GetNthDataNode(i));
+        vtkAbstractTransform* trans2Parent = tNode ? tNode->GetTransformToParent() : NULL;
+        if (trans2Parent==NULL)
+        {
+          continue;
+        }
+
+        double* transformedcroshairPosition_RAS = trans2Parent->TransformDoublePoint(croshairPosition_RAS);
+
+        this->ChartTable->SetValue(i, 0, i);
+        this->ChartTable->SetValue(i, 1, transformedcroshairPosition_RAS[0]-croshairPosition_RAS[0]);
+        this->ChartTable->SetValue(i, 2, transformedcroshairPosition_RAS[1]-croshairPosition_RAS[1]);
+        this->ChartTable->SetValue(i, 3, transformedcroshairPosition_RAS[2]-croshairPosition_RAS[2]);
+      }
     }
     //this->ChartTable->Update();
     this->ChartXY->RemovePlot(0);
@@ -389,6 +803,9 @@ void qSlicerSequenceBrowserModuleWidget::setup()
   this->Superclass::setup();
   
   d->init();
+  // Sampling thread signals are delivered to the main thread through the event loop
+  connect( d->ChartingThread, SIGNAL(finished()), this, SLOT(onChartingCurvesComputed()) );
+  connect( d->WidgetUpdateTimer, SIGNAL(timeout()), this, SLOT(updateWidgetFromMRML()) );
 
   connect( d->MRMLNodeComboBox_ActiveBrowser, SIGNAL(currentNodeChanged(vtkMRMLNode*)), this, SLOT(activeBrowserNodeChanged(vtkMRMLNode*)) );
   connect( d->MRMLNodeComboBox_SequenceRoot, SIGNAL(currentNodeChanged(vtkMRMLNode*)), this, SLOT(multidimDataRootNodeChanged(vtkMRMLNode*)) );
@@ -400,6 +817,8 @@ void qSlicerSequenceBrowserModuleWidget::setup()
   connect( d->pushButton_VcrPlayPause, SIGNAL(toggled(bool)), this, SLOT(setPlaybackEnabled(bool)) );
   connect( d->pushButton_VcrLoop, SIGNAL(toggled(bool)), this, SLOT(setPlaybackLoopEnabled(bool)) );
   connect( d->doubleSpinBox_VcrPlaybackRate, SIGNAL(valueChanged(double)), this, SLOT(setPlaybackRateFps(double)) );
+  connect( d->checkBox_PlaybackStatistics, SIGNAL(toggled(bool)), this, SLOT(setPlaybackStatisticsVisible(bool)) );
+  d->label_PlaybackStatistics->setVisible(d->checkBox_PlaybackStatistics->isChecked());
 
   d->tableWidget_SynchronizedRootNodes->setColumnWidth(SYNCH_NODES_SELECTION_COLUMN, 20);
   d->tableWidget_SynchronizedRootNodes->setColumnWidth(SYNCH_NODES_NAME_COLUMN, 300);
@@ -527,13 +946,33 @@ void qSlicerSequenceBrowserModuleWidget::multidimDataRootNodeChanged(vtkMRMLNode
 //-----------------------------------------------------------------------------
 void qSlicerSequenceBrowserModuleWidget::onActiveBrowserNodeModified(vtkObject* caller)
 {
-  this->updateWidgetFromMRML();
+  this->scheduleWidgetUpdate();
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerSequenceBrowserModuleWidget::onMRMLInputSequenceInputNodeModified(vtkObject* inputNode)
 {
-  this->updateWidgetFromMRML();  
+  this->scheduleWidgetUpdate();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidget::setPlaybackStatisticsVisible(bool visible)
+{
+  Q_D(qSlicerSequenceBrowserModuleWidget);
+  d->label_PlaybackStatistics->setVisible(visible);
+  d->updatePlaybackStatisticsLabel();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidget::scheduleWidgetUpdate()
+{
+  Q_D(qSlicerSequenceBrowserModuleWidget);
+  if (d->WidgetUpdateTimer->isActive())
+  {
+    // an update is already scheduled, it will show the latest state
+    return;
+  }
+  d->WidgetUpdateTimer->start();
 }
 
 //-----------------------------------------------------------------------------
@@ -687,6 +1126,9 @@ void qSlicerSequenceBrowserModuleWidget::setSelectedItemNumber(int itemNumber)
 void qSlicerSequenceBrowserModuleWidget::updateWidgetFromMRML()
 {
   Q_D(qSlicerSequenceBrowserModuleWidget);
+
+  // this update shows the latest state, no need for a scheduled update
+  d->WidgetUpdateTimer->stop();
   
   QString DEFAULT_INDEX_NAME_STRING=tr("time");  
   
@@ -704,7 +1146,11 @@ void qSlicerSequenceBrowserModuleWidget::updateWidgetFromMRML()
     d->slider_IndexValue->setEnabled(false);
     d->doubleSpinBox_VcrPlaybackRate->setEnabled(false);
     foreach( QObject*w, vcrControls ) { w->setProperty( "enabled", vcrControlsEnabled ); }
-    this->refreshSynchronizedRootNodesTable();
+    d->updatePlaybackStatisticsLabel();
+    if (d->isSynchronizedRootNodesTableUpdateNeeded())
+    {
+      this->refreshSynchronizedRootNodesTable();
+    }
     return;
   }
 
@@ -723,7 +1169,10 @@ void qSlicerSequenceBrowserModuleWidget::updateWidgetFromMRML()
     d->Label_IndexUnit->setText("");
     d->slider_IndexValue->setEnabled(false);
     foreach( QObject*w, vcrControls ) { w->setProperty( "enabled", vcrControlsEnabled ); }
-    this->refreshSynchronizedRootNodesTable();
+    if (d->isSynchronizedRootNodesTableUpdateNeeded())
+    {
+      this->refreshSynchronizedRootNodesTable();
+    }
     return;    
   }
 
@@ -799,7 +1248,16 @@ void qSlicerSequenceBrowserModuleWidget::updateWidgetFromMRML()
 
   foreach( QObject*w, vcrControls ) { w->setProperty( "enabled", vcrControlsEnabled ); }
 
-  this->refreshSynchronizedRootNodesTable();
+  // Statistics are refreshed at the rate of widget updates, which is limited during playback
+  d->updatePlaybackStatisticsLabel();
+
+  // Rebuilding the table is expensive (all the sequence nodes in the scene are checked for compatibility),
+  // therefore it is only done if the master or synchronized nodes are changed. Changes in the scene
+  // (nodes added or removed) trigger a table refresh directly.
+  if (d->isSynchronizedRootNodesTableUpdateNeeded())
+  {
+    this->refreshSynchronizedRootNodesTable();
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -814,6 +1272,9 @@ void qSlicerSequenceBrowserModuleWidget::refreshSynchronizedRootNodesTable()
     disconnect( checkbox, SIGNAL( stateChanged(int) ), this, SLOT( synchronizedRootNodeCheckStateChanged(int) ) );
   }
 
+  d->SynchronizedRootNodesTableRootNode = NULL;
+  d->SynchronizedRootNodesTableNodes.clear();
+  d->SynchronizedRootNodesTableIndexName.clear();
   if (d->activeBrowserNode()==NULL)
   {
     d->tableWidget_SynchronizedRootNodes->setRowCount(0); // clear() would not actually remove the rows
@@ -821,12 +1282,17 @@ void qSlicerSequenceBrowserModuleWidget::refreshSynchronizedRootNodesTable()
   }
   // A valid active browser node is selected
   vtkMRMLSequenceNode* multidimDataRootNode = d->activeBrowserNode()->GetRootNode();  
+  d->SynchronizedRootNodesTableRootNode = multidimDataRootNode;
   if (multidimDataRootNode==NULL)
   {
     d->tableWidget_SynchronizedRootNodes->setRowCount(0); // clear() would not actually remove the rows
     return;
   }
 
+  d->activeBrowserNode()->GetSynchronizedRootNodes(d->SynchronizedRootNodesTableNodes);
+  d->SynchronizedRootNodesTableIndexName = multidimDataRootNode->GetIndexName() ? multidimDataRootNode->GetIndexName() : "";
+  d->SynchronizedRootNodesTableCompatibleNodesGeneration = d->logic()->GetCompatibleNodesGeneration();
+
   vtkSmartPointer<vtkCollection> compatibleNodes=vtkSmartPointer<vtkCollection>::New();
   d->logic()->GetCompatibleNodesFromScene(compatibleNodes, multidimDataRootNode);  
   d->tableWidget_SynchronizedRootNodes->setRowCount(compatibleNodes->GetNumberOfItems()+1); // +1 because we add the master as well
@@ -935,3 +1401,26 @@ void qSlicerSequenceBrowserModuleWidget::updateChart()
     d->updateInteractiveCharting();
   }
 }
+
+//-----------------------------------------------------------------------------
+void qSlicerSequenceBrowserModuleWidget::onChartingCurvesComputed()
+{
+  Q_D(qSlicerSequenceBrowserModuleWidget);
+  if (!d->ChartingThread->SamplingFinished.fetchAndAddOrdered(0))
+  {
+    // notification of a previous request, sampling of the latest request is still in progress
+    return;
+  }
+  d->ChartingThread->wait();
+  // the voxel buffers are not needed anymore (references are released on the main thread)
+  d->ChartingThread->Buffers.clear();
+  if (d->ChartingUpdatePending)
+  {
+    // the crosshair moved while sampling, compute the curves for the latest position
+    d->ChartingUpdatePending = false;
+    this->updateChart();
+    return;
+  }
+  d->showChartingCurves();
+}
+
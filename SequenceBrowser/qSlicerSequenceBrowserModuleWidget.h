@@ -50,6 +50,8 @@ public slots:
   void setPlaybackEnabled(bool play);
   void setPlaybackRateFps(double playbackRateFps);
   void setPlaybackLoopEnabled(bool loopEnabled);  
+  /// Show or hide playback performance statistics of the active browser node
+  void setPlaybackStatisticsVisible(bool visible);
 
   void updateChart();
 
@@ -62,6 +64,8 @@ protected slots:
   void onVcrPrevious();
   void onVcrNext();
   void onVcrLast();
+  /// Display the charting curves when background sampling is finished
+  void onChartingCurvesComputed();
   void synchronizedRootNodeCheckStateChanged(int aState);
 
   /// Respond to the scene events
@@ -72,9 +76,14 @@ protected slots:
   void onMRMLSceneEndBatchProcessEvent();
   void onMRMLSceneEndCloseEvent(); 
 
-protected:
+  /// Update the widget from the active browser node. Node modifications only schedule
+  /// an update (see scheduleWidgetUpdate), so that the widget is not updated at every playback step.
   void updateWidgetFromMRML();
 
+protected:
+  /// Request an update of the widget. Multiple requests within a short time result in a single update.
+  void scheduleWidgetUpdate();
+
   /// Refresh synchronized root nodes table from MRML
   void refreshSynchronizedRootNodesTable();
 
@@ -388,6 +388,10 @@ class SequenceLabelStatisticsLogic:
 
     for i in xrange(numOfDataNodes):
 
+      if not grayscaleNode.GetNthItemValid(i):
+        # skip dropped frames
+        continue
+
       # this->SetProgress((float)i/hi);
       # std::string event_message = "Label "; std::stringstream s; s << i; event_message.append(s.str());
       # this->InvokeEvent(vtkSequenceLabelStatisticsLogic::LabelStatsOuterLoop, (void*)event_message.c_str());
@@ -357,13 +357,20 @@ class SequenceRegistrationWidget:
     self.__chartTable.AddColumn(self.__mArray)
     self.__chartTable.SetNumberOfRows(numOfDataNodes)
     
+    # Displacements of all the items are computed at once from the matrices (without accessing each transform node)
+    matrices = vtk.vtkDoubleArray()
+    if not slicer.vtkMRMLLinearTransformSequenceNode.GetMatricesFromSequence(outputTransformSequenceNode, matrices):
+      return
+    # displacement of the origin is the translation component of the matrix
+    origin = vtk.vtkPoints()
+    origin.InsertNextPoint(0, 0, 0)
+    displacements = vtk.vtkDoubleArray()
+    slicer.vtkMRMLLinearTransformSequenceNode.ComputeDisplacements(matrices, origin, displacements)
+
     for i in range(numOfDataNodes):
       self.__chartTable.SetValue(i, 0, float(outputTransformSequenceNode.GetNthIndexValue(i)))
-      linearTransformNode = outputTransformSequenceNode.GetNthDataNode(i)
-      vtkMatrix = linearTransformNode.GetTransformToParent().GetMatrix()
-      self.__chartTable.SetValue(i, 1, vtkMatrix.GetElement(0,3))
-      self.__chartTable.SetValue(i, 2, vtkMatrix.GetElement(1,3))
-      self.__chartTable.SetValue(i, 3, vtkMatrix.GetElement(2,3))
+    for component in range(3):
+      self.__chartTable.GetColumn(component+1).CopyComponent(0, displacements, component)
       
     self.__chart.GetAxis(0).SetTitle('displacement(mm)')
     self.__chart.GetAxis(1).SetTitle('time(s)')
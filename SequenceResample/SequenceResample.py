@@ -273,6 +273,9 @@ class SequenceResampleLogic:
     numOfImageNodes = referenceSequenceNode.GetNumberOfDataNodes()
 
     for i in xrange(numOfImageNodes):
+      if not referenceSequenceNode.GetNthItemValid(i) or not transformSequenceNode.GetNthItemValid(i):
+        # skip dropped frames and invalid transforms
+        continue
       referenceNode = referenceSequenceNode.GetNthDataNode(i)
       referenceNodeIndexValue = referenceSequenceNode.GetNthIndexValue(i)
       dimensions = [1,1,1]
@@ -19,6 +19,8 @@
 #include "vtkSlicerSequencesLogic.h"
 
 // MRMLSequence includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLLinearTransformSequenceStorageNode.h"
 #include "vtkMRMLSequenceNode.h"
 #include "vtkMRMLSequenceStorageNode.h"
 
@@ -68,7 +70,9 @@ void vtkSlicerSequencesLogic::RegisterNodes()
     return;
   }
   this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceNode>::New());
+  this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLLinearTransformSequenceNode>::New());
   this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLSequenceStorageNode>::New());
+  this->GetMRMLScene()->RegisterNodeClass(vtkSmartPointer<vtkMRMLLinearTransformSequenceStorageNode>::New());
 }
 
 //---------------------------------------------------------------------------
@@ -0,0 +1,670 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLSequence includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLLinearTransformSequenceStorageNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+static const int NUMBER_OF_MATRIX_ELEMENTS = 16;
+
+//------------------------------------------------------------------------------
+vtkMRMLNodeNewMacro(vtkMRMLLinearTransformSequenceNode);
+
+//----------------------------------------------------------------------------
+vtkMRMLLinearTransformSequenceNode::vtkMRMLLinearTransformSequenceNode()
+{
+  this->Matrices=vtkSmartPointer<vtkDoubleArray>::New();
+  this->Matrices->SetNumberOfComponents(NUMBER_OF_MATRIX_ELEMENTS);
+  this->MatricesHead=0;
+  this->DataNode=vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+  this->DataNode->SetHideFromEditors(false);
+  this->DataNodeMatrix=vtkSmartPointer<vtkMatrix4x4>::New();
+  this->DataNodeItemNumber=-1;
+  this->DataNodeSequenceMTime=0;
+  this->DataNodeMTime=0;
+  this->IndexValueToItemNumberOffset=0;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLLinearTransformSequenceNode::~vtkMRMLLinearTransformSequenceNode()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::PrintSelf(ostream& os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os,indent);
+  os << indent << "NumberOfMatrices: " << this->MatrixIndexValues.size() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::WriteXML(ostream& of, int nIndent)
+{
+  Superclass::WriteXML(of, nIndent);
+
+  if (this->GetStorageNode()!=NULL)
+  {
+    // index values and matrices are written into the storage node's file
+    return;
+  }
+
+  vtkIndent indent(nIndent);
+
+  of << indent << " matrixIndexValues=\"";
+  for(std::deque< std::string >::iterator indexIt=this->MatrixIndexValues.begin(); indexIt!=this->MatrixIndexValues.end(); ++indexIt)
+  {
+    if (indexIt!=this->MatrixIndexValues.begin())
+    {
+      // not the first index, add a separator before adding values
+      of << ";";
+    }
+    of << (*indexIt);
+  }
+  of << "\"";
+
+  // Use full precision, as the matrices are only stored here
+  std::streamsize oldPrecision=of.precision(17);
+  of << indent << " matrices=\"";
+  vtkDoubleArray* matrices=this->GetMatrices();
+  vtkIdType numberOfValues=matrices->GetNumberOfTuples()*NUMBER_OF_MATRIX_ELEMENTS;
+  double* values=matrices->GetPointer(0);
+  for (vtkIdType i=0; i<numberOfValues; i++)
+  {
+    if (i>0)
+    {
+      of << " ";
+    }
+    of << values[i];
+  }
+  of << "\"";
+  of.precision(oldPrecision);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::ReadXMLAttributes(const char** atts)
+{
+  Superclass::ReadXMLAttributes(atts);
+
+  // Matrices may not be specified in the attributes (if they are read by the storage node),
+  // make sure that the existing matrices are consistent with the index values in this case, too
+  this->MakeMatricesContiguous();
+
+  // Read all MRML node attributes from two arrays of names and values
+  const char* attName;
+  const char* attValue;
+  while (*atts != NULL)
+  {
+    attName = *(atts++);
+    attValue = *(atts++);
+    if (!strcmp(attName, "matrixIndexValues"))
+    {
+      this->MatrixIndexValues.clear();
+      std::stringstream ss(attValue);
+      std::string indexValue;
+      while (std::getline(ss, indexValue, ';'))
+      {
+        this->MatrixIndexValues.push_back(indexValue);
+      }
+    }
+    else if (!strcmp(attName, "matrices"))
+    {
+      this->Matrices->Initialize();
+      this->Matrices->SetNumberOfComponents(NUMBER_OF_MATRIX_ELEMENTS);
+      this->MatricesHead=0;
+      // strtod is used instead of stringstream because there may be millions of values
+      const char* valueStart=attValue;
+      char* valueEnd=NULL;
+      double elements[NUMBER_OF_MATRIX_ELEMENTS]={0};
+      int elementIndex=0;
+      while (true)
+      {
+        double value=strtod(valueStart, &valueEnd);
+        if (valueEnd==valueStart)
+        {
+          // no more values
+          break;
+        }
+        valueStart=valueEnd;
+        elements[elementIndex++]=value;
+        if (elementIndex==NUMBER_OF_MATRIX_ELEMENTS)
+        {
+          this->Matrices->InsertNextTuple(elements);
+          elementIndex=0;
+        }
+      }
+      if (elementIndex!=0)
+      {
+        vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::ReadXMLAttributes: incomplete matrix found in node "<<(this->GetID()?this->GetID():"(unknown)"));
+      }
+    }
+  }
+
+  if (this->Matrices->GetNumberOfTuples()!=static_cast<vtkIdType>(this->MatrixIndexValues.size()))
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::ReadXMLAttributes: number of matrices ("<<this->Matrices->GetNumberOfTuples()
+      <<") does not match the number of index values ("<<this->MatrixIndexValues.size()<<")");
+    this->MatrixIndexValues.resize(this->Matrices->GetNumberOfTuples());
+  }
+  this->UpdateIndexValueToItemNumberMap();
+  this->DataNodeItemNumber=-1;
+}
+
+//----------------------------------------------------------------------------
+// Copy the node's attributes to this object.
+// Does NOT copy: ID, FilePrefix, Name, VolumeID
+void vtkMRMLLinearTransformSequenceNode::Copy(vtkMRMLNode *anode)
+{
+  Superclass::Copy(anode);
+  vtkMRMLLinearTransformSequenceNode* node=vtkMRMLLinearTransformSequenceNode::SafeDownCast(anode);
+  if (node==NULL)
+  {
+    vtkErrorMacro("Node copy failed: not a vtkMRMLLinearTransformSequenceNode");
+    return;
+  }
+  this->MatrixIndexValues=node->MatrixIndexValues;
+  this->Matrices->DeepCopy(node->GetMatrices());
+  this->MatricesHead=0;
+  this->IndexValueToItemNumber=node->IndexValueToItemNumber;
+  this->IndexValueToItemNumberOffset=node->IndexValueToItemNumberOffset;
+  this->DataNodeItemNumber=-1;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::UpdateIndexValueToItemNumberMap()
+{
+  this->IndexValueToItemNumber.clear();
+  this->IndexValueToItemNumberOffset=0;
+  int numberOfItems=this->MatrixIndexValues.size();
+  for (int i=0; i<numberOfItems; i++)
+  {
+    this->IndexValueToItemNumber[this->MatrixIndexValues[i]]=i;
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceNode::GetSequenceItemIndex(const char* indexValue)
+{
+  if (indexValue==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::GetSequenceItemIndex failed, invalid index value");
+    return -1;
+  }
+  std::map< std::string, int >::iterator itemIt=this->IndexValueToItemNumber.find(indexValue);
+  if (itemIt==this->IndexValueToItemNumber.end())
+  {
+    return -1;
+  }
+  return itemIt->second-this->IndexValueToItemNumberOffset;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::SetDataNodeAtValue(vtkMRMLNode* node, const char* indexValue)
+{
+  vtkMRMLTransformNode* transformNode=vtkMRMLTransformNode::SafeDownCast(node);
+  if (transformNode==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetDataNodeAtValue failed, invalid node");
+    return;
+  }
+  if (!transformNode->IsLinear())
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetDataNodeAtValue failed, only linear transforms can be stored");
+    return;
+  }
+  vtkSmartPointer<vtkMatrix4x4> matrix=vtkSmartPointer<vtkMatrix4x4>::New();
+  transformNode->GetMatrixTransformToParent(matrix);
+  this->SetMatrixAtValue(matrix, indexValue);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::SetMatrixAtValue(vtkMatrix4x4* matrix, const char* indexValue)
+{
+  if (matrix==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetMatrixAtValue failed, invalid matrix");
+    return;
+  }
+  // vtkMatrix4x4 stores the elements in row-major order
+  this->SetMatrixElementsAtValue(&(matrix->Element[0][0]), indexValue);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::SetMatrixElementsAtValue(const double elements[16], const char* indexValue)
+{
+  if (elements==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetMatrixElementsAtValue failed, invalid matrix");
+    return;
+  }
+  if (indexValue==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetMatrixElementsAtValue failed, invalid indexValue");
+    return;
+  }
+  int seqItemIndex=this->GetSequenceItemIndex(indexValue);
+  if (seqItemIndex<0)
+  {
+    // The sequence item doesn't exist yet
+    seqItemIndex=this->MatrixIndexValues.size();
+    if (seqItemIndex>=this->Matrices->GetNumberOfTuples())
+    {
+      // No free tuple is left in the circular buffer
+      if (this->MatricesHead==0)
+      {
+        // add a new tuple at the end of the array
+        this->Matrices->InsertNextTuple(elements);
+      }
+      else
+      {
+        // Unwrap the circular buffer and double its size, so that the matrices are only moved again
+        // when the number of items has doubled (InsertTuple keeps the existing values)
+        this->MakeMatricesContiguous();
+        this->Matrices->InsertTuple(2*seqItemIndex-1, elements);
+      }
+    }
+    this->MatrixIndexValues.push_back(indexValue);
+    this->IndexValueToItemNumber[indexValue]=seqItemIndex+this->IndexValueToItemNumberOffset;
+  }
+  this->Matrices->SetTuple(this->GetMatrixTupleIndex(seqItemIndex), elements);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLLinearTransformSequenceNode::GetNthMatrix(int itemNumber, vtkMatrix4x4* matrix)
+{
+  if (matrix==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::GetNthMatrix failed: invalid matrix");
+    return false;
+  }
+  double* elements=this->GetNthMatrixElements(itemNumber);
+  if (elements==NULL)
+  {
+    return false;
+  }
+  matrix->DeepCopy(elements);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double* vtkMRMLLinearTransformSequenceNode::GetNthMatrixElements(int itemNumber)
+{
+  if (itemNumber<0 || itemNumber>=static_cast<int>(this->MatrixIndexValues.size()))
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::GetNthMatrixElements failed: itemNumber "<<itemNumber<<" is out of range");
+    return NULL;
+  }
+  return this->Matrices->GetPointer(this->GetMatrixTupleIndex(itemNumber)*NUMBER_OF_MATRIX_ELEMENTS);
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkMRMLLinearTransformSequenceNode::GetMatrixTupleIndex(int itemNumber)
+{
+  vtkIdType tupleIndex=this->MatricesHead+itemNumber;
+  vtkIdType numberOfTuples=this->Matrices->GetNumberOfTuples();
+  return (tupleIndex<numberOfTuples) ? tupleIndex : tupleIndex-numberOfTuples;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::MakeMatricesContiguous()
+{
+  vtkIdType numberOfItems=this->MatrixIndexValues.size();
+  if (this->MatricesHead!=0)
+  {
+    double* matrixElements=this->Matrices->GetPointer(0);
+    std::rotate(matrixElements, matrixElements+this->MatricesHead*NUMBER_OF_MATRIX_ELEMENTS,
+      matrixElements+this->Matrices->GetNumberOfTuples()*NUMBER_OF_MATRIX_ELEMENTS);
+    this->MatricesHead=0;
+  }
+  if (this->Matrices->GetNumberOfTuples()!=numberOfItems)
+  {
+    // the array memory is not reallocated when the number of tuples is decreased
+    this->Matrices->SetNumberOfTuples(numberOfItems);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkDoubleArray* vtkMRMLLinearTransformSequenceNode::GetMatrices()
+{
+  this->MakeMatricesContiguous();
+  return this->Matrices;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLLinearTransformSequenceNode::SetMatricesAndIndexValues(vtkDoubleArray* matrices, const std::vector< std::string > &indexValues)
+{
+  if (matrices==NULL || matrices->GetNumberOfComponents()!=NUMBER_OF_MATRIX_ELEMENTS)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetMatricesAndIndexValues failed: invalid matrices");
+    return false;
+  }
+  if (matrices->GetNumberOfTuples()!=static_cast<vtkIdType>(indexValues.size()))
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::SetMatricesAndIndexValues failed: number of matrices ("<<matrices->GetNumberOfTuples()
+      <<") does not match the number of index values ("<<indexValues.size()<<")");
+    return false;
+  }
+  int wasModified=this->StartModify();
+  // RemoveAllDataNodes clears the validity mask, but only the matrices and index values are replaced here
+  std::vector<bool> invalidItemMask=this->InvalidItemMask;
+  if (invalidItemMask.size()>indexValues.size())
+  {
+    invalidItemMask.resize(indexValues.size());
+  }
+  this->RemoveAllDataNodes();
+  this->InvalidItemMask.swap(invalidItemMask);
+  this->MatrixIndexValues.assign(indexValues.begin(), indexValues.end());
+  this->Matrices->DeepCopy(matrices);
+  this->MatricesHead=0;
+  this->UpdateIndexValueToItemNumberMap();
+  this->Modified();
+  this->EndModify(wasModified);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLLinearTransformSequenceNode::GetMatricesFromSequence(vtkMRMLSequenceNode* sequenceNode, vtkDoubleArray* matrices)
+{
+  if (sequenceNode==NULL || matrices==NULL)
+  {
+    vtkGenericWarningMacro("vtkMRMLLinearTransformSequenceNode::GetMatricesFromSequence failed: invalid sequenceNode or matrices");
+    return false;
+  }
+  vtkMRMLLinearTransformSequenceNode* linearTransformSequenceNode = vtkMRMLLinearTransformSequenceNode::SafeDownCast(sequenceNode);
+  if (linearTransformSequenceNode!=NULL)
+  {
+    matrices->DeepCopy(linearTransformSequenceNode->GetMatrices());
+    return true;
+  }
+  int numberOfItems = sequenceNode->GetNumberOfDataNodes();
+  matrices->SetNumberOfComponents(NUMBER_OF_MATRIX_ELEMENTS);
+  matrices->SetNumberOfTuples(numberOfItems);
+  vtkSmartPointer<vtkMatrix4x4> matrix=vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    vtkMRMLTransformNode* transformNode = vtkMRMLTransformNode::SafeDownCast(sequenceNode->GetNthDataNode(itemNumber));
+    if (transformNode==NULL || !transformNode->IsLinear())
+    {
+      return false;
+    }
+    transformNode->GetMatrixTransformToParent(matrix);
+    // vtkMatrix4x4 stores the elements in row-major order
+    matrices->SetTuple(itemNumber, &(matrix->Element[0][0]));
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::ComputeDisplacements(vtkDoubleArray* matrices, vtkPoints* points, vtkDoubleArray* displacements)
+{
+  if (matrices==NULL || points==NULL || displacements==NULL || matrices->GetNumberOfComponents()!=NUMBER_OF_MATRIX_ELEMENTS)
+  {
+    vtkGenericWarningMacro("vtkMRMLLinearTransformSequenceNode::ComputeDisplacements failed: invalid matrices, points, or displacements");
+    return;
+  }
+  // Copy the points to a contiguous double array (points may be stored as float)
+  int numberOfPoints = points->GetNumberOfPoints();
+  std::vector<double> pointCoordinates(numberOfPoints*3);
+  for (int pointIndex=0; pointIndex<numberOfPoints; pointIndex++)
+  {
+    points->GetPoint(pointIndex, &(pointCoordinates[pointIndex*3]));
+  }
+  vtkIdType numberOfMatrices = matrices->GetNumberOfTuples();
+  displacements->SetNumberOfComponents(numberOfPoints*3);
+  displacements->SetNumberOfTuples(numberOfMatrices);
+  if (numberOfPoints==0)
+  {
+    return;
+  }
+  const double* m = matrices->GetPointer(0);
+  double* d = displacements->GetPointer(0);
+  for (vtkIdType matrixIndex=0; matrixIndex<numberOfMatrices; matrixIndex++, m+=NUMBER_OF_MATRIX_ELEMENTS)
+  {
+    // displacement = (R - I) * p + t, the last row of the matrix is ignored (affine transform)
+    for (int pointIndex=0; pointIndex<numberOfPoints; pointIndex++, d+=3)
+    {
+      const double* p = &(pointCoordinates[pointIndex*3]);
+      d[0] = (m[0]-1.0)*p[0] + m[1]*p[1] + m[2]*p[2] + m[3];
+      d[1] = m[4]*p[0] + (m[5]-1.0)*p[1] + m[6]*p[2] + m[7];
+      d[2] = m[8]*p[0] + m[9]*p[1] + (m[10]-1.0)*p[2] + m[11];
+    }
+  }
+  displacements->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::RemoveDataNodeAtValue(const char* indexValue)
+{
+  if (indexValue==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::RemoveDataNodeAtValue failed, invalid indexValue");
+    return;
+  }
+  int seqItemIndex=this->GetSequenceItemIndex(indexValue);
+  if (seqItemIndex<0)
+  {
+    vtkWarningMacro("vtkMRMLLinearTransformSequenceNode::RemoveDataNodeAtValue: node was not found at index value "<<indexValue);
+    return;
+  }
+  this->MakeMatricesContiguous();
+  this->MatrixIndexValues.erase(this->MatrixIndexValues.begin()+seqItemIndex);
+  this->Matrices->RemoveTuple(seqItemIndex);
+  this->RemoveNthItemValidity(seqItemIndex);
+  // item numbers of all the subsequent items changed
+  this->UpdateIndexValueToItemNumberMap();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::RemoveFirstDataNodes(int numberOfItems)
+{
+  int numberOfAllItems=this->MatrixIndexValues.size();
+  if (numberOfItems>numberOfAllItems)
+  {
+    numberOfItems=numberOfAllItems;
+  }
+  if (numberOfItems<=0)
+  {
+    return;
+  }
+  for (int i=0; i<numberOfItems; i++)
+  {
+    this->IndexValueToItemNumber.erase(this->MatrixIndexValues[i]);
+  }
+  this->MatrixIndexValues.erase(this->MatrixIndexValues.begin(), this->MatrixIndexValues.begin()+numberOfItems);
+  // The matrices are not moved, just the head of the circular buffer. Tuples of the removed items
+  // are reused when new items are added, so appending new items later does not allocate memory either.
+  if (this->MatrixIndexValues.empty())
+  {
+    this->MatricesHead=0;
+  }
+  else
+  {
+    this->MatricesHead=this->GetMatrixTupleIndex(numberOfItems);
+  }
+  this->RemoveFirstItemsValidity(numberOfItems);
+  this->IndexValueToItemNumberOffset+=numberOfItems;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::AppendDataNodeAtValue(vtkMRMLNode* node, const char* indexValue, bool reuseFirstItem)
+{
+  // removal and addition of the item is reported in a single modified event
+  int wasModified=this->StartModify();
+  if (reuseFirstItem)
+  {
+    // there is no data node to reuse, the matrix array keeps its memory allocated
+    this->RemoveFirstDataNodes(1);
+  }
+  this->SetDataNodeAtValue(node, indexValue);
+  this->EndModify(wasModified);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::RemoveAllDataNodes()
+{
+  int wasModified=this->StartModify();
+  Superclass::RemoveAllDataNodes();
+  this->MatrixIndexValues.clear();
+  this->Matrices->Initialize();
+  this->Matrices->SetNumberOfComponents(NUMBER_OF_MATRIX_ELEMENTS);
+  this->MatricesHead=0;
+  this->IndexValueToItemNumber.clear();
+  this->IndexValueToItemNumberOffset=0;
+  this->Modified();
+  this->EndModify(wasModified);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLNode* vtkMRMLLinearTransformSequenceNode::UpdateDataNode(int itemNumber)
+{
+  double* elements=this->GetNthMatrixElements(itemNumber);
+  if (elements==NULL)
+  {
+    return NULL;
+  }
+  if (itemNumber==this->DataNodeItemNumber && this->GetMTime()==this->DataNodeSequenceMTime
+    && this->DataNode->GetMTime()==this->DataNodeMTime)
+  {
+    // the data node already contains this item
+    return this->DataNode;
+  }
+  this->DataNodeMatrix->DeepCopy(elements);
+  // only set the name if it changed, to not invoke a modified event at each update
+  const char* name=this->GetName();
+  const char* dataNodeName=this->DataNode->GetName();
+  if (name!=dataNodeName && (name==NULL || dataNodeName==NULL || strcmp(name, dataNodeName)!=0))
+  {
+    this->DataNode->SetName(name);
+  }
+  this->DataNode->SetMatrixTransformToParent(this->DataNodeMatrix);
+  this->DataNodeItemNumber=itemNumber;
+  this->DataNodeSequenceMTime=this->GetMTime();
+  this->DataNodeMTime=this->DataNode->GetMTime();
+  return this->DataNode;
+}
+
+//---------------------------------------------------------------------------
+vtkMRMLNode* vtkMRMLLinearTransformSequenceNode::GetDataNodeAtValue(const char* indexValue)
+{
+  if (indexValue==NULL)
+  {
+    vtkErrorMacro("GetDataNodesAtValue failed, invalid index value");
+    return NULL;
+  }
+  int seqItemIndex=this->GetSequenceItemIndex(indexValue);
+  if (seqItemIndex<0)
+  {
+    // sequence item is not found
+    return NULL;
+  }
+  return this->UpdateDataNode(seqItemIndex);
+}
+
+//---------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::GetDisplayNodesAtValue(std::vector< vtkMRMLDisplayNode* > &displayNodes, const char* vtkNotUsed(indexValue))
+{
+  displayNodes.clear();
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLNode* vtkMRMLLinearTransformSequenceNode::GetNthDataNode(int itemNumber)
+{
+  return this->UpdateDataNode(itemNumber);
+}
+
+//---------------------------------------------------------------------------
+std::string vtkMRMLLinearTransformSequenceNode::GetNthIndexValue(int itemNumber)
+{
+  if (itemNumber<0 || itemNumber>=static_cast<int>(this->MatrixIndexValues.size()))
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::GetNthIndexValue failed, invalid itemNumber value: "<<itemNumber);
+    return "";
+  }
+  return this->MatrixIndexValues[itemNumber];
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceNode::UpdateIndexValue(const char* oldIndexValue, const char* newIndexValue)
+{
+  if (oldIndexValue==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::UpdateIndexValue failed, invalid oldIndexValue");
+    return;
+  }
+  if (newIndexValue==NULL)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::UpdateIndexValue failed, invalid newIndexValue");
+    return;
+  }
+  if (strcmp(oldIndexValue,newIndexValue)==0)
+  {
+    // no change
+    return;
+  }
+  int seqItemIndex=this->GetSequenceItemIndex(oldIndexValue);
+  if (seqItemIndex<0)
+  {
+    vtkErrorMacro("vtkMRMLLinearTransformSequenceNode::UpdateIndexValue failed, no data node found with index value "<<oldIndexValue);
+    return;
+  }
+  this->MatrixIndexValues[seqItemIndex]=newIndexValue;
+  this->IndexValueToItemNumber.erase(oldIndexValue);
+  this->IndexValueToItemNumber[newIndexValue]=seqItemIndex+this->IndexValueToItemNumberOffset;
+  this->Modified();
+}
+
+//-----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceNode::GetNumberOfDataNodes()
+{
+  return this->MatrixIndexValues.size();
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkMRMLLinearTransformSequenceNode::GetDataNodeClassName()
+{
+  return this->DataNode->GetClassName();
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkMRMLLinearTransformSequenceNode::GetDataNodeTagName()
+{
+  return this->DataNode->GetNodeTagName();
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLStorageNode* vtkMRMLLinearTransformSequenceNode::CreateDefaultStorageNode()
+{
+  return vtkMRMLLinearTransformSequenceStorageNode::New();
+}
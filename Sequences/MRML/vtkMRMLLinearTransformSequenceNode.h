@@ -0,0 +1,209 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkMRMLLinearTransformSequenceNode_h
+#define __vtkMRMLLinearTransformSequenceNode_h
+
+// MRML includes
+#include <vtkMRML.h>
+#include "vtkMRMLSequenceNode.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// std includes
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vtkSlicerSequencesModuleMRMLExport.h"
+
+class vtkDoubleArray;
+class vtkMatrix4x4;
+class vtkMRMLLinearTransformNode;
+class vtkPoints;
+
+/// \brief MRML node for representing a sequence of linear transforms in a compact form
+///
+/// Instead of storing a separate transform node for each item (as vtkMRMLSequenceNode does),
+/// all the transforms are stored in a single N x 16 double array (row-major 4x4 matrices)
+/// and a list of index values. This is typically used for tracker data, where a recording
+/// may contain hundreds of thousands of transforms.
+///
+/// Data node accessors (GetDataNodeAtValue, GetNthDataNode) return a single internal
+/// transform node that is updated with the requested matrix. The returned node is only valid
+/// until the next call of any of these methods, therefore it must not be stored.
+/// Items have no data node of their own: the returned node is always named after the sequence,
+/// and changes made to it are not stored in the sequence (use SetMatrixAtValue to modify an item).
+///
+/// Matrices are written into a binary MetaImage file by vtkMRMLLinearTransformSequenceStorageNode.
+/// If the node has no storage node then the matrices are written into the node's XML description.
+
+class VTK_SLICER_SEQUENCES_MODULE_MRML_EXPORT vtkMRMLLinearTransformSequenceNode : public vtkMRMLSequenceNode
+{
+public:
+  static vtkMRMLLinearTransformSequenceNode *New();
+  vtkTypeMacro(vtkMRMLLinearTransformSequenceNode,vtkMRMLSequenceNode);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Create instance of a linear transform sequence node
+  virtual vtkMRMLNode* CreateNodeInstance();
+
+  /// Set node attributes from name/value pairs
+  virtual void ReadXMLAttributes( const char** atts);
+
+  /// Write this node's information to a MRML file in XML format.
+  virtual void WriteXML(ostream& of, int indent);
+
+  /// Copy the node's attributes to this object
+  virtual void Copy(vtkMRMLNode *node);
+
+  /// Get unique node XML tag name (like Volume, Model)
+  virtual const char* GetNodeTagName() {return "LinearTransformSequence";};
+
+  /// Store the matrix of the provided linear transform node at the specified index value
+  virtual void SetDataNodeAtValue(vtkMRMLNode* node, const char* indexValue);
+
+  /// Store a matrix at the specified index value. If an item already exists at that index value then it is overwritten.
+  void SetMatrixAtValue(vtkMatrix4x4* matrix, const char* indexValue);
+
+  /// Store a matrix (16 values, row-major order) at the specified index value.
+  /// If an item already exists at that index value then it is overwritten.
+  void SetMatrixElementsAtValue(const double elements[16], const char* indexValue);
+
+  /// Get the matrix of the n-th item. Returns false if the item number is out of range.
+  bool GetNthMatrix(int itemNumber, vtkMatrix4x4* matrix);
+
+  /// Get the matrix elements (16 values, row-major order) of the n-th item.
+  /// The returned pointer is only valid until the sequence is modified.
+  double* GetNthMatrixElements(int itemNumber);
+
+  /// Get all the matrices in a N x 16 array (row-major 4x4 matrices).
+  /// If the first items have been removed since the last call then the matrices are moved to make
+  /// the array contiguous, therefore this method should not be called at each item addition.
+  vtkDoubleArray* GetMatrices();
+
+  /// Replace all the items. The number of index values must match the number of tuples in the matrices array.
+  /// Validity of the items is kept (e.g., validity that is read from the scene before the storage node reads the matrices).
+  /// Returns false if the inputs are invalid.
+  bool SetMatricesAndIndexValues(vtkDoubleArray* matrices, const std::vector< std::string > &indexValues);
+
+  /// Copy the matrices of all the items of a sequence of linear transforms into a N x 16 array (row-major 4x4 matrices).
+  /// Matrices of a linear transform sequence node are copied without accessing any data nodes.
+  /// Returns false if any of the items is not a linear transform.
+  static bool GetMatricesFromSequence(vtkMRMLSequenceNode* sequenceNode, vtkDoubleArray* matrices);
+
+  /// Compute the displacement (transformed position minus original position) of points for each matrix of a N x 16 array.
+  /// The output has one tuple for each matrix and 3 components for each point (x, y, z displacement of the first point,
+  /// then of the second point, ...). All matrices are processed in a single pass over the contiguous matrix array.
+  static void ComputeDisplacements(vtkDoubleArray* matrices, vtkPoints* points, vtkDoubleArray* displacements);
+
+  virtual void RemoveDataNodeAtValue(const char* indexValue);
+
+  virtual void RemoveAllDataNodes();
+
+  /// Remove the first matrices. Neither the matrices nor the lookup map are moved or rebuilt
+  /// (the matrix array is used as a circular buffer), so this is fast even for long sequences.
+  virtual void RemoveFirstDataNodes(int numberOfItems);
+
+  /// Append the matrix of the provided linear transform node (optionally removing the first item)
+  virtual void AppendDataNodeAtValue(vtkMRMLNode* node, const char* indexValue, bool reuseFirstItem);
+
+  /// Get the transform node filled with the matrix corresponding to the specified index value
+  virtual vtkMRMLNode* GetDataNodeAtValue(const char* indexValue);
+
+  /// Linear transforms in this sequence have no display nodes
+  virtual void GetDisplayNodesAtValue(std::vector< vtkMRMLDisplayNode* > &displayNodes, const char* indexValue);
+
+  /// Get the transform node filled with the matrix of the n-th item
+  virtual vtkMRMLNode* GetNthDataNode(int itemNumber);
+
+  virtual std::string GetNthIndexValue(int itemNumber);
+
+  virtual void UpdateIndexValue(const char* oldIndexValue, const char* newIndexValue);
+
+  virtual int GetNumberOfDataNodes();
+
+  /// Returns vtkMRMLLinearTransformNode, even if the sequence is empty
+  virtual std::string GetDataNodeClassName();
+
+  /// Returns LinearTransform, even if the sequence is empty
+  virtual std::string GetDataNodeTagName();
+
+  /// Create a vtkMRMLLinearTransformSequenceStorageNode
+  virtual vtkMRMLStorageNode* CreateDefaultStorageNode();
+
+protected:
+  vtkMRMLLinearTransformSequenceNode();
+  ~vtkMRMLLinearTransformSequenceNode();
+  vtkMRMLLinearTransformSequenceNode(const vtkMRMLLinearTransformSequenceNode&);
+  void operator=(const vtkMRMLLinearTransformSequenceNode&);
+
+  /// Returns the item number corresponding to the index value (-1 if not found)
+  virtual int GetSequenceItemIndex(const char* indexValue);
+
+  /// Rebuild IndexValueToItemNumber from the MatrixIndexValues list
+  void UpdateIndexValueToItemNumberMap();
+
+  /// Fill the DataNode with the matrix of the n-th item
+  vtkMRMLNode* UpdateDataNode(int itemNumber);
+
+  /// Returns the tuple index in Matrices where the matrix of the n-th item is stored
+  vtkIdType GetMatrixTupleIndex(int itemNumber);
+
+  /// Move the matrices in memory so that the first item is stored in the first tuple and
+  /// the number of tuples is the same as the number of items
+  void MakeMatricesContiguous();
+
+protected:
+
+  /// Index values of the items
+  std::deque< std::string > MatrixIndexValues;
+
+  /// Transform matrices, one 16-component tuple for each item. The array is used as a circular buffer:
+  /// the first item is stored in tuple MatricesHead, and tuples of removed items are reused for new items.
+  /// The number of tuples may be larger than the number of items.
+  vtkSmartPointer<vtkDoubleArray> Matrices;
+
+  /// Tuple index of the first item in Matrices
+  vtkIdType MatricesHead;
+
+  /// Allows finding items by index value without iterating through the whole list
+  std::map< std::string, int > IndexValueToItemNumber;
+
+  /// Item numbers stored in IndexValueToItemNumber are larger than the actual item numbers by this value.
+  /// It is increased when the first items are removed, so that the map does not have to be rebuilt.
+  int IndexValueToItemNumberOffset;
+
+  /// Transform node that is returned by the data node accessors
+  vtkSmartPointer<vtkMRMLLinearTransformNode> DataNode;
+
+  /// Matrix that is used for updating DataNode (kept to avoid memory allocation at each update)
+  vtkSmartPointer<vtkMatrix4x4> DataNodeMatrix;
+
+  /// Item number that DataNode was last filled with (-1 if not filled yet)
+  int DataNodeItemNumber;
+
+  /// Modification time of this node and of DataNode when DataNode was last filled.
+  /// DataNode is not filled again (and so its modification time is kept) if the same item is requested and
+  /// neither node has changed since then, which allows users of the data node to detect that it is unchanged.
+  unsigned long DataNodeSequenceMTime;
+  unsigned long DataNodeMTime;
+};
+
+#endif
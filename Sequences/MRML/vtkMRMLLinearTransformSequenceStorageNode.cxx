@@ -0,0 +1,258 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLSequence includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLLinearTransformSequenceStorageNode.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkDoubleArray.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkStringArray.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+static const int NUMBER_OF_MATRIX_ELEMENTS = 16;
+
+static const char* FIELD_INDEX_VALUES = "IndexValues";
+static const char* FIELD_ELEMENT_DATA_FILE = "ElementDataFile";
+
+//----------------------------------------------------------------------------
+vtkMRMLNodeNewMacro(vtkMRMLLinearTransformSequenceStorageNode);
+
+//----------------------------------------------------------------------------
+vtkMRMLLinearTransformSequenceStorageNode::vtkMRMLLinearTransformSequenceStorageNode()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLLinearTransformSequenceStorageNode::~vtkMRMLLinearTransformSequenceStorageNode()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceStorageNode::PrintSelf(ostream& os, vtkIndent indent)
+{
+  vtkMRMLStorageNode::PrintSelf(os,indent);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLLinearTransformSequenceStorageNode::CanReadInReferenceNode(vtkMRMLNode *refNode)
+{
+  return refNode->IsA("vtkMRMLLinearTransformSequenceNode");
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
+{
+  vtkMRMLLinearTransformSequenceNode* sequenceNode = vtkMRMLLinearTransformSequenceNode::SafeDownCast(refNode);
+  if (sequenceNode == NULL)
+  {
+    vtkErrorMacro("ReadDataInternal: invalid linear transform sequence node");
+    return 0;
+  }
+
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName == std::string(""))
+  {
+    vtkErrorMacro("ReadDataInternal: File name not specified");
+    return 0;
+  }
+  std::ifstream file(fullName.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+  {
+    vtkErrorMacro("ReadDataInternal: linear transform sequence file '" << fullName.c_str() << "' not found.");
+    return 0;
+  }
+
+  // Read the header, which ends with the ElementDataFile field
+  int numberOfMatrices = -1;
+  bool binaryData = false;
+  bool byteOrderMSB = false;
+  std::string elementType;
+  std::string elementDataFile;
+  std::vector< std::string > indexValues;
+  std::string line;
+  while (elementDataFile.empty() && std::getline(file, line))
+  {
+    size_t equalSignPos = line.find('=');
+    if (equalSignPos == std::string::npos)
+    {
+      continue;
+    }
+    std::string name = vtksys::SystemTools::TrimWhitespace(line.substr(0, equalSignPos));
+    std::string value = vtksys::SystemTools::TrimWhitespace(line.substr(equalSignPos+1));
+    if (name == "DimSize")
+    {
+      int numberOfComponents = 0;
+      std::stringstream ss(value);
+      ss >> numberOfComponents >> numberOfMatrices;
+      if (numberOfComponents != NUMBER_OF_MATRIX_ELEMENTS)
+      {
+        vtkErrorMacro("ReadDataInternal: invalid image size in file '" << fullName.c_str() << "', expected "
+          << NUMBER_OF_MATRIX_ELEMENTS << " columns");
+        return 0;
+      }
+    }
+    else if (name == "BinaryData")
+    {
+      binaryData = (value == "True");
+    }
+    else if (name == "BinaryDataByteOrderMSB" || name == "ElementByteOrderMSB")
+    {
+      byteOrderMSB = (value == "True");
+    }
+    else if (name == "ElementType")
+    {
+      elementType = value;
+    }
+    else if (name == FIELD_INDEX_VALUES)
+    {
+      std::stringstream ss(value);
+      std::string indexValue;
+      while (std::getline(ss, indexValue, ';'))
+      {
+        indexValues.push_back(indexValue);
+      }
+    }
+    else if (name == FIELD_ELEMENT_DATA_FILE)
+    {
+      elementDataFile = value;
+    }
+  }
+  if (elementDataFile != "LOCAL" || !binaryData || elementType != "MET_DOUBLE" || numberOfMatrices < 0)
+  {
+    vtkErrorMacro("ReadDataInternal: unsupported linear transform sequence file '" << fullName.c_str()
+      << "', only local binary MET_DOUBLE data is supported");
+    return 0;
+  }
+  if (static_cast<int>(indexValues.size()) != numberOfMatrices)
+  {
+    vtkErrorMacro("ReadDataInternal: number of matrices (" << numberOfMatrices << ") does not match the number of index values ("
+      << indexValues.size() << ") in file '" << fullName.c_str() << "'");
+    return 0;
+  }
+
+  vtkSmartPointer<vtkDoubleArray> matrices = vtkSmartPointer<vtkDoubleArray>::New();
+  matrices->SetNumberOfComponents(NUMBER_OF_MATRIX_ELEMENTS);
+  matrices->SetNumberOfTuples(numberOfMatrices);
+  if (numberOfMatrices > 0)
+  {
+    vtkIdType numberOfValues = static_cast<vtkIdType>(numberOfMatrices)*NUMBER_OF_MATRIX_ELEMENTS;
+    file.read(reinterpret_cast<char*>(matrices->GetPointer(0)), numberOfValues*sizeof(double));
+    if (file.gcount() != static_cast<std::streamsize>(numberOfValues*sizeof(double)))
+    {
+      vtkErrorMacro("ReadDataInternal: unexpected end of file in '" << fullName.c_str() << "'");
+      return 0;
+    }
+#ifdef VTK_WORDS_BIGENDIAN
+    bool hostByteOrderMSB = true;
+#else
+    bool hostByteOrderMSB = false;
+#endif
+    if (byteOrderMSB != hostByteOrderMSB)
+    {
+      vtkByteSwap::SwapVoidRange(matrices->GetPointer(0), numberOfValues, sizeof(double));
+    }
+  }
+
+  return sequenceNode->SetMatricesAndIndexValues(matrices, indexValues) ? 1 : 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
+{
+  vtkMRMLLinearTransformSequenceNode* sequenceNode = vtkMRMLLinearTransformSequenceNode::SafeDownCast(refNode);
+  if (sequenceNode == NULL)
+  {
+    vtkErrorMacro("WriteDataInternal: invalid linear transform sequence node");
+    return 0;
+  }
+
+  std::string fullName = this->GetFullNameFromFileName();
+  if (fullName == std::string(""))
+  {
+    vtkErrorMacro("WriteDataInternal: File name not specified");
+    return 0;
+  }
+  std::ofstream file(fullName.c_str(), std::ios::out | std::ios::binary);
+  if (!file.is_open())
+  {
+    vtkErrorMacro("WriteDataInternal: failed to open file '" << fullName.c_str() << "' for writing");
+    return 0;
+  }
+
+  int numberOfMatrices = sequenceNode->GetNumberOfDataNodes();
+  file << "ObjectType = Image\n";
+  file << "NDims = 2\n";
+  file << "BinaryData = True\n";
+#ifdef VTK_WORDS_BIGENDIAN
+  file << "BinaryDataByteOrderMSB = True\n";
+#else
+  file << "BinaryDataByteOrderMSB = False\n";
+#endif
+  file << "DimSize = " << NUMBER_OF_MATRIX_ELEMENTS << " " << numberOfMatrices << "\n";
+  file << "ElementType = MET_DOUBLE\n";
+  file << FIELD_INDEX_VALUES << " = ";
+  for (int itemNumber = 0; itemNumber < numberOfMatrices; itemNumber++)
+  {
+    if (itemNumber > 0)
+    {
+      file << ";";
+    }
+    file << sequenceNode->GetNthIndexValue(itemNumber);
+  }
+  file << "\n";
+  file << FIELD_ELEMENT_DATA_FILE << " = LOCAL\n";
+
+  vtkDoubleArray* matrices = sequenceNode->GetMatrices();
+  if (numberOfMatrices > 0)
+  {
+    vtkIdType numberOfValues = static_cast<vtkIdType>(numberOfMatrices)*NUMBER_OF_MATRIX_ELEMENTS;
+    file.write(reinterpret_cast<const char*>(matrices->GetPointer(0)), numberOfValues*sizeof(double));
+  }
+  if (!file.good())
+  {
+    vtkErrorMacro("WriteDataInternal: failed to write file '" << fullName.c_str() << "'");
+    return 0;
+  }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceStorageNode::InitializeSupportedReadFileTypes()
+{
+  this->SupportedReadFileTypes->InsertNextValue("Linear transform sequence (.mha)");
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLLinearTransformSequenceStorageNode::InitializeSupportedWriteFileTypes()
+{
+  this->SupportedWriteFileTypes->InsertNextValue("Linear transform sequence (.mha)");
+}
+
+//----------------------------------------------------------------------------
+const char* vtkMRMLLinearTransformSequenceStorageNode::GetDefaultWriteFileExtension()
+{
+  return "mha";
+}
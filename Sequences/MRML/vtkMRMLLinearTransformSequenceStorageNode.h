@@ -0,0 +1,66 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkMRMLLinearTransformSequenceStorageNode_h
+#define __vtkMRMLLinearTransformSequenceStorageNode_h
+
+#include "vtkSlicerSequencesModuleMRMLExport.h"
+#include "vtkMRMLStorageNode.h"
+
+/// \brief MRML node for storing a linear transform sequence on disk.
+///
+/// Matrices are written into a MetaImage file as a 16 x N binary double image
+/// (one row-major 4x4 matrix in each image row). Index values are stored in the
+/// IndexValues header field, separated by semicolons.
+class VTK_SLICER_SEQUENCES_MODULE_MRML_EXPORT vtkMRMLLinearTransformSequenceStorageNode : public vtkMRMLStorageNode
+{
+public:
+  static vtkMRMLLinearTransformSequenceStorageNode *New();
+  vtkTypeMacro(vtkMRMLLinearTransformSequenceStorageNode,vtkMRMLStorageNode);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  virtual vtkMRMLNode* CreateNodeInstance();
+
+  /// Get node XML tag name (like Storage, Sequence)
+  virtual const char* GetNodeTagName()  {return "LinearTransformSequenceStorage";};
+
+  /// Return a default file extension for writing
+  virtual const char* GetDefaultWriteFileExtension();
+
+  /// Return true if the reference node can be read in
+  virtual bool CanReadInReferenceNode(vtkMRMLNode *refNode);
+
+protected:
+  vtkMRMLLinearTransformSequenceStorageNode();
+  ~vtkMRMLLinearTransformSequenceStorageNode();
+  vtkMRMLLinearTransformSequenceStorageNode(const vtkMRMLLinearTransformSequenceStorageNode&);
+  void operator=(const vtkMRMLLinearTransformSequenceStorageNode&);
+
+  /// Initialize all the supported read file types
+  virtual void InitializeSupportedReadFileTypes();
+
+  /// Initialize all the supported write file types
+  virtual void InitializeSupportedWriteFileTypes();
+
+  /// Read data and set it in the referenced node
+  virtual int ReadDataInternal(vtkMRMLNode *refNode);
+
+  /// Write data from a referenced node
+  virtual int WriteDataInternal(vtkMRMLNode *refNode);
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLSequence includes
+#include "vtkMRMLSequenceImageBufferPool.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationIntegerKey.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSimpleCriticalSection.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <map>
+#include <vector>
+
+static const double DEFAULT_MAXIMUM_POOL_SIZE_MB = 512.0;
+static const double BYTES_PER_MB = 1024.0*1024.0;
+
+//----------------------------------------------------------------------------
+class vtkMRMLSequenceImageBufferPool::vtkInternal
+{
+public:
+  // Buffers can be reused for any image with the same scalar type, number of components, and number of voxels
+  struct BufferKeyType
+  {
+    int ScalarType;
+    int NumberOfComponents;
+    vtkIdType NumberOfTuples;
+    bool operator<(const BufferKeyType& other) const
+    {
+      if (this->ScalarType != other.ScalarType)
+      {
+        return this->ScalarType < other.ScalarType;
+      }
+      if (this->NumberOfComponents != other.NumberOfComponents)
+      {
+        return this->NumberOfComponents < other.NumberOfComponents;
+      }
+      return this->NumberOfTuples < other.NumberOfTuples;
+    }
+  };
+
+  static double GetBufferSizeBytes(vtkDataArray* buffer)
+  {
+    return static_cast<double>(buffer->GetNumberOfTuples()) * buffer->GetNumberOfComponents() * buffer->GetDataTypeSize();
+  }
+
+  vtkSimpleCriticalSection Lock;
+  std::map< BufferKeyType, std::vector< vtkSmartPointer<vtkDataArray> > > Buffers;
+  double PoolSizeBytes;
+  double MaximumPoolSizeBytes;
+  int NumberOfReusedBuffers;
+  int NumberOfAllocatedBuffers;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkMRMLSequenceImageBufferPool);
+vtkInformationKeyMacro(vtkMRMLSequenceImageBufferPool, POOLED_BUFFER, Integer);
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceImageBufferPool::vtkMRMLSequenceImageBufferPool()
+{
+  this->Internal = new vtkInternal;
+  this->Internal->PoolSizeBytes = 0;
+  this->Internal->MaximumPoolSizeBytes = DEFAULT_MAXIMUM_POOL_SIZE_MB*BYTES_PER_MB;
+  this->Internal->NumberOfReusedBuffers = 0;
+  this->Internal->NumberOfAllocatedBuffers = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceImageBufferPool::~vtkMRMLSequenceImageBufferPool()
+{
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceImageBufferPool* vtkMRMLSequenceImageBufferPool::GetInstance()
+{
+  // Created at first use, released at application exit
+  static vtkSmartPointer<vtkMRMLSequenceImageBufferPool> instance = vtkSmartPointer<vtkMRMLSequenceImageBufferPool>::New();
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceImageBufferPool::PrintSelf(ostream& os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os,indent);
+  os << indent << "PoolSizeMB: " << this->GetPoolSizeMB() << "\n";
+  os << indent << "MaximumPoolSizeMB: " << this->GetMaximumPoolSizeMB() << "\n";
+  os << indent << "NumberOfReusedBuffers: " << this->GetNumberOfReusedBuffers() << "\n";
+  os << indent << "NumberOfAllocatedBuffers: " << this->GetNumberOfAllocatedBuffers() << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkMRMLSequenceImageBufferPool::NewImage(const int dimensions[3], int scalarType, int numberOfScalarComponents)
+{
+  vtkInternal::BufferKeyType key;
+  key.ScalarType = scalarType;
+  key.NumberOfComponents = numberOfScalarComponents;
+  key.NumberOfTuples = static_cast<vtkIdType>(dimensions[0]) * dimensions[1] * dimensions[2];
+
+  vtkSmartPointer<vtkDataArray> scalars;
+  this->Internal->Lock.Lock();
+  std::map< vtkInternal::BufferKeyType, std::vector< vtkSmartPointer<vtkDataArray> > >::iterator buffersIt = this->Internal->Buffers.find(key);
+  if (buffersIt != this->Internal->Buffers.end() && !buffersIt->second.empty())
+  {
+    scalars = buffersIt->second.back();
+    buffersIt->second.pop_back();
+    this->Internal->PoolSizeBytes -= vtkInternal::GetBufferSizeBytes(scalars);
+    this->Internal->NumberOfReusedBuffers++;
+  }
+  else
+  {
+    this->Internal->NumberOfAllocatedBuffers++;
+  }
+  this->Internal->Lock.Unlock();
+
+  if (scalars == NULL)
+  {
+    scalars = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(scalarType));
+    scalars->SetNumberOfComponents(numberOfScalarComponents);
+    scalars->SetNumberOfTuples(key.NumberOfTuples);
+    scalars->GetInformation()->Set(vtkMRMLSequenceImageBufferPool::POOLED_BUFFER(), 1);
+  }
+
+  vtkImageData* image = vtkImageData::New();
+  image->SetDimensions(dimensions[0], dimensions[1], dimensions[2]);
+  image->GetPointData()->SetScalars(scalars);
+#if (VTK_MAJOR_VERSION <= 5)
+  image->SetScalarType(scalarType);
+  image->SetNumberOfScalarComponents(numberOfScalarComponents);
+#endif
+  return image;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceImageBufferPool::RecycleImage(vtkImageData* image)
+{
+  vtkDataArray* imageScalars = (image != NULL) ? image->GetPointData()->GetScalars() : NULL;
+  if (imageScalars == NULL || !imageScalars->GetInformation()->Has(vtkMRMLSequenceImageBufferPool::POOLED_BUFFER()))
+  {
+    return false;
+  }
+  // Only the scalars are checked, as the image object itself may still be referenced by pipeline objects
+  // that are not used anymore (such as the trivial producer of a removed volume node)
+  if (imageScalars->GetReferenceCount() != 1)
+  {
+    // the array is shared with another data object (for example, the image of a virtual output node)
+    return false;
+  }
+  vtkSmartPointer<vtkDataArray> scalars = imageScalars;
+
+  vtkInternal::BufferKeyType key;
+  key.ScalarType = scalars->GetDataType();
+  key.NumberOfComponents = scalars->GetNumberOfComponents();
+  key.NumberOfTuples = scalars->GetNumberOfTuples();
+  double bufferSizeBytes = vtkInternal::GetBufferSizeBytes(scalars);
+  bool recycled = false;
+  this->Internal->Lock.Lock();
+  if (this->Internal->PoolSizeBytes + bufferSizeBytes <= this->Internal->MaximumPoolSizeBytes)
+  {
+    // after this only the pool refers to the array
+    image->Initialize();
+    this->Internal->Buffers[key].push_back(scalars);
+    this->Internal->PoolSizeBytes += bufferSizeBytes;
+    recycled = true;
+  }
+  this->Internal->Lock.Unlock();
+  return recycled;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceImageBufferPool::SetMaximumPoolSizeMB(double sizeMB)
+{
+  this->Internal->Lock.Lock();
+  this->Internal->MaximumPoolSizeBytes = sizeMB*BYTES_PER_MB;
+  this->Internal->Lock.Unlock();
+  if (this->GetPoolSizeMB() > sizeMB)
+  {
+    this->ReleaseBuffers();
+  }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLSequenceImageBufferPool::GetMaximumPoolSizeMB()
+{
+  this->Internal->Lock.Lock();
+  double maximumPoolSizeMB = this->Internal->MaximumPoolSizeBytes/BYTES_PER_MB;
+  this->Internal->Lock.Unlock();
+  return maximumPoolSizeMB;
+}
+
+//----------------------------------------------------------------------------
+double vtkMRMLSequenceImageBufferPool::GetPoolSizeMB()
+{
+  this->Internal->Lock.Lock();
+  double poolSizeMB = this->Internal->PoolSizeBytes/BYTES_PER_MB;
+  this->Internal->Lock.Unlock();
+  return poolSizeMB;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceImageBufferPool::ReleaseBuffers()
+{
+  this->Internal->Lock.Lock();
+  this->Internal->Buffers.clear();
+  this->Internal->PoolSizeBytes = 0;
+  this->Internal->Lock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceImageBufferPool::GetNumberOfReusedBuffers()
+{
+  this->Internal->Lock.Lock();
+  int numberOfReusedBuffers = this->Internal->NumberOfReusedBuffers;
+  this->Internal->Lock.Unlock();
+  return numberOfReusedBuffers;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceImageBufferPool::GetNumberOfAllocatedBuffers()
+{
+  this->Internal->Lock.Lock();
+  int numberOfAllocatedBuffers = this->Internal->NumberOfAllocatedBuffers;
+  this->Internal->Lock.Unlock();
+  return numberOfAllocatedBuffers;
+}
@@ -0,0 +1,90 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkMRMLSequenceImageBufferPool_h
+#define __vtkMRMLSequenceImageBufferPool_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerSequencesModuleMRMLExport.h"
+
+class vtkImageData;
+class vtkInformationIntegerKey;
+
+/// \brief Pool of pixel buffers for the images of sequence items
+///
+/// Importers and recorders create the images of sequence items using NewImage, which takes the pixel buffer
+/// (scalar array) from the pool if a buffer with the same scalar type, number of components and number of voxels
+/// is available. When items are removed from a sequence then the buffers of their images are returned to the pool
+/// (if they were allocated by the pool and no other image shares them).
+/// Images of sequence items must not be shared between nodes, only their scalars (e.g., by vtkImageData::ShallowCopy),
+/// otherwise the pool cannot detect that the buffer is still in use.
+/// This avoids repeated allocation and release of large memory blocks when frames are imported or recorded
+/// continuously (e.g., live recording with a limited buffer size).
+///
+/// All methods are thread-safe.
+
+class VTK_SLICER_SEQUENCES_MODULE_MRML_EXPORT vtkMRMLSequenceImageBufferPool : public vtkObject
+{
+public:
+  static vtkMRMLSequenceImageBufferPool *New();
+  vtkTypeMacro(vtkMRMLSequenceImageBufferPool,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Returns the pool that is shared by all the sequence nodes
+  static vtkMRMLSequenceImageBufferPool* GetInstance();
+
+  /// Create a new image with allocated (uninitialized) scalars. The caller owns the returned image
+  /// (it must be released by calling Delete).
+  vtkImageData* NewImage(const int dimensions[3], int scalarType, int numberOfScalarComponents);
+
+  /// Return the scalar array of the image to the pool, if it was allocated by the pool and
+  /// no other data object refers to it. The image is initialized (emptied) if its buffer is recycled,
+  /// and otherwise it is not changed. Returns true if the buffer was recycled.
+  bool RecycleImage(vtkImageData* image);
+
+  /// Set the maximum total size of the buffers that are kept in the pool (in megabytes). Default is 512MB.
+  void SetMaximumPoolSizeMB(double sizeMB);
+  double GetMaximumPoolSizeMB();
+
+  /// Returns the total size of the buffers that are currently kept in the pool (in megabytes)
+  double GetPoolSizeMB();
+
+  /// Release all the buffers that are kept in the pool
+  void ReleaseBuffers();
+
+  /// Number of NewImage calls that reused a buffer from the pool
+  int GetNumberOfReusedBuffers();
+
+  /// Number of NewImage calls that allocated a new buffer
+  int GetNumberOfAllocatedBuffers();
+
+  /// Marks scalar arrays that were allocated by the pool (only these arrays are recycled)
+  static vtkInformationIntegerKey* POOLED_BUFFER();
+
+protected:
+  vtkMRMLSequenceImageBufferPool();
+  ~vtkMRMLSequenceImageBufferPool();
+  vtkMRMLSequenceImageBufferPool(const vtkMRMLSequenceImageBufferPool&);
+  void operator=(const vtkMRMLSequenceImageBufferPool&);
+
+  class vtkInternal;
+  vtkInternal* Internal;
+};
+
+#endif
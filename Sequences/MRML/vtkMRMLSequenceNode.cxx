@@ -19,16 +19,21 @@
 #include "vtkMRMLSequenceNode.h"
 #include "vtkMRMLDisplayableNode.h"
 #include "vtkMRMLDisplayNode.h"
+#include "vtkMRMLSequenceImageBufferPool.h"
 #include "vtkMRMLSequenceStorageNode.h"
 
 // MRML includes
 #include <vtkMRMLScene.h>
+#include <vtkMRMLVolumeNode.h>
 
 // VTK includes
 #include <vtkCollection.h>
+#include <vtkImageData.h>
 #include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
 
 // STD includes
+#include <algorithm>
 #include <sstream>
 
 #define SAFE_CHAR_POINTER(unsafeString) ( unsafeString==NULL?"":unsafeString )
@@ -58,12 +63,40 @@ vtkMRMLSequenceNode::~vtkMRMLSequenceNode()
   this->SetIndexUnit(NULL);
 }
 
+//----------------------------------------------------------------------------
+// Returns the image of a volume data node, so that its pixel buffer can be recycled after the node is removed
+static vtkSmartPointer<vtkImageData> GetRecyclableImage(vtkMRMLNode* dataNode)
+{
+  vtkMRMLVolumeNode* volumeNode=vtkMRMLVolumeNode::SafeDownCast(dataNode);
+  if (volumeNode==NULL)
+  {
+    return NULL;
+  }
+  return volumeNode->GetImageData();
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLSequenceNode::RemoveAllDataNodes()
 {  
+  std::vector< vtkSmartPointer<vtkImageData> > images;
+  for (std::deque< IndexEntryType >::iterator indexIt=this->IndexEntries.begin(); indexIt!=this->IndexEntries.end(); ++indexIt)
+  {
+    vtkSmartPointer<vtkImageData> image=GetRecyclableImage(indexIt->DataNode);
+    if (image!=NULL)
+    {
+      images.push_back(image);
+    }
+  }
   this->SequenceScene->Delete();
   this->SequenceScene=vtkMRMLScene::New();
+  vtkMRMLSequenceImageBufferPool* bufferPool=vtkMRMLSequenceImageBufferPool::GetInstance();
+  for (std::vector< vtkSmartPointer<vtkImageData> >::iterator imageIt=images.begin(); imageIt!=images.end(); ++imageIt)
+  {
+    bufferPool->RecycleImage(*imageIt);
+  }
   this->IndexEntries.clear();
+  this->InvalidItemMask.clear();
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -117,6 +150,26 @@ void vtkMRMLSequenceNode::WriteXML(ostream& of, int nIndent)
   }
   of << "\"";
 
+  if (this->GetNumberOfInvalidItems()>0)
+  {
+    of << indent << " invalidItems=\"";
+    bool firstItem=true;
+    int numberOfMaskItems=this->InvalidItemMask.size();
+    for (int itemNumber=0; itemNumber<numberOfMaskItems; itemNumber++)
+    {
+      if (!this->InvalidItemMask[itemNumber])
+      {
+        continue;
+      }
+      if (!firstItem)
+      {
+        of << " ";
+      }
+      of << itemNumber;
+      firstItem=false;
+    }
+    of << "\"";
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -124,6 +177,9 @@ void vtkMRMLSequenceNode::ReadXMLAttributes(const char** atts)
 {
   vtkMRMLNode::ReadXMLAttributes(atts);
 
+  // Validity is only reset here (not when index values are read), so that it does not depend on the order of the attributes
+  this->InvalidItemMask.clear();
+
   // Read all MRML node attributes from two arrays of names and values
   const char* attName;
   const char* attValue;
@@ -153,6 +209,15 @@ void vtkMRMLSequenceNode::ReadXMLAttributes(const char** atts)
     {
       ReadIndexValues(attValue);
     }
+    else if (!strcmp(attName, "invalidItems"))
+    {
+      std::stringstream ss(attValue);
+      int itemNumber=0;
+      while (ss >> itemNumber)
+      {
+        this->SetNthItemValid(itemNumber, false);
+      }
+    }
   }
 }
 
@@ -230,6 +295,7 @@ void vtkMRMLSequenceNode::Copy(vtkMRMLNode *anode)
     }
     this->IndexEntries.push_back(seqItem);
   }  
+  this->InvalidItemMask=snode->InvalidItemMask;
 
   this->DisableModifiedEventOff();
   this->InvokePendingModifiedEvent();
@@ -306,6 +372,7 @@ void vtkMRMLSequenceNode::SetDataNodeAtValue(vtkMRMLNode* node, const char* inde
     seqItemIndex=this->IndexEntries.size()-1;
   }
   this->IndexEntries[seqItemIndex].DataNode=newNode;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -323,9 +390,120 @@ void vtkMRMLSequenceNode::RemoveDataNodeAtValue(const char* indexValue)
     vtkWarningMacro("vtkMRMLSequenceNode::RemoveDataNodeAtValue: node was not found at index value "<<indexValue);
     return;
   }
+  vtkSmartPointer<vtkImageData> image=GetRecyclableImage(this->IndexEntries[seqItemIndex].DataNode);
   // TODO: remove associated nodes as well (such as storage node)?
   this->SequenceScene->RemoveNode(this->IndexEntries[seqItemIndex].DataNode);
   this->IndexEntries.erase(this->IndexEntries.begin()+seqItemIndex);
+  this->RemoveNthItemValidity(seqItemIndex);
+  vtkMRMLSequenceImageBufferPool::GetInstance()->RecycleImage(image);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceNode::RemoveFirstDataNodes(int numberOfItems)
+{
+  if (numberOfItems>static_cast<int>(this->IndexEntries.size()))
+  {
+    numberOfItems=this->IndexEntries.size();
+  }
+  if (numberOfItems<=0)
+  {
+    return;
+  }
+  vtkMRMLSequenceImageBufferPool* bufferPool=vtkMRMLSequenceImageBufferPool::GetInstance();
+  // Remove all the data nodes in a single batch, so that scene events are not processed for each removed node
+  bool batchProcess=(numberOfItems>1);
+  if (batchProcess)
+  {
+    this->SequenceScene->StartState(vtkMRMLScene::BatchProcessState);
+  }
+  for (int i=0; i<numberOfItems; i++)
+  {
+    if (this->IndexEntries[i].DataNode!=NULL)
+    {
+      vtkSmartPointer<vtkImageData> image=GetRecyclableImage(this->IndexEntries[i].DataNode);
+      this->SequenceScene->RemoveNode(this->IndexEntries[i].DataNode);
+      bufferPool->RecycleImage(image);
+    }
+  }
+  if (batchProcess)
+  {
+    this->SequenceScene->EndState(vtkMRMLScene::BatchProcessState);
+  }
+  this->IndexEntries.erase(this->IndexEntries.begin(), this->IndexEntries.begin()+numberOfItems);
+  this->RemoveFirstItemsValidity(numberOfItems);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceNode::AppendDataNodeAtValue(vtkMRMLNode* node, const char* indexValue, bool reuseFirstItem)
+{
+  if (node==NULL)
+  {
+    vtkErrorMacro("vtkMRMLSequenceNode::AppendDataNodeAtValue failed, invalid node");
+    return;
+  }
+  if (indexValue==NULL)
+  {
+    vtkErrorMacro("vtkMRMLSequenceNode::AppendDataNodeAtValue failed, invalid indexValue");
+    return;
+  }
+  // removal and addition of the item is reported in a single modified event
+  int wasModified=this->StartModify();
+  vtkMRMLNode* reusedNode=NULL;
+  if (reuseFirstItem && !this->IndexEntries.empty())
+  {
+    reusedNode=this->IndexEntries.front().DataNode;
+    if (reusedNode==NULL || strcmp(reusedNode->GetClassName(), node->GetClassName())!=0
+      || this->GetSequenceItemIndex(indexValue)>=0)
+    {
+      // cannot be reused (or an existing item is overwritten), remove the first item and add a new one
+      reusedNode=NULL;
+      this->RemoveFirstDataNodes(1);
+    }
+  }
+  if (reusedNode==NULL)
+  {
+    this->SetDataNodeAtValue(node, indexValue);
+    this->EndModify(wasModified);
+    return;
+  }
+
+  IndexEntryType seqItem=this->IndexEntries.front();
+  this->IndexEntries.pop_front();
+  this->RemoveFirstItemsValidity(1);
+
+  // Display nodes are shared by all the items, keep the display node references of the reused node
+  std::vector< std::string > displayNodeIDs;
+  vtkMRMLDisplayableNode* reusedDisplayableNode=vtkMRMLDisplayableNode::SafeDownCast(reusedNode);
+  if (reusedDisplayableNode!=NULL)
+  {
+    int numOfDisplayNodes=reusedDisplayableNode->GetNumberOfDisplayNodes();
+    for (int displayNodeIndex=0; displayNodeIndex<numOfDisplayNodes; displayNodeIndex++)
+    {
+      const char* displayNodeID=reusedDisplayableNode->GetNthDisplayNodeID(displayNodeIndex);
+      displayNodeIDs.push_back(displayNodeID ? displayNodeID : "");
+    }
+  }
+  vtkSmartPointer<vtkImageData> reusedImage=GetRecyclableImage(reusedNode);
+  reusedNode->Copy(node);
+  if (reusedImage!=GetRecyclableImage(reusedNode))
+  {
+    vtkMRMLSequenceImageBufferPool::GetInstance()->RecycleImage(reusedImage);
+  }
+  if (reusedDisplayableNode!=NULL)
+  {
+    reusedDisplayableNode->RemoveAllDisplayNodeIDs();
+    for (std::vector< std::string >::iterator displayNodeIDIt=displayNodeIDs.begin(); displayNodeIDIt!=displayNodeIDs.end(); ++displayNodeIDIt)
+    {
+      reusedDisplayableNode->AddAndObserveDisplayNodeID(displayNodeIDIt->c_str());
+    }
+  }
+
+  seqItem.IndexValue=indexValue;
+  this->IndexEntries.push_back(seqItem);
+  this->Modified();
+  this->EndModify(wasModified);
 }
 
 //----------------------------------------------------------------------------
@@ -412,6 +590,7 @@ void vtkMRMLSequenceNode::UpdateIndexValue(const char* oldIndexValue, const char
   }
   // Update the index value
   this->IndexEntries[seqItemIndex].IndexValue=newIndexValue;
+  this->Modified();
 }
 
 //-----------------------------------------------------------------------------
@@ -500,6 +679,95 @@ void vtkMRMLSequenceNode::GetDisplayNodesAtValue(std::vector< vtkMRMLDisplayNode
   }  
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceNode::SetNthItemValid(int itemNumber, bool valid)
+{
+  if (itemNumber<0)
+  {
+    vtkErrorMacro("vtkMRMLSequenceNode::SetNthItemValid failed: invalid item number "<<itemNumber);
+    return;
+  }
+  if (itemNumber>=static_cast<int>(this->InvalidItemMask.size()))
+  {
+    if (valid)
+    {
+      // items that are not in the mask are valid
+      return;
+    }
+    this->InvalidItemMask.resize(itemNumber+1, false);
+  }
+  if (this->InvalidItemMask[itemNumber]==!valid)
+  {
+    // no change
+    return;
+  }
+  this->InvalidItemMask[itemNumber]=!valid;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceNode::GetNthItemValid(int itemNumber)
+{
+  if (itemNumber<0 || itemNumber>=static_cast<int>(this->InvalidItemMask.size()))
+  {
+    return true;
+  }
+  return !this->InvalidItemMask[itemNumber];
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceNode::SetItemValidAtValue(const char* indexValue, bool valid)
+{
+  int seqItemIndex=this->GetSequenceItemIndex(indexValue);
+  if (seqItemIndex<0)
+  {
+    vtkWarningMacro("vtkMRMLSequenceNode::SetItemValidAtValue: item was not found at index value "<<(indexValue?indexValue:"(NULL)"));
+    return;
+  }
+  this->SetNthItemValid(seqItemIndex, valid);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceNode::GetItemValidAtValue(const char* indexValue)
+{
+  if (this->InvalidItemMask.empty())
+  {
+    // all items are valid, no need to look up the item
+    return true;
+  }
+  return this->GetNthItemValid(this->GetSequenceItemIndex(indexValue));
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceNode::GetNumberOfInvalidItems()
+{
+  return std::count(this->InvalidItemMask.begin(), this->InvalidItemMask.end(), true);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceNode::RemoveNthItemValidity(int itemNumber)
+{
+  if (itemNumber<0 || itemNumber>=static_cast<int>(this->InvalidItemMask.size()))
+  {
+    return;
+  }
+  this->InvalidItemMask.erase(this->InvalidItemMask.begin()+itemNumber);
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLSequenceNode::RemoveFirstItemsValidity(int numberOfItems)
+{
+  if (numberOfItems>static_cast<int>(this->InvalidItemMask.size()))
+  {
+    numberOfItems=this->InvalidItemMask.size();
+  }
+  if (numberOfItems<=0)
+  {
+    return;
+  }
+  this->InvalidItemMask.erase(this->InvalidItemMask.begin(), this->InvalidItemMask.begin()+numberOfItems);
+}
+
 //-----------------------------------------------------------------------------
 vtkMRMLScene* vtkMRMLSequenceNode::GetSequenceScene()
 {
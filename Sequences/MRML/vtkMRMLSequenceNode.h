@@ -25,6 +25,7 @@
 // std includes
 #include <deque>
 #include <set>
+#include <vector>
 
 #include "vtkSlicerSequencesModuleMRMLExport.h"
 
@@ -88,32 +89,56 @@ public:
   static int GetIndexTypeFromString(const char* indexTypeString);
 
   /// Add a copy of the provided node to this sequence as a data node
-  void SetDataNodeAtValue(vtkMRMLNode* node, const char* indexValue);
+  virtual void SetDataNodeAtValue(vtkMRMLNode* node, const char* indexValue);
 
-  void RemoveDataNodeAtValue(const char* indexValue);
+  virtual void RemoveDataNodeAtValue(const char* indexValue);
 
-  void RemoveAllDataNodes();
+  virtual void RemoveAllDataNodes();
+
+  /// Remove the first (oldest) items of the sequence
+  virtual void RemoveFirstDataNodes(int numberOfItems);
+
+  /// Add a copy of the provided node as the last item of the sequence.
+  /// If reuseFirstItem is true then the first item is removed and its data node is reused for storing the new item,
+  /// so that no new node has to be allocated when the sequence is used as a fixed-capacity buffer (e.g., for live recording).
+  virtual void AppendDataNodeAtValue(vtkMRMLNode* node, const char* indexValue, bool reuseFirstItem);
 
   /// Get the node corresponding to the specified index value
-  vtkMRMLNode* GetDataNodeAtValue(const char* indexValue);
+  virtual vtkMRMLNode* GetDataNodeAtValue(const char* indexValue);
 
   /// Get the all the display nodes corresponding to the specified index value
-  void GetDisplayNodesAtValue(std::vector< vtkMRMLDisplayNode* > &dataNodes, const char* indexValue);
+  virtual void GetDisplayNodesAtValue(std::vector< vtkMRMLDisplayNode* > &dataNodes, const char* indexValue);
 
   /// Get the data node corresponding to the n-th index value
-  vtkMRMLNode* GetNthDataNode(int itemNumber);
+  virtual vtkMRMLNode* GetNthDataNode(int itemNumber);
 
-  std::string GetNthIndexValue(int itemNumber);
+  virtual std::string GetNthIndexValue(int itemNumber);
 
-  void UpdateIndexValue(const char* oldIndexValue, const char* newIndexValue);
+  virtual void UpdateIndexValue(const char* oldIndexValue, const char* newIndexValue);
 
-  int GetNumberOfDataNodes();
+  virtual int GetNumberOfDataNodes();
 
   /// Return the class name of the data nodes (e.g., vtkMRMLTransformNode). If there are no data nodes yet then it returns empty string.
-  std::string GetDataNodeClassName();
+  virtual std::string GetDataNodeClassName();
 
   /// Return the human-readable type name of the data nodes (e.g., TransformNode). If there are no data nodes yet then it returns the string "undefined".
-  std::string GetDataNodeTagName();
+  virtual std::string GetDataNodeTagName();
+
+  /// Mark the n-th item as valid or invalid (for example, tracker data with missing or out-of-view tools).
+  /// All items are valid by default. Invalid items are kept in the sequence but skipped during playback and processing.
+  void SetNthItemValid(int itemNumber, bool valid);
+
+  /// Returns true if the n-th item is valid
+  bool GetNthItemValid(int itemNumber);
+
+  /// Mark the item at the specified index value as valid or invalid
+  void SetItemValidAtValue(const char* indexValue, bool valid);
+
+  /// Returns true if the item at the specified index value is valid (or if no item exists at that index value)
+  bool GetItemValidAtValue(const char* indexValue);
+
+  /// Returns the number of items that are marked as invalid
+  int GetNumberOfInvalidItems();
 
   vtkMRMLScene* GetSequenceScene();
 
@@ -137,10 +162,17 @@ protected:
   vtkMRMLSequenceNode(const vtkMRMLSequenceNode&);
   void operator=(const vtkMRMLSequenceNode&);
 
-  int GetSequenceItemIndex(const char* indexValue);
+  /// Returns the item number corresponding to the index value (-1 if not found)
+  virtual int GetSequenceItemIndex(const char* indexValue);
 
   void ReadIndexValues(const std::string& indexText);
 
+  /// Remove the validity flag of the n-th item (subsequent items are shifted). Must be called when an item is removed.
+  void RemoveNthItemValidity(int itemNumber);
+
+  /// Remove the validity flags of the first items. Must be called when the first items are removed.
+  void RemoveFirstItemsValidity(int numberOfItems);
+
   struct IndexEntryType
   {
     std::string IndexValue;
@@ -162,6 +194,10 @@ protected:
   /// List of data items (the scene may contain some more nodes, such as storage nodes)
   std::deque< IndexEntryType > IndexEntries;
 
+  /// Bit mask of invalid items, indexed by item number. Bits are only allocated up to the last invalid item,
+  /// therefore the mask is empty if all the items are valid.
+  std::vector<bool> InvalidItemMask;
+
 };
 
 #endif
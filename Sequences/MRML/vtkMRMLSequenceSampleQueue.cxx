@@ -0,0 +1,299 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLSequence includes
+#include "vtkMRMLSequenceSampleQueue.h"
+#include "vtkMRMLLinearTransformSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkVersion.h>
+
+#if (VTK_MAJOR_VERSION > 6) || (VTK_MAJOR_VERSION == 6 && VTK_MINOR_VERSION >= 2)
+#include <vtkAtomicInt.h>
+#define SEQUENCE_SAMPLE_QUEUE_LOCK_FREE
+#else
+#include <vtkSimpleCriticalSection.h>
+#endif
+
+// STD includes
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+static const int NUMBER_OF_MATRIX_ELEMENTS = 16;
+static const int DEFAULT_CAPACITY = 256;
+
+//----------------------------------------------------------------------------
+class vtkMRMLSequenceSampleQueue::vtkInternal
+{
+public:
+  struct SampleType
+  {
+    double TimestampSec;
+    double MatrixElements[NUMBER_OF_MATRIX_ELEMENTS];
+    // Non-NULL for image samples, the queue owns one reference
+    vtkImageData* Image;
+  };
+
+  vtkInternal()
+  {
+    this->Head = 0;
+    this->Tail = 0;
+    this->NumberOfDroppedSamples = 0;
+  }
+
+  // One slot is always kept empty to distinguish between full and empty queue
+  std::vector<SampleType> Slots;
+
+#ifdef SEQUENCE_SAMPLE_QUEUE_LOCK_FREE
+  int LoadHead() { return this->Head.Load(); }
+  int LoadTail() { return this->Tail.Load(); }
+  void StoreHead(int head) { this->Head.Store(head); }
+  void StoreTail(int tail) { this->Tail.Store(tail); }
+  void IncrementNumberOfDroppedSamples() { ++this->NumberOfDroppedSamples; }
+  int LoadNumberOfDroppedSamples() { return this->NumberOfDroppedSamples.Load(); }
+
+  // Position of the next sample to read (only modified by the consumer)
+  vtkAtomicInt<int> Head;
+  // Position of the next sample to write (only modified by the producer)
+  vtkAtomicInt<int> Tail;
+  vtkAtomicInt<int> NumberOfDroppedSamples;
+#else
+  int LoadHead() { this->Lock.Lock(); int head = this->Head; this->Lock.Unlock(); return head; }
+  int LoadTail() { this->Lock.Lock(); int tail = this->Tail; this->Lock.Unlock(); return tail; }
+  void StoreHead(int head) { this->Lock.Lock(); this->Head = head; this->Lock.Unlock(); }
+  void StoreTail(int tail) { this->Lock.Lock(); this->Tail = tail; this->Lock.Unlock(); }
+  void IncrementNumberOfDroppedSamples() { this->Lock.Lock(); this->NumberOfDroppedSamples++; this->Lock.Unlock(); }
+  int LoadNumberOfDroppedSamples() { this->Lock.Lock(); int dropped = this->NumberOfDroppedSamples; this->Lock.Unlock(); return dropped; }
+
+  vtkSimpleCriticalSection Lock;
+  int Head;
+  int Tail;
+  int NumberOfDroppedSamples;
+#endif
+
+  // Nodes used for adding samples to sequences that store a copy of the data node
+  vtkSmartPointer<vtkMRMLLinearTransformNode> TransformNode;
+  vtkSmartPointer<vtkMRMLScalarVolumeNode> VolumeNode;
+  vtkSmartPointer<vtkMatrix4x4> Matrix;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkMRMLSequenceSampleQueue);
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceSampleQueue::vtkMRMLSequenceSampleQueue()
+{
+  this->Internal = new vtkInternal;
+  this->Internal->TransformNode = vtkSmartPointer<vtkMRMLLinearTransformNode>::New();
+  this->Internal->VolumeNode = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+  this->Internal->Matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  this->SetCapacity(DEFAULT_CAPACITY);
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceSampleQueue::~vtkMRMLSequenceSampleQueue()
+{
+  this->ClearQueuedSamples();
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceSampleQueue::PrintSelf(ostream& os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os,indent);
+  os << indent << "Capacity: " << this->GetCapacity() << "\n";
+  os << indent << "NumberOfQueuedSamples: " << this->GetNumberOfQueuedSamples() << "\n";
+  os << indent << "NumberOfDroppedSamples: " << this->GetNumberOfDroppedSamples() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceSampleQueue::ClearQueuedSamples()
+{
+  int numberOfSlots = this->Internal->Slots.size();
+  for (int i = this->Internal->LoadHead(); i != this->Internal->LoadTail(); i = (i+1) % numberOfSlots)
+  {
+    if (this->Internal->Slots[i].Image != NULL)
+    {
+      this->Internal->Slots[i].Image->Delete();
+      this->Internal->Slots[i].Image = NULL;
+    }
+  }
+  this->Internal->StoreHead(0);
+  this->Internal->StoreTail(0);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceSampleQueue::SetCapacity(int numberOfSamples)
+{
+  if (numberOfSamples<1)
+  {
+    vtkErrorMacro("vtkMRMLSequenceSampleQueue::SetCapacity failed: capacity must be at least 1");
+    return;
+  }
+  this->ClearQueuedSamples();
+  vtkInternal::SampleType emptySample;
+  emptySample.TimestampSec = 0.0;
+  emptySample.Image = NULL;
+  this->Internal->Slots.assign(numberOfSamples+1, emptySample);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceSampleQueue::GetCapacity()
+{
+  return this->Internal->Slots.size()-1;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceSampleQueue::PushTransformSample(double timestampSec, const double matrixElements[16])
+{
+  int numberOfSlots = this->Internal->Slots.size();
+  int tail = this->Internal->LoadTail();
+  int nextTail = (tail+1) % numberOfSlots;
+  if (nextTail == this->Internal->LoadHead())
+  {
+    // queue is full
+    this->Internal->IncrementNumberOfDroppedSamples();
+    return false;
+  }
+  vtkInternal::SampleType& sample = this->Internal->Slots[tail];
+  sample.TimestampSec = timestampSec;
+  for (int i=0; i<NUMBER_OF_MATRIX_ELEMENTS; i++)
+  {
+    sample.MatrixElements[i] = matrixElements[i];
+  }
+  sample.Image = NULL;
+  // the sample becomes visible to the consumer only after it is completely written
+  this->Internal->StoreTail(nextTail);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceSampleQueue::PushImageSample(double timestampSec, vtkImageData* image)
+{
+  if (image == NULL)
+  {
+    return false;
+  }
+  int numberOfSlots = this->Internal->Slots.size();
+  int tail = this->Internal->LoadTail();
+  int nextTail = (tail+1) % numberOfSlots;
+  if (nextTail == this->Internal->LoadHead())
+  {
+    // queue is full
+    this->Internal->IncrementNumberOfDroppedSamples();
+    image->Delete();
+    return false;
+  }
+  vtkInternal::SampleType& sample = this->Internal->Slots[tail];
+  sample.TimestampSec = timestampSec;
+  sample.Image = image;
+  // the sample becomes visible to the consumer only after it is completely written
+  this->Internal->StoreTail(nextTail);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceSampleQueue::DrainToSequence(vtkMRMLSequenceNode* sequenceNode, int maximumNumberOfSamples/*=0*/)
+{
+  if (sequenceNode == NULL)
+  {
+    vtkErrorMacro("vtkMRMLSequenceSampleQueue::DrainToSequence failed: sequenceNode is invalid");
+    return 0;
+  }
+  vtkMRMLLinearTransformSequenceNode* transformSequenceNode = vtkMRMLLinearTransformSequenceNode::SafeDownCast(sequenceNode);
+  int numberOfSlots = this->Internal->Slots.size();
+  int head = this->Internal->LoadHead();
+  int tail = this->Internal->LoadTail();
+  int numberOfAddedSamples = 0;
+  // all the added samples are reported in a single modified event
+  int wasModified = sequenceNode->StartModify();
+  while (head != tail && (maximumNumberOfSamples<=0 || numberOfAddedSamples<maximumNumberOfSamples))
+  {
+    vtkInternal::SampleType& sample = this->Internal->Slots[head];
+    std::stringstream indexValueStream;
+    indexValueStream << std::fixed << std::setprecision(6) << sample.TimestampSec;
+    std::string indexValue = indexValueStream.str();
+    if (sample.Image != NULL)
+    {
+      // The image is set after the node is copied into the sequence, so that the pixel data is not copied.
+      // The sequence item takes over the image, its buffer is returned to the pool when the item is removed.
+      sequenceNode->SetDataNodeAtValue(this->Internal->VolumeNode, indexValue.c_str());
+      vtkMRMLScalarVolumeNode* itemVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(sequenceNode->GetDataNodeAtValue(indexValue.c_str()));
+      if (itemVolumeNode != NULL)
+      {
+        itemVolumeNode->SetAndObserveImageData(sample.Image);
+      }
+      sample.Image->Delete();
+      sample.Image = NULL;
+    }
+    else if (transformSequenceNode != NULL)
+    {
+      transformSequenceNode->SetMatrixElementsAtValue(sample.MatrixElements, indexValue.c_str());
+    }
+    else
+    {
+      this->Internal->Matrix->DeepCopy(sample.MatrixElements);
+      this->Internal->TransformNode->SetMatrixTransformToParent(this->Internal->Matrix);
+      sequenceNode->SetDataNodeAtValue(this->Internal->TransformNode, indexValue.c_str());
+    }
+    head = (head+1) % numberOfSlots;
+    // release the slot immediately, so that the producer can reuse it
+    this->Internal->StoreHead(head);
+    numberOfAddedSamples++;
+  }
+  if (numberOfAddedSamples>0)
+  {
+    sequenceNode->Modified();
+  }
+  sequenceNode->EndModify(wasModified);
+  return numberOfAddedSamples;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceSampleQueue::SetImageSampleIJKToRASMatrix(vtkMatrix4x4* ijkToRasMatrix)
+{
+  if (ijkToRasMatrix == NULL)
+  {
+    vtkErrorMacro("vtkMRMLSequenceSampleQueue::SetImageSampleIJKToRASMatrix failed: ijkToRasMatrix is invalid");
+    return;
+  }
+  this->Internal->VolumeNode->SetIJKToRASMatrix(ijkToRasMatrix);
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceSampleQueue::GetNumberOfQueuedSamples()
+{
+  int numberOfSlots = this->Internal->Slots.size();
+  return (this->Internal->LoadTail() - this->Internal->LoadHead() + numberOfSlots) % numberOfSlots;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceSampleQueue::GetNumberOfDroppedSamples()
+{
+  return this->Internal->LoadNumberOfDroppedSamples();
+}
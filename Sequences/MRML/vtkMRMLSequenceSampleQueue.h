@@ -0,0 +1,91 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkMRMLSequenceSampleQueue_h
+#define __vtkMRMLSequenceSampleQueue_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerSequencesModuleMRMLExport.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkMRMLSequenceNode;
+
+/// \brief Queue for passing acquired samples from an acquisition thread to a sequence node
+///
+/// MRML nodes may only be modified on the main thread. An acquisition thread (the single producer)
+/// pushes transform or image samples into this fixed-capacity queue, and the main thread (the single consumer)
+/// periodically adds all the queued samples to a sequence node by calling DrainToSequence.
+/// Pushing a sample never blocks and does not allocate memory, so capture timing is not affected by
+/// rendering or other stalls of the main thread. If the queue is full then the sample is dropped.
+///
+/// The queue is lock-free if VTK provides vtkAtomicInt (VTK 6.2 or later), otherwise a critical section
+/// protects the read and write positions.
+
+class VTK_SLICER_SEQUENCES_MODULE_MRML_EXPORT vtkMRMLSequenceSampleQueue : public vtkObject
+{
+public:
+  static vtkMRMLSequenceSampleQueue *New();
+  vtkTypeMacro(vtkMRMLSequenceSampleQueue,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Set the maximum number of queued samples. Queued samples are discarded.
+  /// Must not be called while the producer thread is pushing samples.
+  void SetCapacity(int numberOfSamples);
+  int GetCapacity();
+
+  /// Add a transform sample (16 matrix elements, row-major order). May be called from the producer thread.
+  /// Returns false if the queue is full and the sample was dropped.
+  bool PushTransformSample(double timestampSec, const double matrixElements[16]);
+
+  /// Add an image sample. May be called from the producer thread.
+  /// The queue takes over one reference of the image: the caller must not call Delete or modify the image after this call.
+  /// Returns false if the queue is full and the sample was dropped (the image reference is released then).
+  /// Creating the image with vtkMRMLSequenceImageBufferPool::NewImage avoids allocating a new buffer for each sample.
+  bool PushImageSample(double timestampSec, vtkImageData* image);
+
+  /// Add the queued samples to the sequence node, using the timestamp as index value.
+  /// Must be called on the main thread. Transform samples are stored in vtkMRMLLinearTransformSequenceNode
+  /// without creating a transform node. If maximumNumberOfSamples>0 then at most that many samples are added.
+  /// Returns the number of samples that were added.
+  int DrainToSequence(vtkMRMLSequenceNode* sequenceNode, int maximumNumberOfSamples=0);
+
+  /// Set the IJK to RAS matrix of the volume nodes that are created from image samples
+  void SetImageSampleIJKToRASMatrix(vtkMatrix4x4* ijkToRasMatrix);
+
+  /// Returns the number of samples that are waiting to be added to the sequence
+  int GetNumberOfQueuedSamples();
+
+  /// Returns the number of samples that were dropped because the queue was full
+  int GetNumberOfDroppedSamples();
+
+protected:
+  vtkMRMLSequenceSampleQueue();
+  ~vtkMRMLSequenceSampleQueue();
+  vtkMRMLSequenceSampleQueue(const vtkMRMLSequenceSampleQueue&);
+  void operator=(const vtkMRMLSequenceSampleQueue&);
+
+  /// Releases the images of all the queued samples
+  void ClearQueuedSamples();
+
+  class vtkInternal;
+  vtkInternal* Internal;
+};
+
+#endif
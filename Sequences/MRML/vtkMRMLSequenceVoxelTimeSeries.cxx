@@ -0,0 +1,447 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLSequence includes
+#include "vtkMRMLSequenceVoxelTimeSeries.h"
+#include "vtkMRMLSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <vector>
+
+static const int DEFAULT_NUMBER_OF_VOXELS_PER_BLOCK = 16384;
+
+//----------------------------------------------------------------------------
+// Copies the values of one time point into the transposed block
+template <class T>
+void TransposeFrameValues(const T* frameValues, vtkIdType numberOfValues, int numberOfTimePoints, int timePoint, float* block)
+{
+  float* blockValue = block + timePoint;
+  for (vtkIdType valueIndex = 0; valueIndex < numberOfValues; valueIndex++)
+  {
+    *blockValue = static_cast<float>(frameValues[valueIndex]);
+    blockValue += numberOfTimePoints;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Returns true if values of the scalar type can be transposed by TransposeFrameValues
+bool IsSupportedScalarType(int scalarType)
+{
+  switch (scalarType)
+  {
+    vtkTemplateMacro(return true);
+    default:
+      return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+class vtkMRMLSequenceVoxelTimeSeries::vtkInternal
+{
+public:
+  vtkInternal()
+  {
+    this->Valid = false;
+    this->ModifiedTime = 0;
+    this->NumberOfComponents = 0;
+    this->NumberOfVoxels = 0;
+    for (int i=0; i<6; i++)
+    {
+      this->Extent[i] = 0;
+    }
+  }
+
+  // Returns the index of the voxel in the images, -1 if the voxel is outside the extent
+  vtkIdType GetVoxelIndex(int i, int j, int k)
+  {
+    if (i<this->Extent[0] || i>this->Extent[1] || j<this->Extent[2] || j>this->Extent[3] || k<this->Extent[4] || k>this->Extent[5])
+    {
+      return -1;
+    }
+    vtkIdType dimX = this->Extent[1]-this->Extent[0]+1;
+    vtkIdType dimY = this->Extent[3]-this->Extent[2]+1;
+    return ((k-this->Extent[4])*dimY + (j-this->Extent[2]))*dimX + (i-this->Extent[0]);
+  }
+
+  vtkWeakPointer<vtkMRMLSequenceNode> SequenceNode;
+
+  // Images of the sequence items at the last update (only dereferenced if the sequence is not modified since then)
+  std::vector<vtkImageData*> Images;
+  // Latest modification time of the sequence node and images at the last update
+  unsigned long ModifiedTime;
+  // True if all the images have the same extent, number of components, and a supported scalar type
+  bool Valid;
+
+  int Extent[6];
+  int NumberOfComponents;
+  vtkIdType NumberOfVoxels;
+
+  // Transposed values, [voxel][component][time point] in each block. Empty if the block is not built yet.
+  std::vector< std::vector<float> > Blocks;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkMRMLSequenceVoxelTimeSeries);
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceVoxelTimeSeries::vtkMRMLSequenceVoxelTimeSeries()
+{
+  this->NumberOfVoxelsPerBlock = DEFAULT_NUMBER_OF_VOXELS_PER_BLOCK;
+  this->Internal = new vtkInternal;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceVoxelTimeSeries::~vtkMRMLSequenceVoxelTimeSeries()
+{
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceVoxelTimeSeries::PrintSelf(ostream& os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os,indent);
+  os << indent << "NumberOfVoxelsPerBlock: " << this->NumberOfVoxelsPerBlock << "\n";
+  os << indent << "NumberOfTimePoints: " << this->Internal->Images.size() << "\n";
+  os << indent << "NumberOfBuiltBlocks: " << this->GetNumberOfBuiltBlocks() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceVoxelTimeSeries::SetSequenceNode(vtkMRMLSequenceNode* sequenceNode)
+{
+  if (this->Internal->SequenceNode == sequenceNode)
+  {
+    return;
+  }
+  this->Internal->SequenceNode = sequenceNode;
+  this->Internal->Valid = false;
+  this->Internal->ModifiedTime = 0;
+  this->Internal->Images.clear();
+  this->Internal->Blocks.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLSequenceNode* vtkMRMLSequenceVoxelTimeSeries::GetSequenceNode()
+{
+  return this->Internal->SequenceNode;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceVoxelTimeSeries::SetNumberOfVoxelsPerBlock(int numberOfVoxels)
+{
+  if (numberOfVoxels<1)
+  {
+    vtkErrorMacro("vtkMRMLSequenceVoxelTimeSeries::SetNumberOfVoxelsPerBlock failed: number of voxels must be at least 1");
+    return;
+  }
+  if (this->NumberOfVoxelsPerBlock == numberOfVoxels)
+  {
+    return;
+  }
+  this->NumberOfVoxelsPerBlock = numberOfVoxels;
+  // blocks will be reallocated at the next update
+  this->Internal->Valid = false;
+  this->Internal->ModifiedTime = 0;
+  this->Internal->Blocks.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceVoxelTimeSeries::Update()
+{
+  vtkMRMLSequenceNode* sequenceNode = this->Internal->SequenceNode;
+  if (sequenceNode == NULL)
+  {
+    this->Internal->Valid = false;
+    this->Internal->Images.clear();
+    this->Internal->Blocks.clear();
+    return false;
+  }
+
+  // Get the images and the latest modification time
+  unsigned long modifiedTime = sequenceNode->GetMTime();
+  std::vector<vtkImageData*> images;
+  int numberOfDataNodes = sequenceNode->GetNumberOfDataNodes();
+  images.reserve(numberOfDataNodes);
+  bool allItemsHaveImage = true;
+  for (int i=0; i<numberOfDataNodes; i++)
+  {
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(sequenceNode->GetNthDataNode(i));
+    vtkImageData* imageData = volumeNode ? volumeNode->GetImageData() : NULL;
+    if (imageData == NULL || imageData->GetPointData()->GetScalars() == NULL)
+    {
+      allItemsHaveImage = false;
+      break;
+    }
+    if (imageData->GetMTime() > modifiedTime)
+    {
+      modifiedTime = imageData->GetMTime();
+    }
+    images.push_back(imageData);
+  }
+  if (!allItemsHaveImage || images.empty())
+  {
+    this->Internal->Valid = false;
+    this->Internal->Blocks.clear();
+    this->Internal->Images.clear();
+    this->Internal->ModifiedTime = 0;
+    return false;
+  }
+  if (modifiedTime == this->Internal->ModifiedTime && images == this->Internal->Images)
+  {
+    // not changed since the last update
+    return this->Internal->Valid;
+  }
+
+  // The sequence has changed, the transposed values are not valid anymore
+  this->Internal->Valid = false;
+  this->Internal->Blocks.clear();
+  this->Internal->Images = images;
+  this->Internal->ModifiedTime = modifiedTime;
+  images[0]->GetExtent(this->Internal->Extent);
+  this->Internal->NumberOfComponents = images[0]->GetNumberOfScalarComponents();
+  for (std::vector<vtkImageData*>::iterator imageIt = images.begin(); imageIt != images.end(); ++imageIt)
+  {
+    int* extent = (*imageIt)->GetExtent();
+    if ((*imageIt)->GetNumberOfScalarComponents() != this->Internal->NumberOfComponents
+      || extent[0]!=this->Internal->Extent[0] || extent[1]!=this->Internal->Extent[1]
+      || extent[2]!=this->Internal->Extent[2] || extent[3]!=this->Internal->Extent[3]
+      || extent[4]!=this->Internal->Extent[4] || extent[5]!=this->Internal->Extent[5])
+    {
+      vtkErrorMacro("vtkMRMLSequenceVoxelTimeSeries::Update failed: all the images must have the same extent and number of scalar components");
+      return false;
+    }
+    if (!IsSupportedScalarType((*imageIt)->GetPointData()->GetScalars()->GetDataType()))
+    {
+      vtkErrorMacro("vtkMRMLSequenceVoxelTimeSeries::Update failed: unsupported scalar type "
+        << (*imageIt)->GetPointData()->GetScalars()->GetDataTypeAsString());
+      return false;
+    }
+  }
+  this->Internal->NumberOfVoxels = static_cast<vtkIdType>(this->Internal->Extent[1]-this->Internal->Extent[0]+1)
+    * (this->Internal->Extent[3]-this->Internal->Extent[2]+1) * (this->Internal->Extent[5]-this->Internal->Extent[4]+1);
+  vtkIdType numberOfBlocks = (this->Internal->NumberOfVoxels + this->NumberOfVoxelsPerBlock - 1) / this->NumberOfVoxelsPerBlock;
+  this->Internal->Blocks.resize(numberOfBlocks);
+  this->Internal->Valid = true;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceVoxelTimeSeries::GetNumberOfTimePoints()
+{
+  if (!this->Update())
+  {
+    return 0;
+  }
+  return static_cast<int>(this->Internal->Images.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceVoxelTimeSeries::GetExtent(int extent[6])
+{
+  this->Update();
+  for (int i=0; i<6; i++)
+  {
+    extent[i] = this->Internal->Extent[i];
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceVoxelTimeSeries::GetNumberOfScalarComponents()
+{
+  this->Update();
+  return this->Internal->NumberOfComponents;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceVoxelTimeSeries::BuildBlock(int blockIndex)
+{
+  vtkIdType firstVoxelIndex = static_cast<vtkIdType>(blockIndex) * this->NumberOfVoxelsPerBlock;
+  vtkIdType numberOfVoxels = this->Internal->NumberOfVoxels - firstVoxelIndex;
+  if (numberOfVoxels > this->NumberOfVoxelsPerBlock)
+  {
+    numberOfVoxels = this->NumberOfVoxelsPerBlock;
+  }
+  int numberOfTimePoints = static_cast<int>(this->Internal->Images.size());
+  int numberOfComponents = this->Internal->NumberOfComponents;
+  std::vector<float>& block = this->Internal->Blocks[blockIndex];
+  block.resize(numberOfVoxels * numberOfComponents * numberOfTimePoints);
+  for (int timePoint = 0; timePoint < numberOfTimePoints; timePoint++)
+  {
+    vtkDataArray* scalars = this->Internal->Images[timePoint]->GetPointData()->GetScalars();
+    void* frameValues = scalars->GetVoidPointer(firstVoxelIndex * numberOfComponents);
+    switch (scalars->GetDataType())
+    {
+      vtkTemplateMacro(TransposeFrameValues(static_cast<VTK_TT*>(frameValues), numberOfVoxels * numberOfComponents,
+        numberOfTimePoints, timePoint, &block[0]));
+      default:
+        // Update() checks the scalar types, so this only happens if an image was changed without updating
+        // its modification time. Partially filled values must not be used as valid data.
+        vtkErrorMacro("vtkMRMLSequenceVoxelTimeSeries::BuildBlock failed: unsupported scalar type");
+        block.clear();
+        return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+const float* vtkMRMLSequenceVoxelTimeSeries::GetVoxelTimeSeriesPointer(int i, int j, int k, int component/*=0*/)
+{
+  if (!this->Update() || component<0 || component>=this->Internal->NumberOfComponents)
+  {
+    return NULL;
+  }
+  vtkIdType voxelIndex = this->Internal->GetVoxelIndex(i, j, k);
+  if (voxelIndex<0)
+  {
+    return NULL;
+  }
+  return this->GetTransposedValues(voxelIndex, component);
+}
+
+//----------------------------------------------------------------------------
+const float* vtkMRMLSequenceVoxelTimeSeries::GetTransposedValues(vtkIdType voxelIndex, int component)
+{
+  int blockIndex = static_cast<int>(voxelIndex / this->NumberOfVoxelsPerBlock);
+  if (this->Internal->Blocks[blockIndex].empty())
+  {
+    if (!this->BuildBlock(blockIndex))
+    {
+      return NULL;
+    }
+  }
+  vtkIdType valueIndex = (voxelIndex - static_cast<vtkIdType>(blockIndex) * this->NumberOfVoxelsPerBlock) * this->Internal->NumberOfComponents + component;
+  return &this->Internal->Blocks[blockIndex][valueIndex * this->Internal->Images.size()];
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceVoxelTimeSeries::GetVoxelTimeSeries(const int ijk[3], int component, vtkDoubleArray* timeSeries)
+{
+  if (timeSeries == NULL)
+  {
+    vtkErrorMacro("vtkMRMLSequenceVoxelTimeSeries::GetVoxelTimeSeries failed: timeSeries is invalid");
+    return false;
+  }
+  const float* values = this->GetVoxelTimeSeriesPointer(ijk[0], ijk[1], ijk[2], component);
+  if (values == NULL)
+  {
+    return false;
+  }
+  int numberOfTimePoints = static_cast<int>(this->Internal->Images.size());
+  timeSeries->SetNumberOfComponents(1);
+  timeSeries->SetNumberOfTuples(numberOfTimePoints);
+  double* timeSeriesValues = timeSeries->GetPointer(0);
+  for (int timePoint = 0; timePoint < numberOfTimePoints; timePoint++)
+  {
+    timeSeriesValues[timePoint] = values[timePoint];
+  }
+  timeSeries->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSequenceVoxelTimeSeries::GetRegionMeanTimeSeries(const int regionExtent[6], int component, vtkDoubleArray* meanTimeSeries)
+{
+  if (meanTimeSeries == NULL)
+  {
+    vtkErrorMacro("vtkMRMLSequenceVoxelTimeSeries::GetRegionMeanTimeSeries failed: meanTimeSeries is invalid");
+    return false;
+  }
+  if (!this->Update() || component<0 || component>=this->Internal->NumberOfComponents)
+  {
+    return false;
+  }
+  int extent[6];
+  for (int axis=0; axis<3; axis++)
+  {
+    extent[axis*2] = std::max(regionExtent[axis*2], this->Internal->Extent[axis*2]);
+    extent[axis*2+1] = std::min(regionExtent[axis*2+1], this->Internal->Extent[axis*2+1]);
+    if (extent[axis*2] > extent[axis*2+1])
+    {
+      // no overlap
+      return false;
+    }
+  }
+  int numberOfTimePoints = static_cast<int>(this->Internal->Images.size());
+  std::vector<double> sums(numberOfTimePoints, 0.0);
+  vtkIdType numberOfVoxels = 0;
+  for (int k=extent[4]; k<=extent[5]; k++)
+  {
+    for (int j=extent[2]; j<=extent[3]; j++)
+    {
+      for (int i=extent[0]; i<=extent[1]; i++)
+      {
+        const float* values = this->GetTransposedValues(this->Internal->GetVoxelIndex(i, j, k), component);
+        if (values == NULL)
+        {
+          return false;
+        }
+        for (int timePoint = 0; timePoint < numberOfTimePoints; timePoint++)
+        {
+          sums[timePoint] += values[timePoint];
+        }
+        numberOfVoxels++;
+      }
+    }
+  }
+  meanTimeSeries->SetNumberOfComponents(1);
+  meanTimeSeries->SetNumberOfTuples(numberOfTimePoints);
+  for (int timePoint = 0; timePoint < numberOfTimePoints; timePoint++)
+  {
+    meanTimeSeries->SetValue(timePoint, sums[timePoint]/numberOfVoxels);
+  }
+  meanTimeSeries->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLSequenceVoxelTimeSeries::ReleaseBlocks()
+{
+  for (std::vector< std::vector<float> >::iterator blockIt = this->Internal->Blocks.begin(); blockIt != this->Internal->Blocks.end(); ++blockIt)
+  {
+    // swap with an empty vector to free the memory
+    std::vector<float>().swap(*blockIt);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceVoxelTimeSeries::GetNumberOfBuiltBlocks()
+{
+  int numberOfBuiltBlocks = 0;
+  for (std::vector< std::vector<float> >::iterator blockIt = this->Internal->Blocks.begin(); blockIt != this->Internal->Blocks.end(); ++blockIt)
+  {
+    if (!blockIt->empty())
+    {
+      numberOfBuiltBlocks++;
+    }
+  }
+  return numberOfBuiltBlocks;
+}
@@ -0,0 +1,105 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkMRMLSequenceVoxelTimeSeries_h
+#define __vtkMRMLSequenceVoxelTimeSeries_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerSequencesModuleMRMLExport.h"
+
+class vtkDoubleArray;
+class vtkMRMLSequenceNode;
+
+/// \brief Voxel-major (time-contiguous) copy of a scalar volume sequence
+///
+/// Sequence items store each time point in a separate image, therefore reading the time series of a voxel
+/// requires reading one value from each image. This class keeps a transposed copy of the voxels, where the
+/// values of all the time points of a voxel component are stored contiguously, so that time series can be
+/// read with a single contiguous memory access.
+///
+/// The transposed copy is built lazily, in blocks of consecutive voxels, when a voxel of the block is first accessed.
+/// The copy is rebuilt if the sequence or any of its images are modified. Values are stored as float.
+/// All the items of the sequence must be scalar volumes with the same extent and number of scalar components,
+/// and their scalar type must be one of the standard VTK numeric types.
+
+class VTK_SLICER_SEQUENCES_MODULE_MRML_EXPORT vtkMRMLSequenceVoxelTimeSeries : public vtkObject
+{
+public:
+  static vtkMRMLSequenceVoxelTimeSeries *New();
+  vtkTypeMacro(vtkMRMLSequenceVoxelTimeSeries,vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Set the sequence of scalar volumes. Only a weak reference is kept.
+  void SetSequenceNode(vtkMRMLSequenceNode* sequenceNode);
+  vtkMRMLSequenceNode* GetSequenceNode();
+
+  /// Set the number of voxels in each block that is transposed at once. Default is 16384.
+  void SetNumberOfVoxelsPerBlock(int numberOfVoxels);
+  vtkGetMacro(NumberOfVoxelsPerBlock, int);
+
+  /// Check if the sequence has changed and discard the transposed copy if needed.
+  /// Returns false if the sequence is not a valid scalar volume sequence.
+  bool Update();
+
+  /// Number of time points (sequence items)
+  int GetNumberOfTimePoints();
+
+  /// Extent and number of scalar components of the images
+  void GetExtent(int extent[6]);
+  int GetNumberOfScalarComponents();
+
+  /// Returns pointer to the values of all the time points of a voxel component, or NULL if the voxel is outside the extent.
+  /// The pointer remains valid until the sequence is modified or blocks are released.
+  const float* GetVoxelTimeSeriesPointer(int i, int j, int k, int component=0);
+
+  /// Get the values of all the time points of a voxel component (one tuple for each time point).
+  /// Returns false if the voxel is outside the extent.
+  bool GetVoxelTimeSeries(const int ijk[3], int component, vtkDoubleArray* timeSeries);
+
+  /// Get the mean value of the voxels in a region (IJK extent, clamped to the image extent) at each time point.
+  /// Returns false if the region does not overlap with the image.
+  bool GetRegionMeanTimeSeries(const int regionExtent[6], int component, vtkDoubleArray* meanTimeSeries);
+
+  /// Release the transposed copy of all the voxels
+  void ReleaseBlocks();
+
+  /// Number of blocks that are currently transposed
+  int GetNumberOfBuiltBlocks();
+
+protected:
+  vtkMRMLSequenceVoxelTimeSeries();
+  ~vtkMRMLSequenceVoxelTimeSeries();
+  vtkMRMLSequenceVoxelTimeSeries(const vtkMRMLSequenceVoxelTimeSeries&);
+  void operator=(const vtkMRMLSequenceVoxelTimeSeries&);
+
+  /// Copy the values of the voxels of a block from all the images.
+  /// Returns false (and leaves the block empty) if the values cannot be copied.
+  bool BuildBlock(int blockIndex);
+
+  /// Returns pointer to the time series of a voxel component (builds the block if needed), NULL if the block cannot be built.
+  /// Update must be called before.
+  const float* GetTransposedValues(vtkIdType voxelIndex, int component);
+
+  int NumberOfVoxelsPerBlock;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+};
+
+#endif
@@ -0,0 +1,190 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+std::string GetIndexValue(int itemNumber)
+{
+  std::ostringstream indexValueStr;
+  indexValueStr << itemNumber;
+  return indexValueStr.str();
+}
+
+//----------------------------------------------------------------------------
+// Checks the displacements against transforming each point with each matrix
+bool CheckDisplacements(const std::vector< vtkSmartPointer<vtkMatrix4x4> >& matrices, vtkPoints* points, vtkDoubleArray* displacements)
+{
+  int numberOfPoints = points->GetNumberOfPoints();
+  if (displacements->GetNumberOfTuples() != static_cast<vtkIdType>(matrices.size())
+    || displacements->GetNumberOfComponents() != numberOfPoints*3)
+  {
+    std::cerr << "Expected " << matrices.size() << " displacement tuples with " << numberOfPoints*3 << " components, got "
+      << displacements->GetNumberOfTuples() << " tuples with " << displacements->GetNumberOfComponents() << " components" << std::endl;
+    return false;
+  }
+  for (unsigned int matrixIndex=0; matrixIndex<matrices.size(); matrixIndex++)
+  {
+    for (int pointIndex=0; pointIndex<numberOfPoints; pointIndex++)
+    {
+      double point[4] = {0.0, 0.0, 0.0, 1.0};
+      points->GetPoint(pointIndex, point);
+      double transformedPoint[4] = {0.0, 0.0, 0.0, 1.0};
+      matrices[matrixIndex]->MultiplyPoint(point, transformedPoint);
+      for (int axis=0; axis<3; axis++)
+      {
+        double expectedDisplacement = transformedPoint[axis]-point[axis];
+        double displacement = displacements->GetComponent(matrixIndex, pointIndex*3+axis);
+        if (fabs(displacement-expectedDisplacement) > 1e-9)
+        {
+          std::cerr << "Matrix " << matrixIndex << " point " << pointIndex << " axis " << axis << ": expected displacement "
+            << expectedDisplacement << ", got " << displacement << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceNodeDisplacementTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Identity, translation, rotation, rotation with translation, and scaling
+  std::vector< vtkSmartPointer<vtkMatrix4x4> > matrices;
+  vtkNew<vtkTransform> transform;
+  matrices.push_back(vtkSmartPointer<vtkMatrix4x4>::New());
+  transform->Translate(1.0, -2.0, 3.5);
+  matrices.push_back(vtkSmartPointer<vtkMatrix4x4>::New());
+  matrices.back()->DeepCopy(transform->GetMatrix());
+  transform->Identity();
+  transform->RotateZ(90.0);
+  matrices.push_back(vtkSmartPointer<vtkMatrix4x4>::New());
+  matrices.back()->DeepCopy(transform->GetMatrix());
+  transform->Identity();
+  transform->Translate(10.0, 0.0, -5.0);
+  transform->RotateX(30.0);
+  transform->RotateY(-45.0);
+  matrices.push_back(vtkSmartPointer<vtkMatrix4x4>::New());
+  matrices.back()->DeepCopy(transform->GetMatrix());
+  transform->Identity();
+  transform->Scale(2.0, 0.5, 1.0);
+  matrices.push_back(vtkSmartPointer<vtkMatrix4x4>::New());
+  matrices.back()->DeepCopy(transform->GetMatrix());
+
+  // Points are stored as float
+  vtkNew<vtkPoints> points;
+  points->InsertNextPoint(0.0, 0.0, 0.0);
+  points->InsertNextPoint(1.5, -2.0, 4.0);
+  points->InsertNextPoint(-30.0, 12.0, 0.25);
+
+  // Matrices of a linear transform sequence node. The first items are removed, so that the matrices
+  // are stored in the circular buffer with an offset, and GetMatricesFromSequence has to return them in item order.
+  vtkNew<vtkMRMLLinearTransformSequenceNode> linearTransformSequenceNode;
+  linearTransformSequenceNode->SetIndexName("time");
+  for (unsigned int matrixIndex=0; matrixIndex<matrices.size(); matrixIndex++)
+  {
+    linearTransformSequenceNode->SetMatrixAtValue(matrices[matrices.size()-1-matrixIndex], GetIndexValue(matrixIndex).c_str());
+  }
+  linearTransformSequenceNode->RemoveFirstDataNodes(matrices.size()-2);
+  for (unsigned int matrixIndex=2; matrixIndex<matrices.size(); matrixIndex++)
+  {
+    linearTransformSequenceNode->SetMatrixAtValue(matrices[matrixIndex], GetIndexValue(matrices.size()+matrixIndex).c_str());
+  }
+  // the sequence now contains the last two matrices in reverse order, then the matrices from the third one
+  std::vector< vtkSmartPointer<vtkMatrix4x4> > linearTransformSequenceMatrices;
+  linearTransformSequenceMatrices.push_back(matrices[1]);
+  linearTransformSequenceMatrices.push_back(matrices[0]);
+  linearTransformSequenceMatrices.insert(linearTransformSequenceMatrices.end(), matrices.begin()+2, matrices.end());
+  vtkNew<vtkDoubleArray> sequenceMatrices;
+  vtkNew<vtkDoubleArray> displacements;
+  if (!vtkMRMLLinearTransformSequenceNode::GetMatricesFromSequence(linearTransformSequenceNode.GetPointer(), sequenceMatrices.GetPointer()))
+  {
+    std::cerr << "GetMatricesFromSequence failed for a linear transform sequence node" << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkMRMLLinearTransformSequenceNode::ComputeDisplacements(sequenceMatrices.GetPointer(), points.GetPointer(), displacements.GetPointer());
+  if (!CheckDisplacements(linearTransformSequenceMatrices, points.GetPointer(), displacements.GetPointer()))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Matrices of a generic sequence of transform nodes
+  vtkNew<vtkMRMLSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  vtkNew<vtkMRMLLinearTransformNode> transformNode;
+  for (unsigned int matrixIndex=0; matrixIndex<matrices.size(); matrixIndex++)
+  {
+    transformNode->SetMatrixTransformToParent(matrices[matrixIndex]);
+    sequenceNode->SetDataNodeAtValue(transformNode.GetPointer(), GetIndexValue(matrixIndex).c_str());
+  }
+  if (!vtkMRMLLinearTransformSequenceNode::GetMatricesFromSequence(sequenceNode.GetPointer(), sequenceMatrices.GetPointer()))
+  {
+    std::cerr << "GetMatricesFromSequence failed for a sequence of transform nodes" << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkMRMLLinearTransformSequenceNode::ComputeDisplacements(sequenceMatrices.GetPointer(), points.GetPointer(), displacements.GetPointer());
+  if (!CheckDisplacements(matrices, points.GetPointer(), displacements.GetPointer()))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // No points: one empty tuple for each matrix
+  vtkNew<vtkPoints> noPoints;
+  vtkMRMLLinearTransformSequenceNode::ComputeDisplacements(sequenceMatrices.GetPointer(), noPoints.GetPointer(), displacements.GetPointer());
+  if (!CheckDisplacements(matrices, noPoints.GetPointer(), displacements.GetPointer()))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Items that are not linear transforms
+  vtkNew<vtkMRMLSequenceNode> otherSequenceNode;
+  otherSequenceNode->SetIndexName("time");
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  otherSequenceNode->SetDataNodeAtValue(volumeNode.GetPointer(), GetIndexValue(0).c_str());
+  if (vtkMRMLLinearTransformSequenceNode::GetMatricesFromSequence(otherSequenceNode.GetPointer(), sequenceMatrices.GetPointer()))
+  {
+    std::cerr << "GetMatricesFromSequence succeeded for a sequence that does not contain transforms" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,299 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+std::string GetIndexValue(int itemNumber)
+{
+  std::ostringstream indexValueStr;
+  indexValueStr << itemNumber;
+  return indexValueStr.str();
+}
+
+//----------------------------------------------------------------------------
+void SetTranslationAtValue(vtkMRMLLinearTransformSequenceNode* sequenceNode, double translation, const std::string& indexValue)
+{
+  vtkNew<vtkMatrix4x4> matrix;
+  matrix->SetElement(0, 3, translation);
+  sequenceNode->SetMatrixAtValue(matrix.GetPointer(), indexValue.c_str());
+}
+
+//----------------------------------------------------------------------------
+// Checks that the item at the index value is found and it contains the expected translation
+bool CheckItemAtValue(vtkMRMLLinearTransformSequenceNode* sequenceNode, const std::string& indexValue, double expectedTranslation)
+{
+  vtkMRMLLinearTransformNode* transformNode = vtkMRMLLinearTransformNode::SafeDownCast(sequenceNode->GetDataNodeAtValue(indexValue.c_str()));
+  if (transformNode == NULL)
+  {
+    std::cerr << "Item is not found at index value " << indexValue << std::endl;
+    return false;
+  }
+  vtkNew<vtkMatrix4x4> matrix;
+  transformNode->GetMatrixTransformToParent(matrix.GetPointer());
+  if (matrix->GetElement(0, 3) != expectedTranslation)
+  {
+    std::cerr << "Item at index value " << indexValue << ": expected translation " << expectedTranslation
+      << ", got " << matrix->GetElement(0, 3) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks the index values and translations of all the items, in item number order.
+// The matrix array is not accessed, so that the circular buffer is not made contiguous.
+bool CheckItems(vtkMRMLLinearTransformSequenceNode* sequenceNode, const std::vector<int>& expectedIndexValues, const std::vector<double>& expectedTranslations)
+{
+  if (sequenceNode->GetNumberOfDataNodes() != static_cast<int>(expectedIndexValues.size()))
+  {
+    std::cerr << "Expected " << expectedIndexValues.size() << " items, got " << sequenceNode->GetNumberOfDataNodes() << std::endl;
+    return false;
+  }
+  for (int itemNumber=0; itemNumber<static_cast<int>(expectedIndexValues.size()); itemNumber++)
+  {
+    std::string indexValue = GetIndexValue(expectedIndexValues[itemNumber]);
+    if (sequenceNode->GetNthIndexValue(itemNumber) != indexValue)
+    {
+      std::cerr << "Item " << itemNumber << ": expected index value " << indexValue
+        << ", got " << sequenceNode->GetNthIndexValue(itemNumber) << std::endl;
+      return false;
+    }
+    double* elements = sequenceNode->GetNthMatrixElements(itemNumber);
+    if (elements == NULL || elements[3] != expectedTranslations[itemNumber])
+    {
+      std::cerr << "Item " << itemNumber << " does not contain translation " << expectedTranslations[itemNumber] << std::endl;
+      return false;
+    }
+    if (!CheckItemAtValue(sequenceNode, indexValue, expectedTranslations[itemNumber]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Checks that the matrix array contains the matrices in item number order
+bool CheckMatrixArray(vtkMRMLLinearTransformSequenceNode* sequenceNode, const std::vector<double>& expectedTranslations)
+{
+  vtkDoubleArray* matrices = sequenceNode->GetMatrices();
+  if (matrices->GetNumberOfTuples() != static_cast<vtkIdType>(expectedTranslations.size()))
+  {
+    std::cerr << "Expected " << expectedTranslations.size() << " matrices, got " << matrices->GetNumberOfTuples() << std::endl;
+    return false;
+  }
+  for (vtkIdType tupleIndex=0; tupleIndex<matrices->GetNumberOfTuples(); tupleIndex++)
+  {
+    if (matrices->GetComponent(tupleIndex, 3) != expectedTranslations[tupleIndex])
+    {
+      std::cerr << "Matrix " << tupleIndex << " does not contain translation " << expectedTranslations[tupleIndex] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceNodeTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  const int numberOfItems = 5;
+  vtkNew<vtkMRMLLinearTransformSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  std::vector<int> expectedIndexValues;
+  std::vector<double> expectedTranslations;
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    SetTranslationAtValue(sequenceNode.GetPointer(), itemNumber*10.0, GetIndexValue(itemNumber));
+    expectedIndexValues.push_back(itemNumber);
+    expectedTranslations.push_back(itemNumber*10.0);
+  }
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+  if (sequenceNode->GetDataNodeAtValue("missing") != NULL)
+  {
+    std::cerr << "Item is found at an index value that was not added" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Overwrite an existing item
+  SetTranslationAtValue(sequenceNode.GetPointer(), 25.0, GetIndexValue(2));
+  expectedTranslations[2] = 25.0;
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Remove an item from the middle, item numbers of the subsequent items are changed
+  sequenceNode->RemoveDataNodeAtValue(GetIndexValue(1).c_str());
+  expectedIndexValues.erase(expectedIndexValues.begin()+1);
+  expectedTranslations.erase(expectedTranslations.begin()+1);
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Rename an item
+  sequenceNode->UpdateIndexValue(GetIndexValue(3).c_str(), GetIndexValue(7).c_str());
+  expectedIndexValues[2] = 7;
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations)
+    || sequenceNode->GetDataNodeAtValue(GetIndexValue(3).c_str()) != NULL)
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Replace all the items
+  vtkNew<vtkDoubleArray> matrices;
+  matrices->SetNumberOfComponents(16);
+  std::vector<std::string> indexValues;
+  expectedIndexValues.clear();
+  expectedTranslations.clear();
+  vtkNew<vtkMatrix4x4> matrix;
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    matrix->SetElement(0, 3, -itemNumber);
+    matrices->InsertNextTuple(&(matrix->Element[0][0]));
+    indexValues.push_back(GetIndexValue(itemNumber+100));
+    expectedIndexValues.push_back(itemNumber+100);
+    expectedTranslations.push_back(-itemNumber);
+  }
+  if (!sequenceNode->SetMatricesAndIndexValues(matrices.GetPointer(), indexValues)
+    || !CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations)
+    || sequenceNode->GetDataNodeAtValue(GetIndexValue(0).c_str()) != NULL)
+  {
+    std::cerr << "SetMatricesAndIndexValues failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  sequenceNode->RemoveAllDataNodes();
+  expectedIndexValues.clear();
+  expectedTranslations.clear();
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Circular buffer: removing the first items only moves the head of the matrix array and
+  // increases the offset of the item numbers in the index value map
+  for (int itemNumber=0; itemNumber<4; itemNumber++)
+  {
+    SetTranslationAtValue(sequenceNode.GetPointer(), itemNumber*10.0, GetIndexValue(itemNumber));
+    expectedIndexValues.push_back(itemNumber);
+    expectedTranslations.push_back(itemNumber*10.0);
+  }
+  sequenceNode->SetItemValidAtValue(GetIndexValue(3).c_str(), false);
+  sequenceNode->RemoveFirstDataNodes(2);
+  expectedIndexValues.erase(expectedIndexValues.begin(), expectedIndexValues.begin()+2);
+  expectedTranslations.erase(expectedTranslations.begin(), expectedTranslations.begin()+2);
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || sequenceNode->GetDataNodeAtValue(GetIndexValue(0).c_str()) != NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  if (sequenceNode->GetItemValidAtValue(GetIndexValue(3).c_str()) || sequenceNode->GetNumberOfInvalidItems() != 1)
+  {
+    std::cerr << "Validity of the items is not shifted when the first items are removed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // New items are stored in the tuples of the removed items (wrapping around the end of the array)
+  for (int itemNumber=4; itemNumber<6; itemNumber++)
+  {
+    SetTranslationAtValue(sequenceNode.GetPointer(), itemNumber*10.0, GetIndexValue(itemNumber));
+    expectedIndexValues.push_back(itemNumber);
+    expectedTranslations.push_back(itemNumber*10.0);
+  }
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Adding an item to the full buffer moves the matrices and grows the array
+  SetTranslationAtValue(sequenceNode.GetPointer(), 60.0, GetIndexValue(6));
+  expectedIndexValues.push_back(6);
+  expectedTranslations.push_back(60.0);
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Append with reusing the first item (as during live recording)
+  vtkNew<vtkMRMLLinearTransformNode> transformNode;
+  vtkNew<vtkMatrix4x4> appendedMatrix;
+  appendedMatrix->SetElement(0, 3, 70.0);
+  transformNode->SetMatrixTransformToParent(appendedMatrix.GetPointer());
+  sequenceNode->AppendDataNodeAtValue(transformNode.GetPointer(), GetIndexValue(7).c_str(), true);
+  expectedIndexValues.erase(expectedIndexValues.begin());
+  expectedTranslations.erase(expectedTranslations.begin());
+  expectedIndexValues.push_back(7);
+  expectedTranslations.push_back(70.0);
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || sequenceNode->GetItemValidAtValue(GetIndexValue(3).c_str()))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Renaming and removing items while the item numbers in the map have an offset
+  sequenceNode->UpdateIndexValue(GetIndexValue(5).c_str(), GetIndexValue(50).c_str());
+  expectedIndexValues[2] = 50;
+  sequenceNode->RemoveDataNodeAtValue(GetIndexValue(4).c_str());
+  expectedIndexValues.erase(expectedIndexValues.begin()+1);
+  expectedTranslations.erase(expectedTranslations.begin()+1);
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Matrix array is contiguous after GetMatrices, the map still finds all the items
+  SetTranslationAtValue(sequenceNode.GetPointer(), 80.0, GetIndexValue(8));
+  expectedIndexValues.push_back(8);
+  expectedTranslations.push_back(80.0);
+  if (!CheckItems(sequenceNode.GetPointer(), expectedIndexValues, expectedTranslations)
+    || !CheckMatrixArray(sequenceNode.GetPointer(), expectedTranslations))
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLLinearTransformSequenceStorageNode.h"
+
+// MRML includes
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+std::string GetIndexValue(int itemNumber)
+{
+  std::ostringstream indexValueStr;
+  indexValueStr << itemNumber;
+  return indexValueStr.str();
+}
+
+//----------------------------------------------------------------------------
+// Splits the attributes written by WriteXML into a list of names and values (in the order they were written).
+// The node ID is skipped, so that the node can be added to the same scene.
+void GetXMLAttributes(const std::string& xml, std::vector<std::string>& namesAndValues)
+{
+  namesAndValues.clear();
+  size_t position = 0;
+  while (true)
+  {
+    size_t valueStart = xml.find("=\"", position);
+    if (valueStart == std::string::npos)
+    {
+      break;
+    }
+    size_t valueEnd = xml.find('"', valueStart+2);
+    if (valueEnd == std::string::npos)
+    {
+      break;
+    }
+    size_t nameStart = xml.find_last_of(" \t\n", valueStart)+1;
+    std::string name = xml.substr(nameStart, valueStart-nameStart);
+    if (name != "id")
+    {
+      namesAndValues.push_back(name);
+      namesAndValues.push_back(xml.substr(valueStart+2, valueEnd-valueStart-2));
+    }
+    position = valueEnd+1;
+  }
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkMRMLLinearTransformSequenceStorageNodeTest1(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: vtkMRMLLinearTransformSequenceStorageNodeTest1 tempDirectory" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::string fileName = std::string(argv[1]) + "/vtkMRMLLinearTransformSequenceStorageNodeTest1.mha";
+
+  const int numberOfItems = 5;
+  vtkNew<vtkMRMLScene> scene;
+  vtkNew<vtkMRMLLinearTransformSequenceNode> sequenceNode;
+  scene->AddNode(sequenceNode.GetPointer());
+  vtkNew<vtkMatrix4x4> matrix;
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    matrix->SetElement(0, 3, itemNumber*10.0);
+    sequenceNode->SetMatrixAtValue(matrix.GetPointer(), GetIndexValue(itemNumber).c_str());
+  }
+  sequenceNode->SetNthItemValid(1, false);
+  sequenceNode->SetNthItemValid(3, false);
+
+  vtkNew<vtkMRMLLinearTransformSequenceStorageNode> storageNode;
+  scene->AddNode(storageNode.GetPointer());
+  storageNode->SetFileName(fileName.c_str());
+  sequenceNode->SetAndObserveStorageNodeID(storageNode->GetID());
+  if (!storageNode->WriteData(sequenceNode.GetPointer()))
+  {
+    std::cerr << "Writing " << fileName << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Reload the node the same way as the scene does: attributes are read first, then the matrices
+  // are read from the storage node's file. The validity of the items is only stored in the attributes.
+  std::ostringstream xml;
+  sequenceNode->WriteXML(xml, 0);
+  std::vector<std::string> namesAndValues;
+  GetXMLAttributes(xml.str(), namesAndValues);
+  std::vector<const char*> atts;
+  for (std::vector<std::string>::iterator it=namesAndValues.begin(); it!=namesAndValues.end(); ++it)
+  {
+    atts.push_back(it->c_str());
+  }
+  atts.push_back(NULL);
+
+  vtkNew<vtkMRMLLinearTransformSequenceNode> reloadedNode;
+  reloadedNode->ReadXMLAttributes(&(atts[0]));
+  scene->AddNode(reloadedNode.GetPointer());
+  reloadedNode->SetAndObserveStorageNodeID(storageNode->GetID());
+  if (!storageNode->ReadData(reloadedNode.GetPointer()))
+  {
+    std::cerr << "Reading " << fileName << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (reloadedNode->GetNumberOfDataNodes() != numberOfItems)
+  {
+    std::cerr << "Expected " << numberOfItems << " items after reload, got " << reloadedNode->GetNumberOfDataNodes() << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int itemNumber=0; itemNumber<numberOfItems; itemNumber++)
+  {
+    if (reloadedNode->GetNthIndexValue(itemNumber) != GetIndexValue(itemNumber))
+    {
+      std::cerr << "Item " << itemNumber << ": expected index value " << GetIndexValue(itemNumber)
+        << ", got " << reloadedNode->GetNthIndexValue(itemNumber) << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (!reloadedNode->GetNthMatrix(itemNumber, matrix.GetPointer()) || matrix->GetElement(0, 3) != itemNumber*10.0)
+    {
+      std::cerr << "Item " << itemNumber << ": expected translation " << itemNumber*10.0 << std::endl;
+      return EXIT_FAILURE;
+    }
+    bool expectedValid = (itemNumber != 1 && itemNumber != 3);
+    if (reloadedNode->GetNthItemValid(itemNumber) != expectedValid)
+    {
+      std::cerr << "Item " << itemNumber << ": validity is not preserved, expected " << (expectedValid ? "valid" : "invalid") << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (reloadedNode->GetNumberOfInvalidItems() != 2)
+  {
+    std::cerr << "Expected 2 invalid items after reload, got " << reloadedNode->GetNumberOfInvalidItems() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLSequenceImageBufferPool.h"
+#include "vtkMRMLSequenceNode.h"
+#include "vtkMRMLSequenceSampleQueue.h"
+
+// MRML includes
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkVersion.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+const int NUMBER_OF_SAMPLES = 5;
+const int NUMBER_OF_REMOVED_ITEMS = 3;
+
+//----------------------------------------------------------------------------
+bool CheckBufferCount(const char* description, int actual, int expected)
+{
+  if (actual != expected)
+  {
+    std::cerr << description << ": expected " << expected << ", got " << actual << std::endl;
+    return false;
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceImageBufferPoolTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkMRMLSequenceImageBufferPool* pool = vtkMRMLSequenceImageBufferPool::GetInstance();
+  pool->ReleaseBuffers();
+  int dimensions[3] = {32, 16, 1};
+
+  // Recorder path: samples are pushed into the queue and added to a sequence, then the first items are removed
+  vtkNew<vtkMRMLSequenceSampleQueue> queue;
+  queue->SetCapacity(NUMBER_OF_SAMPLES);
+  std::vector<void*> sampleBuffers;
+  int numberOfAllocatedBuffers = pool->GetNumberOfAllocatedBuffers();
+  for (int sampleIndex=0; sampleIndex<NUMBER_OF_SAMPLES; sampleIndex++)
+  {
+    vtkImageData* image = pool->NewImage(dimensions, VTK_UNSIGNED_CHAR, 1);
+    sampleBuffers.push_back(image->GetScalarPointer());
+    if (!queue->PushImageSample(sampleIndex*0.1, image))
+    {
+      std::cerr << "Failed to push image sample " << sampleIndex << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (!CheckBufferCount("Allocated buffers", pool->GetNumberOfAllocatedBuffers()-numberOfAllocatedBuffers, NUMBER_OF_SAMPLES))
+  {
+    return EXIT_FAILURE;
+  }
+
+  vtkNew<vtkMRMLSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  if (!CheckBufferCount("Added samples", queue->DrainToSequence(sequenceNode.GetPointer()), NUMBER_OF_SAMPLES))
+  {
+    return EXIT_FAILURE;
+  }
+  // The sequence items take over the sample images, the pixel data is not copied
+  for (int itemNumber=0; itemNumber<NUMBER_OF_SAMPLES; itemNumber++)
+  {
+    vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(sequenceNode->GetNthDataNode(itemNumber));
+    if (volumeNode==NULL || volumeNode->GetImageData()==NULL || volumeNode->GetImageData()->GetScalarPointer()!=sampleBuffers[itemNumber])
+    {
+      std::cerr << "Item " << itemNumber << " does not use the buffer of the pushed sample" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Share the scalars of the last removed item with another image (as a virtual output node does),
+  // its buffer must not be recycled
+  vtkMRMLScalarVolumeNode* sharedVolumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(sequenceNode->GetNthDataNode(NUMBER_OF_REMOVED_ITEMS-1));
+  vtkNew<vtkImageData> sharedImage;
+  sharedImage->ShallowCopy(sharedVolumeNode->GetImageData());
+
+  // Buffers of the removed items are returned to the pool
+  sequenceNode->RemoveFirstDataNodes(NUMBER_OF_REMOVED_ITEMS);
+  if (sharedImage->GetScalarPointer()!=sampleBuffers[NUMBER_OF_REMOVED_ITEMS-1])
+  {
+    std::cerr << "Shared image scalars were modified" << std::endl;
+    return EXIT_FAILURE;
+  }
+  int numberOfReusedBuffers = pool->GetNumberOfReusedBuffers();
+  std::vector< vtkSmartPointer<vtkImageData> > newImages;
+  for (int imageIndex=0; imageIndex<NUMBER_OF_REMOVED_ITEMS; imageIndex++)
+  {
+    newImages.push_back(vtkSmartPointer<vtkImageData>::Take(pool->NewImage(dimensions, VTK_UNSIGNED_CHAR, 1)));
+  }
+  if (!CheckBufferCount("Reused buffers", pool->GetNumberOfReusedBuffers()-numberOfReusedBuffers, NUMBER_OF_REMOVED_ITEMS-1))
+  {
+    return EXIT_FAILURE;
+  }
+  for (int imageIndex=0; imageIndex<NUMBER_OF_REMOVED_ITEMS; imageIndex++)
+  {
+    if (newImages[imageIndex]->GetScalarPointer()==sampleBuffers[NUMBER_OF_REMOVED_ITEMS-1])
+    {
+      std::cerr << "Buffer of a shared image was reused" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Images that were not created by the pool are not recycled
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(dimensions);
+#if (VTK_MAJOR_VERSION <= 5)
+  image->SetScalarTypeToUnsignedChar();
+  image->AllocateScalars();
+#else
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+#endif
+  if (pool->RecycleImage(image.GetPointer()) || image->GetPointData()->GetScalars()==NULL)
+  {
+    std::cerr << "Image that was not created by the pool was recycled" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  pool->ReleaseBuffers();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLSequenceNode.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+
+// VTK includes
+#include <vtkNew.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+const int NUMBER_OF_ITEMS = 6;
+
+//----------------------------------------------------------------------------
+std::string GetIndexValue(int itemNumber)
+{
+  std::ostringstream indexValueStr;
+  indexValueStr << itemNumber;
+  return indexValueStr.str();
+}
+
+//----------------------------------------------------------------------------
+// Checks that only the items at the listed index values are invalid (invalidIndexValues is a space-separated list)
+bool CheckInvalidItems(vtkMRMLSequenceNode* sequenceNode, const std::string& invalidIndexValues)
+{
+  std::string indexValueList = std::string(" ")+invalidIndexValues+" ";
+  int numberOfInvalidItems = 0;
+  for (int itemNumber=0; itemNumber<sequenceNode->GetNumberOfDataNodes(); itemNumber++)
+  {
+    std::string indexValue = sequenceNode->GetNthIndexValue(itemNumber);
+    bool expectedValid = (indexValueList.find(std::string(" ")+indexValue+" ") == std::string::npos);
+    if (sequenceNode->GetNthItemValid(itemNumber) != expectedValid
+      || sequenceNode->GetItemValidAtValue(indexValue.c_str()) != expectedValid)
+    {
+      std::cerr << "Item at index value " << indexValue << " is expected to be " << (expectedValid ? "valid" : "invalid") << std::endl;
+      return false;
+    }
+    if (!expectedValid)
+    {
+      numberOfInvalidItems++;
+    }
+  }
+  if (sequenceNode->GetNumberOfInvalidItems() != numberOfInvalidItems)
+  {
+    std::cerr << "Expected " << numberOfInvalidItems << " invalid items, got " << sequenceNode->GetNumberOfInvalidItems() << std::endl;
+    return false;
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceNodeTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkMRMLSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  vtkNew<vtkMRMLLinearTransformNode> transformNode;
+  for (int itemNumber=0; itemNumber<NUMBER_OF_ITEMS; itemNumber++)
+  {
+    sequenceNode->SetDataNodeAtValue(transformNode.GetPointer(), GetIndexValue(itemNumber).c_str());
+  }
+
+  // All items are valid by default
+  if (!CheckInvalidItems(sequenceNode.GetPointer(), ""))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Mark items as invalid, by item number and by index value
+  sequenceNode->SetNthItemValid(1, false);
+  sequenceNode->SetItemValidAtValue(GetIndexValue(4).c_str(), false);
+  if (!CheckInvalidItems(sequenceNode.GetPointer(), "1 4"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Setting the same validity does not modify the node
+  unsigned long mtime = sequenceNode->GetMTime();
+  sequenceNode->SetNthItemValid(4, false);
+  sequenceNode->SetNthItemValid(5, true);
+  if (sequenceNode->GetMTime() != mtime)
+  {
+    std::cerr << "Sequence node is modified when item validity is not changed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Validity flags are shifted when an item is removed from the middle
+  sequenceNode->RemoveDataNodeAtValue(GetIndexValue(2).c_str());
+  if (!CheckInvalidItems(sequenceNode.GetPointer(), "1 4"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Validity flags of the first items are removed with the items
+  sequenceNode->RemoveFirstDataNodes(2);
+  if (!CheckInvalidItems(sequenceNode.GetPointer(), "4"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Invalid items are written to and read from the scene file (by item number)
+  std::stringstream xml;
+  sequenceNode->WriteXML(xml, 0);
+  if (xml.str().find("invalidItems=\"1\"") == std::string::npos)
+  {
+    std::cerr << "Invalid items are not written correctly to XML: " << xml.str() << std::endl;
+    return EXIT_FAILURE;
+  }
+  vtkNew<vtkMRMLSequenceNode> readSequenceNode;
+  const char* atts[] = { "invalidItems", "0 2", NULL };
+  readSequenceNode->ReadXMLAttributes(atts);
+  if (readSequenceNode->GetNumberOfInvalidItems() != 2
+    || readSequenceNode->GetNthItemValid(0) || !readSequenceNode->GetNthItemValid(1) || readSequenceNode->GetNthItemValid(2))
+  {
+    std::cerr << "Invalid items are not read correctly from XML" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Items that are marked as valid again and new items are valid
+  sequenceNode->SetItemValidAtValue(GetIndexValue(4).c_str(), true);
+  sequenceNode->SetDataNodeAtValue(transformNode.GetPointer(), GetIndexValue(NUMBER_OF_ITEMS).c_str());
+  if (!CheckInvalidItems(sequenceNode.GetPointer(), ""))
+  {
+    return EXIT_FAILURE;
+  }
+
+  sequenceNode->SetNthItemValid(0, false);
+  sequenceNode->RemoveAllDataNodes();
+  if (sequenceNode->GetNumberOfInvalidItems() != 0)
+  {
+    std::cerr << "Invalid items are kept after all the items are removed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLSequenceNode.h"
+#include "vtkMRMLSequenceSampleQueue.h"
+
+// MRML includes
+#include <vtkMRMLLinearTransformNode.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+const int NUMBER_OF_THREADED_SAMPLES = 10000;
+const double THREADED_TEST_TIMEOUT_SEC = 30.0;
+
+//----------------------------------------------------------------------------
+struct ProducerThreadData
+{
+  vtkMRMLSequenceSampleQueue* Queue;
+  // Number of push attempts that failed because the queue was full (only accessed by the producer thread)
+  int NumberOfFailedPushes;
+  // Set by the consumer if it does not receive all the samples in time
+  volatile bool Abort;
+};
+
+//----------------------------------------------------------------------------
+// Pushes samples as fast as possible, retrying each sample until the consumer makes room for it
+VTK_THREAD_RETURN_TYPE ProducerThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ProducerThreadData* data = static_cast<ProducerThreadData*>(threadInfo->UserData);
+  double elements[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+  for (int sampleIndex=0; sampleIndex<NUMBER_OF_THREADED_SAMPLES && !data->Abort; sampleIndex++)
+  {
+    elements[3] = sampleIndex;
+    while (!data->Queue->PushTransformSample(sampleIndex*0.001, elements))
+    {
+      data->NumberOfFailedPushes++;
+      if (data->Abort)
+      {
+        break;
+      }
+    }
+  }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool CheckTranslations(vtkMRMLLinearTransformSequenceNode* sequenceNode, int expectedNumberOfItems)
+{
+  if (sequenceNode->GetNumberOfDataNodes() != expectedNumberOfItems)
+  {
+    std::cerr << "Expected " << expectedNumberOfItems << " items, got " << sequenceNode->GetNumberOfDataNodes() << std::endl;
+    return false;
+  }
+  for (int itemNumber=0; itemNumber<expectedNumberOfItems; itemNumber++)
+  {
+    double* elements = sequenceNode->GetNthMatrixElements(itemNumber);
+    if (elements == NULL || elements[3] != itemNumber)
+    {
+      std::cerr << "Item " << itemNumber << " does not contain the sample that was pushed as " << itemNumber << "." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceSampleQueueTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  double elements[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+
+  // Samples are dropped when the queue is full
+  vtkNew<vtkMRMLSequenceSampleQueue> queue;
+  queue->SetCapacity(3);
+  for (int sampleIndex=0; sampleIndex<3; sampleIndex++)
+  {
+    elements[3] = sampleIndex;
+    if (!queue->PushTransformSample(sampleIndex, elements))
+    {
+      std::cerr << "Failed to push sample " << sampleIndex << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  elements[3] = 3;
+  if (queue->PushTransformSample(3, elements) || queue->GetNumberOfDroppedSamples() != 1 || queue->GetNumberOfQueuedSamples() != 3)
+  {
+    std::cerr << "Sample is not dropped when the queue is full" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // The image reference is released when an image sample is dropped
+  vtkImageData* droppedImage = vtkImageData::New();
+  // keep an extra reference to check that the queue releases its reference
+  droppedImage->Register(NULL);
+  bool droppedImageReleased = (!queue->PushImageSample(3, droppedImage) && droppedImage->GetReferenceCount() == 1);
+  droppedImage->Delete();
+  if (!droppedImageReleased)
+  {
+    std::cerr << "Image of a dropped sample is not released" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Samples are added in the order they were pushed, at most the requested number of samples at once
+  vtkNew<vtkMRMLLinearTransformSequenceNode> transformSequenceNode;
+  transformSequenceNode->SetIndexName("time");
+  if (queue->DrainToSequence(transformSequenceNode.GetPointer(), 2) != 2 || queue->GetNumberOfQueuedSamples() != 1
+    || !CheckTranslations(transformSequenceNode.GetPointer(), 2))
+  {
+    std::cerr << "Failed to add the first two samples to the sequence" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // Freed slots can be reused
+  elements[3] = 3;
+  if (!queue->PushTransformSample(3, elements) || queue->DrainToSequence(transformSequenceNode.GetPointer()) != 2
+    || queue->GetNumberOfQueuedSamples() != 0 || !CheckTranslations(transformSequenceNode.GetPointer(), 4))
+  {
+    std::cerr << "Failed to add the remaining samples to the sequence" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (transformSequenceNode->GetNthIndexValue(1) != "1.000000")
+  {
+    std::cerr << "Expected index value 1.000000, got " << transformSequenceNode->GetNthIndexValue(1) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Transform samples are stored as transform nodes in a generic sequence node
+  vtkNew<vtkMRMLSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  elements[3] = 5;
+  queue->PushTransformSample(5, elements);
+  vtkMRMLLinearTransformNode* transformNode = NULL;
+  if (queue->DrainToSequence(sequenceNode.GetPointer()) == 1)
+  {
+    transformNode = vtkMRMLLinearTransformNode::SafeDownCast(sequenceNode->GetNthDataNode(0));
+  }
+  vtkNew<vtkMatrix4x4> matrix;
+  if (transformNode != NULL)
+  {
+    transformNode->GetMatrixTransformToParent(matrix.GetPointer());
+  }
+  if (transformNode == NULL || matrix->GetElement(0, 3) != 5)
+  {
+    std::cerr << "Transform sample is not added to the generic sequence node" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A producer thread pushes samples while the main thread adds them to the sequence.
+  // No sample may be lost or reordered, and the queue reports each failed push as a dropped sample.
+  vtkNew<vtkMRMLSequenceSampleQueue> threadedQueue;
+  threadedQueue->SetCapacity(64);
+  vtkNew<vtkMRMLLinearTransformSequenceNode> threadedSequenceNode;
+  threadedSequenceNode->SetIndexName("time");
+  ProducerThreadData producerData;
+  producerData.Queue = threadedQueue.GetPointer();
+  producerData.NumberOfFailedPushes = 0;
+  producerData.Abort = false;
+  vtkNew<vtkMultiThreader> threader;
+  int producerThreadId = threader->SpawnThread(ProducerThreadFunction, &producerData);
+  double timeoutTimeSec = vtkTimerLog::GetUniversalTime()+THREADED_TEST_TIMEOUT_SEC;
+  int numberOfAddedSamples = 0;
+  while (numberOfAddedSamples<NUMBER_OF_THREADED_SAMPLES)
+  {
+    numberOfAddedSamples += threadedQueue->DrainToSequence(threadedSequenceNode.GetPointer());
+    if (vtkTimerLog::GetUniversalTime()>timeoutTimeSec)
+    {
+      producerData.Abort = true;
+      break;
+    }
+  }
+  threader->TerminateThread(producerThreadId);
+  if (producerData.Abort)
+  {
+    std::cerr << "Timeout: only " << numberOfAddedSamples << " of " << NUMBER_OF_THREADED_SAMPLES << " samples were received" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!CheckTranslations(threadedSequenceNode.GetPointer(), NUMBER_OF_THREADED_SAMPLES))
+  {
+    return EXIT_FAILURE;
+  }
+  if (threadedQueue->GetNumberOfDroppedSamples() != producerData.NumberOfFailedPushes)
+  {
+    std::cerr << "Expected " << producerData.NumberOfFailedPushes << " dropped samples, got "
+      << threadedQueue->GetNumberOfDroppedSamples() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Threaded queue: " << NUMBER_OF_THREADED_SAMPLES << " samples received, "
+    << producerData.NumberOfFailedPushes << " pushes retried because the queue was full" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,269 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences includes
+#include "vtkMRMLSequenceNode.h"
+#include "vtkMRMLSequenceVoxelTimeSeries.h"
+
+// MRML includes
+#include <vtkMRMLScalarVolumeNode.h>
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkVersion.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+const int NUMBER_OF_TIME_POINTS = 3;
+const int NUMBER_OF_COMPONENTS = 2;
+// The number of voxels is not a multiple of the block size, so that the last block is partial
+const int NUMBER_OF_VOXELS_PER_BLOCK = 7;
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> CreateImage(const int extent[6], int scalarType, int numberOfComponents)
+{
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetExtent(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+#if (VTK_MAJOR_VERSION <= 5)
+  image->SetScalarType(scalarType);
+  image->SetNumberOfScalarComponents(numberOfComponents);
+  image->AllocateScalars();
+#else
+  image->AllocateScalars(scalarType, numberOfComponents);
+#endif
+  return image;
+}
+
+//----------------------------------------------------------------------------
+void AddImageToSequence(vtkMRMLSequenceNode* sequenceNode, vtkImageData* image, int itemNumber)
+{
+  std::ostringstream indexValueStr;
+  indexValueStr << itemNumber;
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  volumeNode->SetAndObserveImageData(image);
+  sequenceNode->SetDataNodeAtValue(volumeNode.GetPointer(), indexValueStr.str().c_str());
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* GetNthImage(vtkMRMLSequenceNode* sequenceNode, int itemNumber)
+{
+  vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(sequenceNode->GetNthDataNode(itemNumber));
+  return volumeNode ? volumeNode->GetImageData() : NULL;
+}
+
+//----------------------------------------------------------------------------
+// Compares the transposed values of all the voxels to the values in the images
+bool CheckAllVoxels(vtkMRMLSequenceVoxelTimeSeries* voxelTimeSeries, vtkMRMLSequenceNode* sequenceNode, const int extent[6])
+{
+  for (int k=extent[4]; k<=extent[5]; k++)
+  {
+    for (int j=extent[2]; j<=extent[3]; j++)
+    {
+      for (int i=extent[0]; i<=extent[1]; i++)
+      {
+        for (int component=0; component<NUMBER_OF_COMPONENTS; component++)
+        {
+          const float* values = voxelTimeSeries->GetVoxelTimeSeriesPointer(i, j, k, component);
+          if (values == NULL)
+          {
+            std::cerr << "No time series for voxel (" << i << ", " << j << ", " << k << ") component " << component << std::endl;
+            return false;
+          }
+          for (int timePoint=0; timePoint<NUMBER_OF_TIME_POINTS; timePoint++)
+          {
+            double expectedValue = GetNthImage(sequenceNode, timePoint)->GetScalarComponentAsDouble(i, j, k, component);
+            if (values[timePoint] != expectedValue)
+            {
+              std::cerr << "Voxel (" << i << ", " << j << ", " << k << ") component " << component << " time point " << timePoint
+                << ": expected " << expectedValue << ", got " << values[timePoint] << std::endl;
+              return false;
+            }
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSequenceVoxelTimeSeriesTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // Extent does not start at 0, to check the voxel index computation
+  const int extent[6] = {2, 6, 0, 3, 1, 3};
+  vtkNew<vtkMRMLSequenceNode> sequenceNode;
+  sequenceNode->SetIndexName("time");
+  for (int timePoint=0; timePoint<NUMBER_OF_TIME_POINTS; timePoint++)
+  {
+    vtkSmartPointer<vtkImageData> image = CreateImage(extent, VTK_SHORT, NUMBER_OF_COMPONENTS);
+    int voxelIndex = 0;
+    for (int k=extent[4]; k<=extent[5]; k++)
+    {
+      for (int j=extent[2]; j<=extent[3]; j++)
+      {
+        for (int i=extent[0]; i<=extent[1]; i++, voxelIndex++)
+        {
+          for (int component=0; component<NUMBER_OF_COMPONENTS; component++)
+          {
+            image->SetScalarComponentFromDouble(i, j, k, component, timePoint*1000 + voxelIndex*NUMBER_OF_COMPONENTS + component);
+          }
+        }
+      }
+    }
+    AddImageToSequence(sequenceNode.GetPointer(), image, timePoint);
+  }
+
+  vtkNew<vtkMRMLSequenceVoxelTimeSeries> voxelTimeSeries;
+  voxelTimeSeries->SetNumberOfVoxelsPerBlock(NUMBER_OF_VOXELS_PER_BLOCK);
+  voxelTimeSeries->SetSequenceNode(sequenceNode.GetPointer());
+  int timeSeriesExtent[6] = {0, 0, 0, 0, 0, 0};
+  voxelTimeSeries->GetExtent(timeSeriesExtent);
+  if (!voxelTimeSeries->Update() || voxelTimeSeries->GetNumberOfTimePoints() != NUMBER_OF_TIME_POINTS
+    || voxelTimeSeries->GetNumberOfScalarComponents() != NUMBER_OF_COMPONENTS
+    || timeSeriesExtent[0] != extent[0] || timeSeriesExtent[3] != extent[3] || timeSeriesExtent[5] != extent[5])
+  {
+    std::cerr << "Voxel time series properties do not match the sequence" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Blocks are built when they are first accessed
+  if (voxelTimeSeries->GetNumberOfBuiltBlocks() != 0)
+  {
+    std::cerr << "Blocks are built before any voxel is accessed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  voxelTimeSeries->GetVoxelTimeSeriesPointer(extent[0], extent[2], extent[4]);
+  if (voxelTimeSeries->GetNumberOfBuiltBlocks() != 1)
+  {
+    std::cerr << "Expected 1 built block, got " << voxelTimeSeries->GetNumberOfBuiltBlocks() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!CheckAllVoxels(voxelTimeSeries.GetPointer(), sequenceNode.GetPointer(), extent))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Voxels outside the extent and invalid components
+  int outsideVoxel[3] = {extent[0]-1, extent[2], extent[4]};
+  vtkNew<vtkDoubleArray> timeSeries;
+  if (voxelTimeSeries->GetVoxelTimeSeries(outsideVoxel, 0, timeSeries.GetPointer())
+    || voxelTimeSeries->GetVoxelTimeSeriesPointer(extent[0], extent[2], extent[4], NUMBER_OF_COMPONENTS) != NULL)
+  {
+    std::cerr << "Time series is returned for a voxel outside the extent or an invalid component" << std::endl;
+    return EXIT_FAILURE;
+  }
+  int voxel[3] = {extent[1], extent[3], extent[5]};
+  if (!voxelTimeSeries->GetVoxelTimeSeries(voxel, 1, timeSeries.GetPointer())
+    || timeSeries->GetNumberOfTuples() != NUMBER_OF_TIME_POINTS
+    || timeSeries->GetValue(2) != GetNthImage(sequenceNode.GetPointer(), 2)->GetScalarComponentAsDouble(voxel[0], voxel[1], voxel[2], 1))
+  {
+    std::cerr << "GetVoxelTimeSeries returned incorrect values" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Region mean, the region is clamped to the image extent
+  const int regionExtent[6] = {0, 3, 1, 2, 3, 10};
+  vtkNew<vtkDoubleArray> meanTimeSeries;
+  if (!voxelTimeSeries->GetRegionMeanTimeSeries(regionExtent, 0, meanTimeSeries.GetPointer())
+    || meanTimeSeries->GetNumberOfTuples() != NUMBER_OF_TIME_POINTS)
+  {
+    std::cerr << "GetRegionMeanTimeSeries failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int timePoint=0; timePoint<NUMBER_OF_TIME_POINTS; timePoint++)
+  {
+    double sum = 0;
+    int numberOfVoxels = 0;
+    for (int j=1; j<=2; j++)
+    {
+      for (int i=2; i<=3; i++, numberOfVoxels++)
+      {
+        sum += GetNthImage(sequenceNode.GetPointer(), timePoint)->GetScalarComponentAsDouble(i, j, 3, 0);
+      }
+    }
+    if (fabs(meanTimeSeries->GetValue(timePoint) - sum/numberOfVoxels) > 1e-6)
+    {
+      std::cerr << "Region mean at time point " << timePoint << ": expected " << sum/numberOfVoxels
+        << ", got " << meanTimeSeries->GetValue(timePoint) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  const int outsideRegionExtent[6] = {10, 12, 0, 3, 1, 3};
+  if (voxelTimeSeries->GetRegionMeanTimeSeries(outsideRegionExtent, 0, meanTimeSeries.GetPointer()))
+  {
+    std::cerr << "Region mean is computed for a region outside the image" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Transposed values are rebuilt when an image is modified
+  vtkImageData* modifiedImage = GetNthImage(sequenceNode.GetPointer(), 1);
+  modifiedImage->SetScalarComponentFromDouble(4, 2, 2, 1, -5);
+  modifiedImage->Modified();
+  const float* modifiedValues = voxelTimeSeries->GetVoxelTimeSeriesPointer(4, 2, 2, 1);
+  if (modifiedValues == NULL || modifiedValues[1] != -5)
+  {
+    std::cerr << "Transposed values are not updated after the image is modified" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!CheckAllVoxels(voxelTimeSeries.GetPointer(), sequenceNode.GetPointer(), extent))
+  {
+    return EXIT_FAILURE;
+  }
+  voxelTimeSeries->ReleaseBlocks();
+  if (voxelTimeSeries->GetNumberOfBuiltBlocks() != 0
+    || !CheckAllVoxels(voxelTimeSeries.GetPointer(), sequenceNode.GetPointer(), extent))
+  {
+    std::cerr << "Blocks are not rebuilt correctly after they are released" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Images with different extent
+  const int differentExtent[6] = {0, 4, 0, 3, 1, 3};
+  AddImageToSequence(sequenceNode.GetPointer(), CreateImage(differentExtent, VTK_SHORT, NUMBER_OF_COMPONENTS), NUMBER_OF_TIME_POINTS);
+  if (voxelTimeSeries->Update() || voxelTimeSeries->GetVoxelTimeSeriesPointer(extent[0], extent[2], extent[4]) != NULL)
+  {
+    std::cerr << "Sequence of images with different extents is accepted" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Scalar types that cannot be transposed are rejected, no values are returned
+  vtkNew<vtkMRMLSequenceNode> bitSequenceNode;
+  bitSequenceNode->SetIndexName("time");
+  for (int timePoint=0; timePoint<NUMBER_OF_TIME_POINTS; timePoint++)
+  {
+    AddImageToSequence(bitSequenceNode.GetPointer(), CreateImage(extent, VTK_BIT, 1), timePoint);
+  }
+  voxelTimeSeries->SetSequenceNode(bitSequenceNode.GetPointer());
+  if (voxelTimeSeries->Update() || voxelTimeSeries->GetVoxelTimeSeriesPointer(extent[0], extent[2], extent[4]) != NULL
+    || voxelTimeSeries->GetNumberOfBuiltBlocks() != 0)
+  {
+    std::cerr << "Sequence of images with unsupported scalar type is accepted" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Sequences Widgets includes
+#include "qSlicerSequencesDataNodesModel.h"
+
+// Sequence includes
+#include "vtkMRMLLinearTransformSequenceNode.h"
+#include "vtkMRMLSequenceNode.h"
+
+// VTK includes
+#include <vtkCommand.h>
+#include <vtkWeakPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+/// \ingroup Slicer_QtModules_Sequence
+class qSlicerSequencesDataNodesModelPrivate
+{
+  Q_DECLARE_PUBLIC(qSlicerSequencesDataNodesModel);
+protected:
+  qSlicerSequencesDataNodesModel* const q_ptr;
+
+public:
+  qSlicerSequencesDataNodesModelPrivate(qSlicerSequencesDataNodesModel& object);
+
+  /// Returns the index value of the item shown in the row (empty if the row is invalid)
+  std::string indexValue(int row)const;
+
+  vtkWeakPointer<vtkMRMLSequenceNode> SequenceNode;
+
+  /// Number of rows that the views are aware of. It may differ from the number of items in the sequence node
+  /// until updateFromSequenceNode is called.
+  int NumberOfRows;
+};
+
+// --------------------------------------------------------------------------
+qSlicerSequencesDataNodesModelPrivate
+::qSlicerSequencesDataNodesModelPrivate(qSlicerSequencesDataNodesModel& object)
+  : q_ptr(&object)
+  , NumberOfRows(0)
+{
+}
+
+// --------------------------------------------------------------------------
+std::string qSlicerSequencesDataNodesModelPrivate::indexValue(int row)const
+{
+  if (this->SequenceNode.GetPointer()==NULL || row<0 || row>=this->SequenceNode->GetNumberOfDataNodes())
+  {
+    return "";
+  }
+  return this->SequenceNode->GetNthIndexValue(row);
+}
+
+//-----------------------------------------------------------------------------
+// qSlicerSequencesDataNodesModel methods
+
+//-----------------------------------------------------------------------------
+qSlicerSequencesDataNodesModel::qSlicerSequencesDataNodesModel(QObject* parentObject)
+  : Superclass( parentObject )
+  , d_ptr( new qSlicerSequencesDataNodesModelPrivate(*this) )
+{
+}
+
+//-----------------------------------------------------------------------------
+qSlicerSequencesDataNodesModel::~qSlicerSequencesDataNodesModel()
+{
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequencesDataNodesModel::setSequenceNode(vtkMRMLSequenceNode* sequenceNode)
+{
+  Q_D(qSlicerSequencesDataNodesModel);
+  if (sequenceNode==d->SequenceNode.GetPointer())
+  {
+    this->updateFromSequenceNode();
+    return;
+  }
+  this->beginResetModel();
+  this->qvtkReconnect(d->SequenceNode.GetPointer(), sequenceNode, vtkCommand::ModifiedEvent,
+    this, SLOT(updateFromSequenceNode()));
+  d->SequenceNode = sequenceNode;
+  d->NumberOfRows = sequenceNode ? sequenceNode->GetNumberOfDataNodes() : 0;
+  this->endResetModel();
+}
+
+//-----------------------------------------------------------------------------
+vtkMRMLSequenceNode* qSlicerSequencesDataNodesModel::sequenceNode()const
+{
+  Q_D(const qSlicerSequencesDataNodesModel);
+  return d->SequenceNode.GetPointer();
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequencesDataNodesModel::updateFromSequenceNode()
+{
+  Q_D(qSlicerSequencesDataNodesModel);
+  int numberOfDataNodes = d->SequenceNode.GetPointer() ? d->SequenceNode->GetNumberOfDataNodes() : 0;
+  if (numberOfDataNodes>d->NumberOfRows)
+  {
+    this->beginInsertRows(QModelIndex(), d->NumberOfRows, numberOfDataNodes-1);
+    d->NumberOfRows = numberOfDataNodes;
+    this->endInsertRows();
+  }
+  else if (numberOfDataNodes<d->NumberOfRows)
+  {
+    this->beginRemoveRows(QModelIndex(), numberOfDataNodes, d->NumberOfRows-1);
+    d->NumberOfRows = numberOfDataNodes;
+    this->endRemoveRows();
+  }
+  // Items may have been inserted in the middle or renamed. Cell contents are not stored in the model,
+  // so only the visible cells are read again from the sequence node.
+  if (d->NumberOfRows>0)
+  {
+    emit dataChanged(this->index(0, 0), this->index(d->NumberOfRows-1, NumberOfColumns-1));
+  }
+  emit headerDataChanged(Qt::Horizontal, 0, NumberOfColumns-1);
+}
+
+//-----------------------------------------------------------------------------
+int qSlicerSequencesDataNodesModel::rowCount(const QModelIndex& parent)const
+{
+  Q_D(const qSlicerSequencesDataNodesModel);
+  if (parent.isValid())
+  {
+    return 0;
+  }
+  return d->NumberOfRows;
+}
+
+//-----------------------------------------------------------------------------
+int qSlicerSequencesDataNodesModel::columnCount(const QModelIndex& parent)const
+{
+  Q_D(const qSlicerSequencesDataNodesModel);
+  if (parent.isValid() || d->SequenceNode.GetPointer()==NULL)
+  {
+    return 0;
+  }
+  return NumberOfColumns;
+}
+
+//-----------------------------------------------------------------------------
+QVariant qSlicerSequencesDataNodesModel::data(const QModelIndex& index, int role)const
+{
+  Q_D(const qSlicerSequencesDataNodesModel);
+  if (!index.isValid() || d->SequenceNode.GetPointer()==NULL || index.row()>=d->SequenceNode->GetNumberOfDataNodes())
+  {
+    return QVariant();
+  }
+  if (role==Qt::TextAlignmentRole && index.column()==IndexValueColumn)
+  {
+    return QVariant(Qt::AlignHCenter|Qt::AlignVCenter);
+  }
+  if (role!=Qt::DisplayRole && role!=Qt::EditRole)
+  {
+    return QVariant();
+  }
+  if (index.column()==IndexValueColumn)
+  {
+    return QString::fromStdString(d->SequenceNode->GetNthIndexValue(index.row()));
+  }
+  if (index.column()==NameColumn)
+  {
+    if (vtkMRMLLinearTransformSequenceNode::SafeDownCast(d->SequenceNode)!=NULL)
+    {
+      // the shared data node of the items is named after the sequence, it is not updated just to get its name
+      return QString(d->SequenceNode->GetName() ? d->SequenceNode->GetName() : "");
+    }
+    vtkMRMLNode* dataNode = d->SequenceNode->GetNthDataNode(index.row());
+    if (dataNode==NULL || dataNode->GetName()==NULL)
+    {
+      return QString();
+    }
+    return QString::fromStdString(dataNode->GetName());
+  }
+  return QVariant();
+}
+
+//-----------------------------------------------------------------------------
+QVariant qSlicerSequencesDataNodesModel::headerData(int section, Qt::Orientation orientation, int role)const
+{
+  Q_D(const qSlicerSequencesDataNodesModel);
+  if (orientation!=Qt::Horizontal || role!=Qt::DisplayRole)
+  {
+    return Superclass::headerData(section, orientation, role);
+  }
+  if (section==IndexValueColumn)
+  {
+    if (d->SequenceNode.GetPointer()==NULL)
+    {
+      return QVariant();
+    }
+    const char* indexName = d->SequenceNode->GetIndexName();
+    const char* indexUnit = d->SequenceNode->GetIndexUnit();
+    return QString("%1 (%2)").arg(indexName ? indexName : "").arg(indexUnit ? indexUnit : "");
+  }
+  if (section==NameColumn)
+  {
+    return tr("Name");
+  }
+  return QVariant();
+}
+
+//-----------------------------------------------------------------------------
+Qt::ItemFlags qSlicerSequencesDataNodesModel::flags(const QModelIndex& index)const
+{
+  Q_D(const qSlicerSequencesDataNodesModel);
+  if (!index.isValid())
+  {
+    return Qt::NoItemFlags;
+  }
+  if (index.column()==NameColumn && vtkMRMLLinearTransformSequenceNode::SafeDownCast(d->SequenceNode)!=NULL)
+  {
+    // items of a linear transform sequence have no data node of their own, the displayed name is the sequence name
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+  }
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerSequencesDataNodesModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+  Q_D(qSlicerSequencesDataNodesModel);
+  if (!index.isValid() || role!=Qt::EditRole)
+  {
+    return false;
+  }
+  std::string currentIndexValue = d->indexValue(index.row());
+  if (currentIndexValue.empty())
+  {
+    return false;
+  }
+  std::string newValue = value.toString().toLatin1().constData();
+  if (index.column()==IndexValueColumn)
+  {
+    if (newValue.empty() || newValue==currentIndexValue)
+    {
+      return false;
+    }
+    // changing the index value may change the order of the items, updateFromSequenceNode refreshes all the visible rows
+    d->SequenceNode->UpdateIndexValue(currentIndexValue.c_str(), newValue.c_str());
+    this->updateFromSequenceNode();
+    return true;
+  }
+  if (index.column()==NameColumn)
+  {
+    vtkMRMLNode* dataNode = d->SequenceNode->GetDataNodeAtValue(currentIndexValue.c_str());
+    if (dataNode==NULL)
+    {
+      return false;
+    }
+    dataNode->SetName(newValue.c_str());
+    emit dataChanged(index, index);
+    return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool qSlicerSequencesDataNodesModel::removeRows(int row, int count, const QModelIndex& parent)
+{
+  Q_D(qSlicerSequencesDataNodesModel);
+  if (parent.isValid() || d->SequenceNode.GetPointer()==NULL || row<0 || count<1 || row+count>d->NumberOfRows)
+  {
+    return false;
+  }
+  // Collect the index values first, because item numbers change as items are removed
+  std::vector<std::string> indexValues;
+  for (int i = row; i<row+count; i++)
+  {
+    indexValues.push_back(d->indexValue(i));
+  }
+  this->beginRemoveRows(parent, row, row+count-1);
+  // The sequence node is not observed during removal, rows are removed here
+  this->qvtkDisconnect(d->SequenceNode.GetPointer(), vtkCommand::ModifiedEvent, this, SLOT(updateFromSequenceNode()));
+  for (std::vector<std::string>::iterator indexValueIt = indexValues.begin(); indexValueIt != indexValues.end(); ++indexValueIt)
+  {
+    if (!indexValueIt->empty())
+    {
+      d->SequenceNode->RemoveDataNodeAtValue(indexValueIt->c_str());
+    }
+  }
+  this->qvtkConnect(d->SequenceNode.GetPointer(), vtkCommand::ModifiedEvent, this, SLOT(updateFromSequenceNode()));
+  d->NumberOfRows = std::max(0, d->NumberOfRows-count);
+  this->endRemoveRows();
+  // synchronize if the number of removed items is different from the number of removed rows
+  this->updateFromSequenceNode();
+  return true;
+}
@@ -0,0 +1,86 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __qSlicerSequencesDataNodesModel_h
+#define __qSlicerSequencesDataNodesModel_h
+
+// Qt includes
+#include <QAbstractTableModel>
+
+// CTK includes
+#include <ctkVTKObject.h>
+
+// Sequences Widgets includes
+#include "qSlicerSequencesModuleWidgetsExport.h"
+
+class qSlicerSequencesDataNodesModelPrivate;
+class vtkMRMLSequenceNode;
+
+/// \ingroup Slicer_QtModules_Sequence
+/// \brief Table model that shows the index value and data node name of each item of a sequence node.
+///
+/// Cell contents are read from the sequence node when the view requests them, therefore only the visible
+/// rows are accessed, regardless of the number of items in the sequence. The model observes the sequence node
+/// and updates the rows when items are added or removed.
+class Q_SLICER_MODULE_SEQUENCES_WIDGETS_EXPORT qSlicerSequencesDataNodesModel
+  : public QAbstractTableModel
+{
+  Q_OBJECT
+  QVTK_OBJECT
+public:
+  typedef QAbstractTableModel Superclass;
+  qSlicerSequencesDataNodesModel(QObject *parent=0);
+  virtual ~qSlicerSequencesDataNodesModel();
+
+  enum Columns
+  {
+    IndexValueColumn = 0,
+    NameColumn,
+    NumberOfColumns // this must be the last line in this enum
+  };
+
+  /// Set the sequence node whose items are shown in the table
+  void setSequenceNode(vtkMRMLSequenceNode* sequenceNode);
+  vtkMRMLSequenceNode* sequenceNode()const;
+
+  virtual int rowCount(const QModelIndex& parent = QModelIndex())const;
+  virtual int columnCount(const QModelIndex& parent = QModelIndex())const;
+  virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole)const;
+  virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole)const;
+  virtual Qt::ItemFlags flags(const QModelIndex& index)const;
+
+  /// Editing the index value column changes the index value of the item,
+  /// editing the name column changes the name of the data node.
+  virtual bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole);
+
+  /// Remove items from the sequence node
+  virtual bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex());
+
+public slots:
+  /// Update the rows after items were added to or removed from the sequence node.
+  /// Rows are inserted or removed at the end of the table, cell contents are refreshed when they are displayed.
+  void updateFromSequenceNode();
+
+protected:
+  QScopedPointer<qSlicerSequencesDataNodesModelPrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(qSlicerSequencesDataNodesModel);
+  Q_DISABLE_COPY(qSlicerSequencesDataNodesModel);
+};
+
+#endif
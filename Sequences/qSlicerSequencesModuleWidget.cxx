@@ -32,20 +32,19 @@
 #include "vtkMRMLScene.h"
 
 // Sequence includes
+#include "qSlicerSequencesDataNodesModel.h"
 #include "vtkSlicerSequencesLogic.h"
 #include "vtkMRMLSequenceNode.h"
 
+// STD includes
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
 #define FROM_STD_STRING_SAFE(unsafeString) QString::fromStdString( unsafeString==NULL?"":unsafeString )
 #define FROM_ATTRIBUTE_SAFE(unsafeString) ( unsafeString==NULL?"":unsafeString )
 
-enum
-{
-//  DATA_NODE_VIS_COLUMN=0,
-  DATA_NODE_VALUE_COLUMN,
-  DATA_NODE_NAME_COLUMN,
-  DATA_NODE_NUMBER_OF_COLUMNS // this must be the last line in this enum
-};
-
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class qSlicerSequencesModuleWidgetPrivate: public Ui_qSlicerSequencesModuleWidget
@@ -62,6 +61,25 @@ public:
   
   /// Get a list of MLRML nodes that are in the scene but not added to the multidimensional data node at the chosen index value
   void GetDataNodeCandidates(vtkCollection* foundNodes, vtkMRMLSequenceNode* rootNode);
+
+  /// Rebuild the node class index from the scene if it is not valid
+  void UpdateNodeClassIndex(vtkMRMLScene* scene);
+  /// Add a node that has just been added to the scene to the node class index
+  void AddNodeToClassIndex(vtkMRMLNode* node);
+  /// Remove a node that has just been removed from the scene from the node class index
+  void RemoveNodeFromClassIndex(vtkMRMLNode* node);
+
+  /// Returns the row of the data node table that is selected (-1 if no row is selected)
+  int currentDataNodeRow() const;
+
+  /// Items of the selected sequence node. Only visible rows are read from the sequence node.
+  qSlicerSequencesDataNodesModel* DataNodesModel;
+
+  /// Nodes of the scene indexed by class name (in the order they were added to the scene), so that data node
+  /// candidates can be found without iterating through all the nodes of the scene
+  std::map< std::string, std::vector<vtkMRMLNode*> > NodeClassIndex;
+  /// The index has to be rebuilt if scene events were not processed (module was not active, batch processing)
+  bool NodeClassIndexValid;
 };
 
 //-----------------------------------------------------------------------------
@@ -69,6 +87,8 @@ public:
 
 //-----------------------------------------------------------------------------
 qSlicerSequencesModuleWidgetPrivate::qSlicerSequencesModuleWidgetPrivate( qSlicerSequencesModuleWidget& object ) : q_ptr(&object)
+  , DataNodesModel(0)
+  , NodeClassIndexValid(false)
 {
 }
 
@@ -104,9 +124,38 @@ void qSlicerSequencesModuleWidgetPrivate::GetDataNodeCandidates(vtkCollection* f
 
   std::string dataNodeClassName=rootNode->GetDataNodeClassName();
 
-  for ( int i = 0; i < rootNode->GetScene()->GetNumberOfNodes(); i++ )
+  // If the sequence already contains data nodes then only nodes of the same class are candidates,
+  // otherwise any node of the scene may be added
+  std::vector<vtkMRMLNode*> allNodes;
+  const std::vector<vtkMRMLNode*>* nodes = &allNodes;
+  if (!dataNodeClassName.empty())
+  {
+    this->UpdateNodeClassIndex(rootNode->GetScene());
+    std::map< std::string, std::vector<vtkMRMLNode*> >::iterator classNodesIt = this->NodeClassIndex.find(dataNodeClassName);
+    if (classNodesIt == this->NodeClassIndex.end())
+    {
+      return;
+    }
+    nodes = &(classNodesIt->second);
+  }
+  else
+  {
+    vtkCollection* sceneNodes = rootNode->GetScene()->GetNodes();
+    vtkCollectionSimpleIterator it;
+    vtkObject* sceneNode = NULL;
+    for (sceneNodes->InitTraversal(it); (sceneNode = sceneNodes->GetNextItemAsObject(it)); )
+    {
+      allNodes.push_back(vtkMRMLNode::SafeDownCast(sceneNode));
+    }
+  }
+
+  for (std::vector<vtkMRMLNode*>::const_iterator nodeIt = nodes->begin(); nodeIt != nodes->end(); ++nodeIt)
   {
-    vtkMRMLNode* currentNode = vtkMRMLNode::SafeDownCast( rootNode->GetScene()->GetNthNode( i ) );    
+    vtkMRMLNode* currentNode = (*nodeIt);
+    if (currentNode==NULL)
+    {
+      continue;
+    }
     if (currentNode->GetHideFromEditors())
     {
       // don't show hidden nodes, they would clutter the view
@@ -134,6 +183,66 @@ void qSlicerSequencesModuleWidgetPrivate::GetDataNodeCandidates(vtkCollection* f
   }
 }
 
+//-----------------------------------------------------------------------------
+void qSlicerSequencesModuleWidgetPrivate::UpdateNodeClassIndex(vtkMRMLScene* scene)
+{
+  if (this->NodeClassIndexValid)
+  {
+    return;
+  }
+  this->NodeClassIndex.clear();
+  if (scene==NULL)
+  {
+    return;
+  }
+  vtkCollection* sceneNodes = scene->GetNodes();
+  vtkCollectionSimpleIterator it;
+  vtkObject* sceneNode = NULL;
+  for (sceneNodes->InitTraversal(it); (sceneNode = sceneNodes->GetNextItemAsObject(it)); )
+  {
+    vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(sceneNode);
+    if (node!=NULL)
+    {
+      this->NodeClassIndex[node->GetClassName()].push_back(node);
+    }
+  }
+  this->NodeClassIndexValid = true;
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequencesModuleWidgetPrivate::AddNodeToClassIndex(vtkMRMLNode* node)
+{
+  if (!this->NodeClassIndexValid || node==NULL)
+  {
+    // the node will be added when the index is rebuilt
+    return;
+  }
+  this->NodeClassIndex[node->GetClassName()].push_back(node);
+}
+
+//-----------------------------------------------------------------------------
+void qSlicerSequencesModuleWidgetPrivate::RemoveNodeFromClassIndex(vtkMRMLNode* node)
+{
+  if (!this->NodeClassIndexValid || node==NULL)
+  {
+    return;
+  }
+  std::map< std::string, std::vector<vtkMRMLNode*> >::iterator classNodesIt = this->NodeClassIndex.find(node->GetClassName());
+  if (classNodesIt == this->NodeClassIndex.end())
+  {
+    return;
+  }
+  std::vector<vtkMRMLNode*>& classNodes = classNodesIt->second;
+  classNodes.erase(std::remove(classNodes.begin(), classNodes.end(), node), classNodes.end());
+}
+
+//-----------------------------------------------------------------------------
+int qSlicerSequencesModuleWidgetPrivate::currentDataNodeRow() const
+{
+  QModelIndex currentIndex = this->TableView_DataNodes->currentIndex();
+  return currentIndex.isValid() ? currentIndex.row() : -1;
+}
+
 //-----------------------------------------------------------------------------
 // qSlicerSequencesModuleWidget methods
 
@@ -164,8 +273,10 @@ void qSlicerSequencesModuleWidget::setup()
     }
   }
 
-  d->TableWidget_DataNodes->setColumnWidth( DATA_NODE_VALUE_COLUMN, 30 );
-  d->TableWidget_DataNodes->setColumnWidth( DATA_NODE_NAME_COLUMN, 100 );
+  d->DataNodesModel = new qSlicerSequencesDataNodesModel( this );
+  d->TableView_DataNodes->setModel( d->DataNodesModel );
+  d->TableView_DataNodes->setColumnWidth( qSlicerSequencesDataNodesModel::IndexValueColumn, 30 );
+  d->TableView_DataNodes->setColumnWidth( qSlicerSequencesDataNodesModel::NameColumn, 100 );
 
   connect( d->MRMLNodeComboBox_SequenceRoot, SIGNAL( currentNodeChanged( vtkMRMLNode* ) ), this, SLOT( onRootNodeChanged() ) );
 
@@ -173,10 +284,6 @@ void qSlicerSequencesModuleWidget::setup()
   connect( d->LineEdit_IndexUnit, SIGNAL( textEdited( const QString & ) ), this, SLOT( onIndexUnitEdited() ) );
   connect( d->ComboBox_IndexType, SIGNAL( currentIndexChanged( const QString & ) ), this, SLOT( onIndexTypeEdited(QString) ) );
 
-  connect( d->TableWidget_DataNodes, SIGNAL( currentCellChanged( int, int, int, int ) ), this, SLOT( onDataNodeChanged() ) );
-  connect( d->TableWidget_DataNodes, SIGNAL( cellChanged( int, int ) ), this, SLOT( onDataNodeEdited( int, int ) ) );
-  connect( d->TableWidget_DataNodes, SIGNAL( cellClicked( int, int ) ), this, SLOT( onHideDataNodeClicked( int, int ) ) );
-
   connect( d->PushButton_AddDataNode, SIGNAL( clicked() ), this, SLOT( onAddDataNodeButtonClicked() ) );
   d->PushButton_AddDataNode->setIcon( QApplication::style()->standardIcon( QStyle::SP_ArrowLeft ) );
   connect( d->PushButton_RemoveDataNode, SIGNAL( clicked() ), this, SLOT( onRemoveDataNodeButtonClicked() ) );
@@ -190,6 +297,9 @@ void qSlicerSequencesModuleWidget::enter()
 {
   Q_D(qSlicerSequencesModuleWidget);
 
+  // scene events were not observed while the module was not active
+  d->NodeClassIndexValid = false;
+
   if (this->mrmlScene() != 0)
   {
     // set up mrml scene observations so that the GUI gets updated
@@ -231,38 +341,49 @@ void qSlicerSequencesModuleWidget::onNodeAddedEvent(vtkObject*, vtkObject* node)
   Q_D(qSlicerSequencesModuleWidget);
   if (!this->mrmlScene() || this->mrmlScene()->IsBatchProcessing())
   {
+    // the index is rebuilt once when batch processing is completed
+    d->NodeClassIndexValid = false;
     return;
   }
+  d->AddNodeToClassIndex(vtkMRMLNode::SafeDownCast(node));
   UpdateCandidateNodes();
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerSequencesModuleWidget::onNodeRemovedEvent(vtkObject* scene, vtkObject* node)
 {
+  Q_D(qSlicerSequencesModuleWidget);
   Q_UNUSED(scene);
-  Q_UNUSED(node);
   if (!this->mrmlScene() || this->mrmlScene()->IsBatchProcessing())
     {
+    d->NodeClassIndexValid = false;
     return;
     }
+  d->RemoveNodeFromClassIndex(vtkMRMLNode::SafeDownCast(node));
   UpdateCandidateNodes();
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerSequencesModuleWidget::onMRMLSceneEndImportEvent()
 {
+  Q_D(qSlicerSequencesModuleWidget);
+  d->NodeClassIndexValid = false;
   UpdateCandidateNodes();
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerSequencesModuleWidget::onMRMLSceneEndRestoreEvent()
 {
+  Q_D(qSlicerSequencesModuleWidget);
+  d->NodeClassIndexValid = false;
   UpdateCandidateNodes();
 }
 
 //-----------------------------------------------------------------------------
 void qSlicerSequencesModuleWidget::onMRMLSceneEndBatchProcessEvent()
 {
+  Q_D(qSlicerSequencesModuleWidget);
+  d->NodeClassIndexValid = false;
   if (!this->mrmlScene())
     {
     return;
@@ -273,6 +394,8 @@ void qSlicerSequencesModuleWidget::onMRMLSceneEndBatchProcessEvent()
 //-----------------------------------------------------------------------------
 void qSlicerSequencesModuleWidget::onMRMLSceneEndCloseEvent()
 {
+  Q_D(qSlicerSequencesModuleWidget);
+  d->NodeClassIndexValid = false;
   if (!this->mrmlScene() || this->mrmlScene()->IsBatchProcessing())
     {
     return;
@@ -340,52 +463,6 @@ void qSlicerSequencesModuleWidget::onIndexTypeEdited(QString indexTypeString)
   this->UpdateRootNode();
 }
 
-//-----------------------------------------------------------------------------
-void qSlicerSequencesModuleWidget::onDataNodeEdited( int row, int column )
-{
-  Q_D(qSlicerSequencesModuleWidget);
-
-  // Ensure that the user is editing, not the index changed programmatically
-  if ( d->TableWidget_DataNodes->currentRow() != row || d->TableWidget_DataNodes->currentColumn() != column )
-  {
-    return;
-  }
-
-  vtkMRMLSequenceNode* currentRoot = vtkMRMLSequenceNode::SafeDownCast( d->MRMLNodeComboBox_SequenceRoot->currentNode() );
-  if ( currentRoot == NULL )
-  {
-    return;
-  }
-
-  std::string currentIndexValue = currentRoot->GetNthIndexValue( d->TableWidget_DataNodes->currentRow() );
-  if ( currentIndexValue.empty() )
-  {
-    return;
-  }
-
-  vtkMRMLNode* currentDataNode = currentRoot->GetDataNodeAtValue(currentIndexValue.c_str() );
-  if ( currentDataNode == NULL )
-  {
-    return;
-  }
-
-  // Grab the tex from the modified item
-  QTableWidgetItem* qItem = d->TableWidget_DataNodes->item( row, column );
-  QString qText = qItem->text();
-
-  if ( column == DATA_NODE_VALUE_COLUMN )
-  {
-    currentRoot->UpdateIndexValue( currentIndexValue.c_str(), qText.toLatin1().constData() );
-  }
-
-  if ( column == DATA_NODE_NAME_COLUMN )
-  {
-    currentDataNode->SetName( qText.toLatin1().constData() );
-  }
-
-  this->UpdateRootNode();
-}
-
 //-----------------------------------------------------------------------------
 void qSlicerSequencesModuleWidget::onAddDataNodeButtonClicked()
 {
@@ -468,17 +545,16 @@ void qSlicerSequencesModuleWidget::onRemoveDataNodeButtonClicked()
     return;
   }
 
-  std::string currentIndexValue = currentRoot->GetNthIndexValue( d->TableWidget_DataNodes->currentRow() );
-  if ( currentIndexValue.empty() )
+  int currentRow = d->currentDataNodeRow();
+  if ( currentRow < 0 )
   {
     return;
   }
-  currentRoot->RemoveDataNodeAtValue( currentIndexValue.c_str() );  
-
-  this->UpdateRootNode();
+  // the model removes the item from the sequence and only the removed row is removed from the table
+  d->DataNodesModel->removeRow( currentRow );
 
   // If the data node list have become empty then refresh the candidate nodes list, as we now accept any kind of nodes
-  if (d->TableWidget_DataNodes->rowCount()==0)
+  if (d->DataNodesModel->rowCount()==0)
   {
     this->UpdateCandidateNodes();
   }
@@ -499,7 +575,7 @@ void qSlicerSequencesModuleWidget::onHideDataNodeClicked( int row, int column )
     return;
   }
 
-  std::string currentIndexValue = currentRoot->GetNthIndexValue( d->TableWidget_DataNodes->currentRow() );
+  std::string currentIndexValue = currentRoot->GetNthIndexValue( d->currentDataNodeRow() );
   if ( currentIndexValue.empty() )
   {
     return;
@@ -537,9 +613,7 @@ void qSlicerSequencesModuleWidget::UpdateRootNode()
     d->LineEdit_IndexName->setText( FROM_STD_STRING_SAFE( "" ) );    
     d->LineEdit_IndexUnit->setText( FROM_STD_STRING_SAFE( "" ) );    
     d->ComboBox_IndexType->setCurrentIndex(-1);
-    d->TableWidget_DataNodes->clear();
-    d->TableWidget_DataNodes->setRowCount( 0 );
-    d->TableWidget_DataNodes->setColumnCount( 0 );
+    d->DataNodesModel->setSequenceNode( NULL );
     d->ListWidget_CandidateDataNodes->clear();
     setEnableWidgets(false);
     return;
@@ -555,47 +629,10 @@ void qSlicerSequencesModuleWidget::UpdateRootNode()
   d->LineEdit_IndexUnit->setText( FROM_STD_STRING_SAFE( currentRoot->GetIndexUnit() ) );
   d->ComboBox_IndexType->setCurrentIndex( d->ComboBox_IndexType->findText(FROM_STD_STRING_SAFE( currentRoot->GetIndexTypeAsString() )) );
 
-  // Display all of the sequence nodes
-  d->TableWidget_DataNodes->clear();
-  d->TableWidget_DataNodes->setRowCount( currentRoot->GetNumberOfDataNodes() );
-  d->TableWidget_DataNodes->setColumnCount( DATA_NODE_NUMBER_OF_COLUMNS );
-  std::stringstream valueHeader;
-  valueHeader << FROM_ATTRIBUTE_SAFE( currentRoot->GetIndexName() ); 
-  valueHeader << " (" << FROM_ATTRIBUTE_SAFE( currentRoot->GetIndexUnit() ) << ")";
-  QStringList SequenceNodesTableHeader;
-  //SequenceNodesTableHeader.insert( DATA_NODE_VIS_COLUMN, "Vis" );
-  SequenceNodesTableHeader.insert( DATA_NODE_VALUE_COLUMN, valueHeader.str().c_str() );
-  SequenceNodesTableHeader.insert( DATA_NODE_NAME_COLUMN, "Name" );
-  d->TableWidget_DataNodes->setHorizontalHeaderLabels( SequenceNodesTableHeader );  
-
+  // Display all of the sequence nodes. The model only reads the rows that are visible in the table
+  // and it only inserts or removes rows if the sequence node is the same as before.
+  d->DataNodesModel->setSequenceNode( currentRoot );
   int numberOfDataNodes=currentRoot->GetNumberOfDataNodes();
-  for ( int dataNodeIndex = 0; dataNodeIndex < numberOfDataNodes; dataNodeIndex++ )
-  {
-    std::string currentValue = currentRoot->GetNthIndexValue( dataNodeIndex );
-    vtkMRMLNode* currentDataNode = currentRoot->GetNthDataNode( dataNodeIndex );
-
-    if (currentDataNode==NULL)
-    {
-      qCritical() << "qSlicerSequencesModuleWidget::UpdateRootNode invalid data node";
-      continue;
-    }
-
-    // Display the data node information
-    //QTableWidgetItem* visItem = new QTableWidgetItem( QString( "" ) );
-    //this->CreateVisItem( visItem, d->logic()->GetDataNodesHiddenAtValue( currentRoot, currentValue.c_str() ) );
-
-    QTableWidgetItem* valueItem = new QTableWidgetItem( FROM_STD_STRING_SAFE( currentValue.c_str() ) );
-    valueItem->setTextAlignment(Qt::AlignHCenter|Qt::AlignVCenter);
-
-    QTableWidgetItem* nameItem = new QTableWidgetItem( FROM_STD_STRING_SAFE( currentDataNode->GetName() ) );
-
-    //d->TableWidget_DataNodes->setItem( dataNodeIndex, DATA_NODE_VIS_COLUMN, visItem );
-    d->TableWidget_DataNodes->setItem( dataNodeIndex, DATA_NODE_VALUE_COLUMN, valueItem );
-    d->TableWidget_DataNodes->setItem( dataNodeIndex, DATA_NODE_NAME_COLUMN, nameItem );
-  }
-
-  //d->TableWidget_DataNodes->resizeColumnsToContents();  
-  d->TableWidget_DataNodes->resizeRowsToContents();  
 
   // Open the data node adding section if there are no data nodes yet
   // to make it easier to see how to add new nodes.
@@ -669,7 +706,7 @@ void qSlicerSequencesModuleWidget::setEnableWidgets(bool enable)
   d->LineEdit_IndexName->setEnabled(enable);
   d->LineEdit_IndexUnit->setEnabled(enable);
   d->ComboBox_IndexType->setEnabled(enable);
-  d->TableWidget_DataNodes->setEnabled(enable);
+  d->TableView_DataNodes->setEnabled(enable);
   d->ListWidget_CandidateDataNodes->setEnabled(enable);
   d->LineEdit_NewDataNodeIndexValue->setEnabled(enable);
   d->PushButton_AddDataNode->setEnabled(enable);
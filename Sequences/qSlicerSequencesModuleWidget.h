@@ -53,7 +53,6 @@ public slots:
   void onIndexUnitEdited();
   void onIndexTypeEdited(QString indexTypeString);
 
-  void onDataNodeEdited( int row, int column );
   void onHideDataNodeClicked( int row, int column );
 
   void onAddDataNodeButtonClicked();